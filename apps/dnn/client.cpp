@@ -1,5 +1,7 @@
+#include "msgs.h"
 #include "tbench_client.h"
 
+#include <assert.h>
 #include <unistd.h>
 
 #include <cstring>
@@ -13,6 +15,8 @@
 #include <torch/torch.h>
 
 #include "imagefolder_dataset.h"
+#include "tensorpack.h"
+#include "tensorreq.h"
 #include "getopt.h"
 /*******************************************************************************
  * Class Definitions
@@ -24,7 +28,6 @@ class ImagenetClient {
 		torch::data::Iterator<torch::data::Example <>> it;
 		torch::data::Iterator<torch::data::Example <>> begin;
 		torch::data::Iterator<torch::data::Example <>> end;
-		std::string imgBatch;
 		std::vector<at::Tensor> imgTargets;
 
     public:
@@ -35,16 +38,66 @@ class ImagenetClient {
 
         ~ImagenetClient() {}
 
-        const std::string& getBatch() {
-			auto imgBatchTensor = (*it).data;
+        // Writes the next batch into req as a raw tensor; returns its length
+        size_t getBatch(TensorReq* req) {
+			auto imgBatchTensor = (*it).data.to(torch::kFloat).contiguous();
 			imgTargets.push_back((*it).target);
-			std::stringstream ss;
-			torch::save(imgBatchTensor, ss);
-			imgBatch = ss.str();
+
+			assert(imgBatchTensor.dim() <= TENSOR_MAX_DIMS);
+			req->dtype = TENSOR_FLOAT32;
+			req->ndim = imgBatchTensor.dim();
+			for (uint32_t d = 0; d < req->ndim; d++)
+			    req->shape[d] = imgBatchTensor.size(d);
+
+			size_t len = tensorReqLen(req);
+			assert(len <= MAX_REQ_BYTES);
+			memcpy(req->data, imgBatchTensor.data_ptr<float>(),
+			        imgBatchTensor.numel() * sizeof(float));
+
 			++it;
 			if (it == end)
 			    it = begin;
-            return imgBatch;
+            return len;
+        }
+};
+
+// Serves samples from a tensor pack written by imagenet-pack, so generating
+// a request is a single memcpy instead of a JPEG decode
+class PackedClient {
+    private:
+        TensorPack pack;
+        uint64_t next;
+
+    public:
+        PackedClient(const std::string& path) : next(0) {
+            if (!pack.open(path) || pack.numSamples() == 0) {
+                std::cerr << "Could not open tensor pack " << path << std::endl;
+                exit(-1);
+            }
+            if (pack.ndim() + 1 > TENSOR_MAX_DIMS ||
+                    sizeof(TensorReq) + pack.sampleNumel() * sizeof(float) >
+                    (size_t)MAX_REQ_BYTES) {
+                std::cerr << "Samples in " << path << " are too large" << std::endl;
+                exit(-1);
+            }
+            std::cout << "Loaded " << pack.numSamples() << " samples from "
+                      << path << std::endl;
+        }
+
+        // Writes the next sample into req as a batch of one; returns its length
+        size_t getBatch(TensorReq* req) {
+            req->dtype = TENSOR_FLOAT32;
+            req->ndim = pack.ndim() + 1;
+            req->shape[0] = 1;
+            for (uint32_t d = 0; d < pack.ndim(); d++)
+                req->shape[d + 1] = pack.shape()[d];
+
+            memcpy(req->data, pack.sample(next),
+                    pack.sampleNumel() * sizeof(float));
+
+            if (++next == pack.numSamples())
+                next = 0;
+            return tensorReqLen(req);
         }
 };
 
@@ -52,12 +105,19 @@ class ImagenetClient {
  * Global Data
  *******************************************************************************/
 ImagenetClient* ic = nullptr;
+PackedClient* pc = nullptr;
 std::unique_ptr<torch::data::StatelessDataLoader<torch::data::datasets::MapDataset<torch::data::datasets::MapDataset<dataset::ImageFolderDataset, torch::data::transforms::Normalize<> >, torch::data::transforms::Stack<torch::data::Example<> > >, torch::data::samplers::SequentialSampler>, std::default_delete<torch::data::StatelessDataLoader<torch::data::datasets::MapDataset<torch::data::datasets::MapDataset<dataset::ImageFolderDataset, torch::data::transforms::Normalize<> >, torch::data::transforms::Stack<torch::data::Example<> > >, torch::data::samplers::SequentialSampler> > > val_loader;
 
 /*******************************************************************************
  * Liblat API
  *******************************************************************************/
 void tBenchClientInit() {
+    std::string pack_path = getOpt<std::string>("IMAGENET_PACK", "");
+    if (!pack_path.empty()) {
+        pc = new PackedClient(pack_path);
+        return;
+    }
+
     std::string imagenet_path = getOpt<std::string>("IMAGENET_PATH", "");
     auto val_dataset = ImageFolderDataset(imagenet_path, ImageFolderDataset::Mode::VAL, {224, 224})
         .map(torch::data::transforms::Normalize<>({0.485, 0.456, 0.406}, {0.229, 0.224, 0.225}))
@@ -71,8 +131,6 @@ void tBenchClientInit() {
 }
 
 size_t tBenchClientGenReq(void* data) {
-    auto batch = ic->getBatch();
-    size_t len = batch.size();
-    memcpy(data, reinterpret_cast<const void*>(batch.c_str()), len + 1);
-    return len + 1;
+    if (pc) return pc->getBatch(reinterpret_cast<TensorReq*>(data));
+    return ic->getBatch(reinterpret_cast<TensorReq*>(data));
 }
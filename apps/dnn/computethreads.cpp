@@ -0,0 +1,108 @@
+#include <atomic>
+#include <iostream>
+#include <sstream>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ATen/Parallel.h>
+#include <torch/torch.h>
+
+#include "computethreads.h"
+#include "tbench_server.h"
+
+#define gettid() ((pid_t)syscall(SYS_gettid))
+
+using namespace std;
+
+vector<int> ComputeThreads::cpus;
+unsigned ComputeThreads::intraOp = 0;
+unsigned ComputeThreads::interOp = 0;
+unsigned ComputeThreads::numTeams = 1;
+
+bool ComputeThreads::parseCpuList(const string& list, vector<int>& cpus) {
+    cpus.clear();
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        int lo, hi;
+        char dash;
+        stringstream rs(range);
+        if (!(rs >> lo)) return false;
+        if (rs >> dash) {
+            if (dash != '-' || !(rs >> hi) || hi < lo) return false;
+        } else {
+            hi = lo;
+        }
+        for (int c = lo; c <= hi; c++) cpus.push_back(c);
+    }
+    return !cpus.empty();
+}
+
+void ComputeThreads::init(const vector<int>& _cpus, unsigned _intraOp,
+                          unsigned _interOp, unsigned _numTeams) {
+    cpus = _cpus;
+    numTeams = _numTeams;
+
+    if (_intraOp > 0) at::set_num_threads(_intraOp);
+    if (_interOp > 0) at::set_num_interop_threads(_interOp);
+    intraOp = at::get_num_threads();
+    interOp = at::get_num_interop_threads();
+
+    // Published by the harness along with the server threads
+    tBenchServerExpectThreads(numTeams * intraOp + interOp);
+
+    cerr << "[DNN] " << intraOp << " intra-op threads x " << numTeams
+         << " teams, " << interOp << " inter-op threads, "
+         << (cpus.empty() ? "unpinned" : "pinned") << endl;
+}
+
+void ComputeThreads::pinSelf(unsigned slot) {
+    if (cpus.empty()) return;
+
+    int cpu = cpus[slot % cpus.size()];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        cerr << "[DNN] Could not pin thread " << gettid() << " to cpu " << cpu << endl;
+}
+
+void ComputeThreads::registerSelf(const char* role, unsigned slot) {
+    tBenchServerRegisterThread(role, slot);
+    cerr << "[DNN] " << role << " thread " << gettid() << endl;
+}
+
+void ComputeThreads::startTeam(unsigned team) {
+    // The OpenMP thread count is per calling thread
+    at::set_num_threads(intraOp);
+
+    // With a grain of 1, every thread of the team, including this one, runs
+    // exactly one iteration
+    at::parallel_for(0, intraOp, 1, [team] (int64_t begin, int64_t end) {
+        for (int64_t i = begin; i < end; i++) {
+            pinSelf(team * intraOp + i);
+            registerSelf("intra-op", team * intraOp + i);
+        }
+    });
+}
+
+void ComputeThreads::startInterOp() {
+    unsigned n = interOp;
+    atomic<unsigned> arrived(0);
+    atomic<unsigned> done(0);
+
+    // Each task blocks until all have started, so every pool thread gets one
+    for (unsigned i = 0; i < n; i++) {
+        at::launch([&arrived, &done, n] () {
+            unsigned slot = arrived++;
+            pinSelf(numTeams * intraOp + slot);
+            registerSelf("inter-op", slot);
+            while (arrived < n) sched_yield();
+            ++done;
+        });
+    }
+
+    while (done < n) sched_yield();
+}
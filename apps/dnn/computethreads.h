@@ -0,0 +1,45 @@
+#ifndef __COMPUTETHREADS_H
+#define __COMPUTETHREADS_H
+
+#include <string>
+#include <vector>
+
+// Controls libtorch's intra-op (OpenMP) and inter-op thread pools, pins their
+// threads to cores, and registers every thread that runs model code with the
+// harness thread registry, so the profiler can attach to all of them, not
+// just the request threads.
+//
+// Cores are handed out from cpus in a fixed order: team t (one per thread
+// that calls model.forward) gets cores [t * intraOp, (t + 1) * intraOp), and
+// the inter-op pool gets the interOp cores after all teams. The list wraps
+// around if it is shorter than that.
+class ComputeThreads {
+    private:
+        static std::vector<int> cpus;
+        static unsigned intraOp;
+        static unsigned interOp;
+        static unsigned numTeams;
+
+        static void pinSelf(unsigned slot);
+        static void registerSelf(const char* role, unsigned slot);
+
+    public:
+        // Parses a cpu list such as "0-3,8,10-11". Returns false if malformed.
+        static bool parseCpuList(const std::string& list, std::vector<int>& cpus);
+
+        // Must run before the model is loaded or run, since libtorch only
+        // allows setting the inter-op pool size before it is first used.
+        // An empty cpu list leaves threads unpinned; 0 thread counts keep
+        // libtorch's defaults.
+        static void init(const std::vector<int>& cpus, unsigned intraOp,
+                         unsigned interOp, unsigned numTeams);
+
+        // Called from a thread that will run model.forward. Pins the thread
+        // and its OpenMP team, and records all of their TIDs.
+        static void startTeam(unsigned team);
+
+        // Pins the inter-op pool threads and records their TIDs
+        static void startInterOp();
+};
+
+#endif // __COMPUTETHREADS_H
@@ -0,0 +1,108 @@
+// Decodes and normalizes a subset of the imagenet validation set once, and
+// writes it out as a tensor pack (see tensorpack.h) for the Tailbench client.
+
+#include <torch/torch.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "imagefolder_dataset.h"
+#include "tensorpack.h"
+
+using dataset::ImageFolderDataset;
+using namespace std;
+
+void usage() {
+    cerr << "usage: imagenet-pack -i <path-to-imagenet-dataset> -o <outFile>"
+         << " [-n <numSamples>] [-s <firstSample>] [-k <stride>]" << endl
+         << "Packs samples firstSample, firstSample + stride, ... of the"
+         << " validation set (all of them by default)" << endl;
+    exit(-1);
+}
+
+int main(int argc, char* argv[]) {
+    string imagenetPath;
+    string outPath;
+    uint64_t numSamples = 0;
+    uint64_t first = 0;
+    uint64_t stride = 1;
+
+    int c;
+    while ((c = getopt(argc, argv, "i:o:n:s:k:h")) != -1) {
+        switch (c) {
+            case 'i': imagenetPath = optarg; break;
+            case 'o': outPath = optarg; break;
+            case 'n': numSamples = atol(optarg); break;
+            case 's': first = atol(optarg); break;
+            case 'k': stride = atol(optarg); break;
+            default: usage(); break;
+        }
+    }
+    if (imagenetPath.empty() || outPath.empty() || stride == 0) usage();
+
+    // Same preprocessing as the client's data loader
+    auto valDataset = ImageFolderDataset(imagenetPath, ImageFolderDataset::Mode::VAL, {224, 224})
+        .map(torch::data::transforms::Normalize<>({0.485, 0.456, 0.406}, {0.229, 0.224, 0.225}));
+
+    uint64_t available = valDataset.size().value();
+    uint64_t maxSamples = first < available ? (available - first + stride - 1) / stride : 0;
+    if (numSamples == 0 || numSamples > maxSamples) numSamples = maxSamples;
+    if (numSamples == 0) {
+        cerr << "No samples selected from " << imagenetPath << endl;
+        exit(-1);
+    }
+
+    FILE* f = fopen(outPath.c_str(), "wb");
+    if (!f) {
+        cerr << "Could not write " << outPath << endl;
+        exit(-1);
+    }
+
+    // Samples are written as they are decoded, since a full pack need not
+    // fit in memory. The data offset only depends on numSamples, so the
+    // header and targets are filled in afterwards.
+    vector<int32_t> targets;
+    vector<int64_t> shape;
+    targets.reserve(numSamples);
+    for (uint64_t i = 0; i < numSamples; i++) {
+        auto example = valDataset.get(first + i * stride);
+        torch::Tensor s = example.data.to(torch::kFloat).contiguous();
+        targets.push_back(example.target.item<int32_t>());
+
+        if (i == 0) {
+            if ((uint32_t)s.dim() > TENSOR_PACK_MAX_DIMS) {
+                cerr << "Samples have too many dimensions (" << s.dim() << ")"
+                     << endl;
+                exit(-1);
+            }
+            shape.assign(s.sizes().begin(), s.sizes().end());
+            if (fseek(f, TensorPack::dataOffset(numSamples), SEEK_SET) != 0) {
+                cerr << "Could not write " << outPath << endl;
+                exit(-1);
+            }
+        }
+
+        if (s.sizes() != at::IntArrayRef(shape) ||
+                fwrite(s.data_ptr<float>(), sizeof(float), s.numel(), f) !=
+                (size_t)s.numel()) {
+            cerr << "Could not write sample " << i << " to " << outPath << endl;
+            exit(-1);
+        }
+    }
+
+    if (fseek(f, 0, SEEK_SET) != 0 ||
+            !TensorPack::writeHeader(f, numSamples, shape.size(), shape.data(),
+                targets.data()) ||
+            fclose(f) != 0) {
+        cerr << "Could not write " << outPath << endl;
+        exit(-1);
+    }
+
+    cout << "Packed " << numSamples << " samples of shape "
+         << at::IntArrayRef(shape) << " into " << outPath << endl;
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include <fstream>
 #include <sstream>
 #include <stdlib.h>
+#include "computethreads.h"
 #include "server.h"
 #include "tbench_server.h"
 
@@ -20,7 +21,11 @@ unsigned long numReqsToProcess = 1000L;
 atomic_ulong numReqsProcessed(0);
 
 inline void usage() {
-    cerr << "db_integrated [-m <modulePath>] [-r <numRequests]" << endl;
+    cerr << "db_integrated [-m <modulePath>] [-r <numRequests]" << endl
+         << "    [-n <numServers>] [-b <maxBatchSize> [-t <batchTimeoutUs>] [-w <numBatchWorkers>]]"
+         << endl
+         << "    [-i <intraOpThreads>] [-j <interOpThreads>] [-c <cpuList, e.g. 0-3,8>]"
+         << endl;
 }
 
 inline void sanityCheckArg(string msg) {
@@ -33,9 +38,16 @@ inline void sanityCheckArg(string msg) {
 
 int main(int argc, char* argv[]) {
     string modulePath = "module";
+    unsigned numServers = 0; // Defaults to one per batch slot
+    unsigned maxBatch = 0;   // 0 disables dynamic batching
+    uint64_t batchTimeoutUs = 1000;
+    unsigned numWorkers = 1;
+    unsigned intraOpThreads = 0; // 0 keeps libtorch's defaults
+    unsigned interOpThreads = 0;
+    vector<int> cpus;            // empty leaves compute threads unpinned
 
     int c;
-    string optString = "m:r:h";
+    string optString = "m:r:n:b:t:w:i:j:c:h";
     while ((c = getopt(argc, argv, optString.c_str())) != -1) {
         switch (c) {
             case 'm':
@@ -48,6 +60,45 @@ int main(int argc, char* argv[]) {
                 numReqsToProcess = atol(optarg);
                 break;
 
+            case 'n':
+                sanityCheckArg("Missing #servers");
+                numServers = atoi(optarg);
+                break;
+
+            case 'b':
+                sanityCheckArg("Missing max batch size");
+                maxBatch = atoi(optarg);
+                break;
+
+            case 't':
+                sanityCheckArg("Missing batch timeout");
+                batchTimeoutUs = atol(optarg);
+                break;
+
+            case 'w':
+                sanityCheckArg("Missing #batch workers");
+                numWorkers = atoi(optarg);
+                break;
+
+            case 'i':
+                sanityCheckArg("Missing #intra-op threads");
+                intraOpThreads = atoi(optarg);
+                break;
+
+            case 'j':
+                sanityCheckArg("Missing #inter-op threads");
+                interOpThreads = atoi(optarg);
+                break;
+
+            case 'c':
+                sanityCheckArg("Missing cpu list");
+                if (!ComputeThreads::parseCpuList(optarg, cpus)) {
+                    cerr << "Malformed cpu list " << optarg << endl;
+                    usage();
+                    exit(-1);
+                }
+                break;
+
             case 'h':
                 usage();
                 exit(0);
@@ -61,7 +112,20 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    cout << "Using " << at::get_num_threads() << "threads" << endl;
+    // With dynamic batching, each server thread holds at most one request
+    // in flight, so we need at least enough of them to fill every worker's
+    // batch
+    if (maxBatch > 0) {
+        if (numServers == 0) numServers = maxBatch * numWorkers;
+        cout << "Dynamic batching: maxBatch=" << maxBatch << ", timeout="
+             << batchTimeoutUs << "us, " << numWorkers << " workers" << endl;
+    }
+    if (numServers == 0) numServers = 1;
+
+    // Each server thread, or each batch worker with batching, runs the model
+    // with its own team of intra-op threads
+    ComputeThreads::init(cpus, intraOpThreads, interOpThreads,
+            maxBatch > 0 ? numWorkers : numServers);
 
     torch::jit::script::Module model;
     try {
@@ -74,13 +138,41 @@ int main(int argc, char* argv[]) {
     }
     cout << "Successfully loaded model from " << modulePath << endl;
 
-    tBenchServerInit(1);
+    ComputeThreads::startInterOp();
+
+    BatchQueue* batchQueue = NULL;
+    if (maxBatch > 0) batchQueue = new BatchQueue(maxBatch, batchTimeoutUs);
+
+    tBenchServerInit(numServers);
+
+    Server::init(numReqsToProcess, numServers);
+    Server** servers = new Server* [numServers];
+    for (unsigned i = 0; i < numServers; i++)
+        servers[i] = new Server(i, model, batchQueue);
 
-    Server::init(numReqsToProcess, 1);
-    Server** servers = new Server* [0];
-    servers[0] = new Server(model);
+    // Batch workers run until the harness ends the process
+    if (batchQueue) {
+        for (unsigned i = 0; i < numWorkers; i++) {
+            pthread_t worker;
+            pthread_create(&worker, NULL, BatchWorker::run,
+                    new BatchWorker(i, model, batchQueue));
+            pthread_detach(worker);
+        }
+    }
+
+    pthread_t* threads = NULL;
+    if (numServers > 1) {
+        threads = new pthread_t [numServers - 1];
+        for (unsigned i = 0; i < numServers - 1; i++)
+            pthread_create(&threads[i], NULL, Server::run, servers[i]);
+    }
+
+    Server::run(servers[numServers - 1]);
 
-    Server::run(servers[0]);
+    if (numServers > 1) {
+        for (unsigned i = 0; i < numServers - 1; i++)
+            pthread_join(threads[i], NULL);
+    }
 
     tBenchServerFinish();
 
@@ -1,11 +1,12 @@
 #include <cstring>
 #include <iostream>
-#include <sstream>
 
 #include <assert.h>
 #include <unistd.h>
 
+#include "computethreads.h"
 #include "server.h"
+#include "tensorreq.h"
 #include "tbench_server.h"
 
 #include <torch/script.h>
@@ -16,7 +17,117 @@ using namespace std;
 unsigned long Server::numReqsToProcess = 0;
 volatile atomic_ulong Server::numReqsProcessed(0);
 
-Server::Server(torch::jit::script::Module model) : model(model) {
+/*******************************************************************************
+ * BatchQueue
+ *******************************************************************************/
+BatchQueue::BatchQueue(size_t maxBatch, uint64_t timeoutUs)
+    : maxBatch(maxBatch)
+    , timeout(timeoutUs)
+{ }
+
+torch::Tensor BatchQueue::infer(torch::Tensor input) {
+    BatchSlot slot;
+    slot.input = input;
+    slot.done = false;
+
+    std::unique_lock<std::mutex> l(lock);
+    slot.enqueued = std::chrono::steady_clock::now();
+    pending.push_back(&slot);
+    notEmpty.notify_one();
+    while (!slot.done) slot.cv.wait(l);
+
+    return slot.prediction;
+}
+
+void BatchQueue::nextBatch(std::vector<BatchSlot*>& batch) {
+    batch.clear();
+
+    std::unique_lock<std::mutex> l(lock);
+
+    // Wait for the batch to fill up, but never hold the oldest request back
+    // for longer than the timeout. Another worker may take the requests we
+    // were waiting on, so start over from the new oldest one whenever the
+    // queue drains; a batch is never empty.
+    while (true) {
+        while (pending.empty()) notEmpty.wait(l);
+        auto deadline = pending.front()->enqueued + timeout;
+        while (!pending.empty() && pending.size() < maxBatch &&
+                std::chrono::steady_clock::now() < deadline) {
+            notEmpty.wait_until(l, deadline);
+        }
+        if (!pending.empty()) break;
+    }
+
+    while (!pending.empty() && batch.size() < maxBatch) {
+        batch.push_back(pending.front());
+        pending.pop_front();
+    }
+
+    // Let another worker start on what is left
+    if (!pending.empty()) notEmpty.notify_one();
+}
+
+void BatchQueue::complete(std::vector<BatchSlot*>& batch) {
+    std::lock_guard<std::mutex> l(lock);
+    for (BatchSlot* slot : batch) {
+        slot->done = true;
+        slot->cv.notify_one();
+    }
+}
+
+/*******************************************************************************
+ * BatchWorker
+ *******************************************************************************/
+BatchWorker::BatchWorker(unsigned id, torch::jit::script::Module model,
+                         BatchQueue* queue)
+    : model(model)
+    , queue(queue)
+    , id(id)
+{ }
+
+void BatchWorker::_run() {
+    torch::InferenceMode guard;
+    ComputeThreads::startTeam(id);
+    std::vector<BatchSlot*> batch;
+    std::vector<torch::Tensor> inputs;
+
+    while (true) {
+        queue->nextBatch(batch);
+
+        inputs.clear();
+        for (BatchSlot* slot : batch) inputs.push_back(slot->input);
+
+        std::vector<torch::jit::IValue> modelInputs;
+        modelInputs.push_back(torch::cat(inputs, 0));
+        auto output = model.forward(modelInputs).toTensor();
+        auto predictions = output.argmax(1);
+
+        // Scatter per-request results back, in batch order
+        int64_t row = 0;
+        for (BatchSlot* slot : batch) {
+            int64_t rows = slot->input.size(0);
+            slot->prediction = predictions.narrow(0, row, rows).clone();
+            row += rows;
+        }
+
+        queue->complete(batch);
+    }
+}
+
+void* BatchWorker::run(void* v) {
+    BatchWorker* worker = static_cast<BatchWorker*> (v);
+    worker->_run();
+    return NULL;
+}
+
+/*******************************************************************************
+ * Server
+ *******************************************************************************/
+Server::Server(int id, torch::jit::script::Module model, BatchQueue* batchQueue)
+    : model(model)
+    , batchQueue(batchQueue)
+    , id(id)
+{
     model.eval();
     torch::InferenceMode no_grad;
 }
@@ -25,6 +136,9 @@ Server::~Server() {
 }
 
 void Server::_run() {
+    torch::InferenceMode guard;
+    // With batching, only the batch workers run the model
+    if (!batchQueue) ComputeThreads::startTeam(id);
     tBenchServerThreadStart();
 
     while (numReqsProcessed < numReqsToProcess) {
@@ -34,35 +148,37 @@ void Server::_run() {
 }
 
 void Server::processRequest() {
-    //const unsigned MAX_DATA_LEN = 1000000;
-    //char* data = new char[MAX_DATA_LEN];
     void* dataPtr;
 
     size_t len = tBenchRecvReq(&dataPtr);
-    //memcpy(reinterpret_cast<void*>(data), dataPtr, len);
-	string data_as_string = string(reinterpret_cast<char*>(dataPtr), len-1);
-    stringstream data_ss;
-    data_ss << data_as_string;
-    torch::Tensor datainTensor;
-    torch::load(datainTensor, data_ss);
-    //delete[] data;
-
-    //c10::InferenceMode guard;
-    std::vector<torch::jit::IValue> inputs;
-    inputs.push_back(datainTensor);
-    auto output = model.forward(inputs).toTensor();
-    auto prediction= output.argmax(1);
-
-    // Serialize and respond back to client
-    std::stringstream rstream;
-    torch::save(prediction, rstream);
-    std::string rstr = rstream.str();
-    unsigned resLen = rstr.length();
-    char* res = new char[resLen];
-    strncpy(res, rstr.c_str(), resLen);
-
-    tBenchSendResp(reinterpret_cast<void*>(res), resLen);
-    delete[] res;
+    const TensorReq* req = reinterpret_cast<const TensorReq*>(dataPtr);
+    assert(len >= sizeof(TensorReq) && len == tensorReqLen(req));
+    assert(req->dtype == TENSOR_FLOAT32 && req->ndim <= TENSOR_MAX_DIMS);
+
+    // Wraps the request buffer, which stays valid until tBenchSendResp()
+    torch::Tensor datainTensor = torch::from_blob(const_cast<float*>(req->data),
+            at::IntArrayRef(req->shape, req->ndim), torch::kFloat);
+
+    torch::Tensor prediction;
+    if (batchQueue) {
+        prediction = batchQueue->infer(datainTensor);
+    } else {
+        std::vector<torch::jit::IValue> inputs;
+        inputs.push_back(datainTensor);
+        auto output = model.forward(inputs).toTensor();
+        prediction = output.argmax(1);
+    }
+
+    // Respond back to client
+    auto predictions = prediction.to(torch::kInt32).contiguous();
+    uint32_t numPredictions = predictions.numel();
+    assert(numPredictions <= MAX_PREDICTIONS);
+    resp.numPredictions = numPredictions;
+    memcpy(resp.predictions, predictions.data_ptr<int32_t>(),
+            numPredictions * sizeof(int32_t));
+
+    tBenchSendResp(reinterpret_cast<void*>(&resp),
+            predictionRespLen(numPredictions));
 }
 
 void* Server::run(void* v) {
@@ -2,16 +2,73 @@
 #define __SERVER_H
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <vector>
 
 #include <torch/script.h> // One-stop header.
 
+#include "tensorreq.h"
+
+// A request waiting to be batched. Lives on the stack of the server thread
+// that received it until a BatchWorker fills in the prediction.
+struct BatchSlot {
+    torch::Tensor input;
+    torch::Tensor prediction;
+    std::chrono::steady_clock::time_point enqueued;
+    bool done;
+    std::condition_variable cv;
+};
+
+// Coalesces requests from many server threads into batches of up to
+// maxBatch inputs. A batch is released once it is full, or once its oldest
+// request has waited timeoutUs.
+class BatchQueue {
+    private:
+        std::mutex lock;
+        std::condition_variable notEmpty;
+        std::deque<BatchSlot*> pending;
+        size_t maxBatch;
+        std::chrono::microseconds timeout;
+
+    public:
+        BatchQueue(size_t maxBatch, uint64_t timeoutUs);
+
+        // Called by server threads; blocks until the input's batch has run
+        torch::Tensor infer(torch::Tensor input);
+
+        // Called by batch workers
+        void nextBatch(std::vector<BatchSlot*>& batch);
+        void complete(std::vector<BatchSlot*>& batch);
+};
+
+// Runs batches from a BatchQueue through the model. All workers share the
+// same JIT module.
+class BatchWorker {
+    private:
+        torch::jit::script::Module model;
+        BatchQueue* queue;
+        unsigned id;
+
+        void _run();
+
+    public:
+        BatchWorker(unsigned id, torch::jit::script::Module model,
+                    BatchQueue* queue);
+
+        static void* run(void* v);
+};
+
 class Server {
     private:
         static unsigned long numReqsToProcess;
         static volatile std::atomic_ulong numReqsProcessed;
 
         torch::jit::script::Module model;
+        BatchQueue* batchQueue; // NULL if requests run unbatched
+        PredictionResp resp;
 
         int id;
 
@@ -19,7 +76,8 @@ class Server {
         void processRequest();
 
     public:
-        Server(torch::jit::script::Module model);
+        Server(int id, torch::jit::script::Module model,
+               BatchQueue* batchQueue = NULL);
         ~Server();
 
         static void* run(void* v);
@@ -0,0 +1,122 @@
+#ifndef __TENSORPACK_H
+#define __TENSORPACK_H
+
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Pre-decoded, normalized input samples that the client maps and sends
+// without touching the original images.
+//
+// Layout:
+//   TensorPackHeader
+//   int32_t targets[numSamples]
+//   padding up to a multiple of TENSOR_PACK_ALIGN
+//   float data[numSamples][shape[0]]...[shape[ndim-1]]
+const char TENSOR_PACK_MAGIC[8] = { 'T', 'N', 'S', 'R', 'P', 'A', 'K', '1' };
+const uint32_t TENSOR_PACK_MAX_DIMS = 4;
+const uint64_t TENSOR_PACK_ALIGN = 4096;
+
+struct TensorPackHeader {
+    char magic[8];
+    uint64_t numSamples;
+    uint32_t ndim;                        // per sample, excluding the batch dim
+    uint32_t pad;
+    int64_t shape[TENSOR_PACK_MAX_DIMS];
+    uint64_t dataOffset;                  // from the start of the file
+};
+
+class TensorPack {
+    private:
+        void* addr;
+        size_t size;
+        const TensorPackHeader* hdr;
+        const int32_t* targets;
+        const float* data;
+        uint64_t numel;
+
+    public:
+        TensorPack() : addr(NULL), size(0), hdr(NULL), targets(NULL), data(NULL),
+            numel(0) {}
+
+        ~TensorPack() {
+            if (addr) munmap(addr, size);
+        }
+
+        static uint64_t sampleNumel(uint32_t ndim, const int64_t* shape) {
+            uint64_t n = 1;
+            for (uint32_t d = 0; d < ndim; d++) n *= shape[d];
+            return n;
+        }
+
+        static uint64_t dataOffset(uint64_t numSamples) {
+            uint64_t off = sizeof(TensorPackHeader) + numSamples * sizeof(int32_t);
+            return (off + TENSOR_PACK_ALIGN - 1) & ~(TENSOR_PACK_ALIGN - 1);
+        }
+
+        // Writes the header and targets, leaving f positioned at the start of
+        // the sample data. The caller then appends numSamples samples in order,
+        // or has already written them there.
+        static bool writeHeader(FILE* f, uint64_t numSamples, uint32_t ndim,
+                                const int64_t* shape, const int32_t* targets) {
+            TensorPackHeader h;
+            memset(&h, 0, sizeof(h));
+            memcpy(h.magic, TENSOR_PACK_MAGIC, sizeof(h.magic));
+            h.numSamples = numSamples;
+            h.ndim = ndim;
+            for (uint32_t d = 0; d < ndim; d++) h.shape[d] = shape[d];
+            h.dataOffset = dataOffset(numSamples);
+
+            bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+            if (numSamples > 0)
+                ok = ok && fwrite(targets, sizeof(int32_t), numSamples, f) == numSamples;
+            return ok && fseek(f, h.dataOffset, SEEK_SET) == 0;
+        }
+
+        // Maps a pack written with writeHeader(). Returns false on error.
+        bool open(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TensorPackHeader)) {
+                close(fd);
+                return false;
+            }
+            size = st.st_size;
+            // Populate up front so no request pays for a page fault
+            addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            close(fd);
+            if (addr == MAP_FAILED) {
+                addr = NULL;
+                return false;
+            }
+
+            hdr = static_cast<const TensorPackHeader*>(addr);
+            if (memcmp(hdr->magic, TENSOR_PACK_MAGIC, sizeof(hdr->magic)) != 0 ||
+                    hdr->ndim > TENSOR_PACK_MAX_DIMS)
+                return false;
+
+            numel = sampleNumel(hdr->ndim, hdr->shape);
+            targets = reinterpret_cast<const int32_t*>(hdr + 1);
+            data = reinterpret_cast<const float*>(
+                    static_cast<const char*>(addr) + hdr->dataOffset);
+            return hdr->dataOffset == dataOffset(hdr->numSamples) &&
+                size == hdr->dataOffset + hdr->numSamples * numel * sizeof(float);
+        }
+
+        uint64_t numSamples() const { return hdr->numSamples; }
+        uint32_t ndim() const { return hdr->ndim; }
+        const int64_t* shape() const { return hdr->shape; }
+        uint64_t sampleNumel() const { return numel; }
+
+        const float* sample(uint64_t i) const { return data + i * numel; }
+        int32_t target(uint64_t i) const { return targets[i]; }
+};
+
+#endif // __TENSORPACK_H
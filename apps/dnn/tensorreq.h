@@ -0,0 +1,40 @@
+#ifndef __TENSORREQ_H
+#define __TENSORREQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Wire format of an inference request: a small fixed header followed by the
+// contiguous, row-major input tensor. The server wraps data in place with
+// torch::from_blob, so no deserialization happens per request.
+const uint32_t TENSOR_MAX_DIMS = 8;
+
+enum TensorDtype : uint32_t { TENSOR_FLOAT32 = 0 };
+
+struct TensorReq {
+    uint32_t dtype; // TensorDtype
+    uint32_t ndim;
+    int64_t shape[TENSOR_MAX_DIMS];
+    float data[0];
+};
+
+inline size_t tensorReqLen(const TensorReq* req) {
+    size_t numel = 1;
+    for (uint32_t d = 0; d < req->ndim; d++) numel *= req->shape[d];
+    return sizeof(TensorReq) + numel * sizeof(float);
+}
+
+// Wire format of the response: the predicted class of every input in the
+// request batch
+const uint32_t MAX_PREDICTIONS = 256;
+
+struct PredictionResp {
+    uint32_t numPredictions;
+    int32_t predictions[MAX_PREDICTIONS];
+};
+
+inline size_t predictionRespLen(uint32_t numPredictions) {
+    return offsetof(PredictionResp, predictions) + numPredictions * sizeof(int32_t);
+}
+
+#endif // __TENSORREQ_H
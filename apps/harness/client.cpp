@@ -48,7 +48,15 @@ Client::Client(int _nthreads) {
     pthread_mutex_init(&lock, nullptr);
     pthread_barrier_init(&barrier, nullptr, nthreads);
 
+    maxInFlight = getOpt<int>("TBENCH_MAX_INFLIGHT", 100000);
+    pthread_cond_init(&inFlightCv, nullptr);
+
     minSleepNs = getOpt("TBENCH_MINSLEEPNS", 0);
+    reportWindowNs = getOpt<double>("TBENCH_REPORT_SECS", 1.0) * 1e9;
+    if (reportWindowNs == 0) reportWindowNs = 1000*1000*1000;
+    detectLate = true;
+    lateThresholdNs = getOpt<uint64_t>("TBENCH_LATE_THRESHOLD_NS", 50*1000);
+    roiStartNs = 0;
     seed = getOpt("TBENCH_RANDSEED", 0);
     lambda = getOpt<double>("TBENCH_QPS", 1000.0) * 1e-9;
 
@@ -56,11 +64,17 @@ Client::Client(int _nthreads) {
 
     startedReqs = 0;
     numReqsInFlight = 0;
+    gotCtrs = false;
+
+    tracer = &Tracer::get();
+    tracer->setRole("client");
 
     tBenchClientInit();
 }
 
 Request* Client::startReq() {
+    uint64_t startTsc = Tracer::now();
+
     if (status == INIT) {
         pthread_barrier_wait(&barrier); // Wait for all threads to start up
 
@@ -83,6 +97,10 @@ Request* Client::startReq() {
 
     pthread_mutex_lock(&lock);
 
+    while (numReqsInFlight >= maxInFlight) {
+        pthread_cond_wait(&inFlightCv, &lock);
+    }
+
     Request* req = new Request;
     size_t len = tBenchClientGenReq(&req->data);
     req->len = len;
@@ -98,12 +116,25 @@ Request* Client::startReq() {
 
     if (curNs < req->genNs) {
         sleepUntil(std::max(req->genNs, curNs + minSleepNs));
+    } else if (detectLate && curNs - req->genNs > lateThresholdNs) {
+        pthread_mutex_lock(&lock);
+        if (status == ROI) {
+            lateGenTimes.push_back(req->genNs);
+            lateLags.push_back(curNs - req->genNs);
+        }
+        pthread_mutex_unlock(&lock);
     }
 
+    tracer->requestBegin(req->id, req->genNs);
+    tracer->slice("startReq", req->id, startTsc, Tracer::now());
+
     return req;
 }
 
 void Client::finiReq(Response* resp) {
+    uint64_t startTsc = Tracer::now();
+    tracer->requestEnd(resp->id);
+
     pthread_mutex_lock(&lock);
 
     auto it = inFlightReqs.find(resp->id);
@@ -122,26 +153,42 @@ void Client::finiReq(Response* resp) {
         queueTimes.push_back(qtime);
         svcTimes.push_back(resp->svcNs);
         sjrnTimes.push_back(sjrn);
+        doneTimes.push_back(curNs);
+
+        for (int c = 0; c < NUM_CTRS; ++c) {
+            ctrDeltas.push_back(resp->ctrs[c]);
+            gotCtrs |= (resp->ctrs[c] != 0);
+        }
     }
 
     delete req;
     inFlightReqs.erase(it);
     numReqsInFlight--;
+    pthread_cond_signal(&inFlightCv);
     pthread_mutex_unlock(&lock);
+
+    tracer->slice("finiReq", resp->id, startTsc, Tracer::now());
 }
 
 void Client::_startRoi() {
     assert(status == WARMUP);
     status = ROI;
+    roiStartNs = getCurNs();
 
     queueTimes.clear();
     svcTimes.clear();
     sjrnTimes.clear();
+    ctrDeltas.clear();
+    doneTimes.clear();
+    lateGenTimes.clear();
+    lateLags.clear();
 }
 
+// The networked server signals ROI_BEGIN on every connection, so only the
+// first call starts the ROI
 void Client::startRoi() {
     pthread_mutex_lock(&lock);
-    _startRoi();
+    if (status == WARMUP) _startRoi();
     pthread_mutex_unlock(&lock);
 }
 
@@ -158,17 +205,123 @@ void Client::dumpStats() {
                     sizeof(sjrnTimes[r]));
     }
     out.close();
+
+    // Row r holds the counters of the request in row r of lats.bin
+    if (gotCtrs) {
+        std::ofstream ctrsOut("ctrs.bin", std::ios::out | std::ios::binary);
+        ctrsOut.write(reinterpret_cast<const char*>(ctrDeltas.data()),
+                ctrDeltas.size() * sizeof(ctrDeltas[0]));
+        ctrsOut.close();
+    }
+
+    dumpWindows();
+    tracer->dump();
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t idx = std::min(sorted.size() - 1,
+            static_cast<size_t>(p * sorted.size()));
+    return sorted[idx];
+}
+
+// Writes windows.csv, with the throughput and latency of each
+// TBENCH_REPORT_SECS window of the ROI, and warns if requests were sent late
+void Client::dumpWindows() {
+    if (status != ROI) return;
+
+    // A trailing partial window shorter than half a window is folded into
+    // the previous one
+    uint64_t endNs = getCurNs();
+    uint64_t roiNs = endNs - roiStartNs;
+    size_t nwindows = std::max<size_t>(1,
+            (roiNs + reportWindowNs / 2) / reportWindowNs);
+
+    std::vector<std::vector<uint64_t>> sjrns(nwindows);
+    for (size_t r = 0; r < sjrnTimes.size(); ++r) {
+        size_t w = (doneTimes[r] - roiStartNs) / reportWindowNs;
+        sjrns[std::min(w, nwindows - 1)].push_back(sjrnTimes[r]);
+    }
+
+    // Late requests are attributed to the window they should have been sent in
+    std::vector<uint64_t> lateReqs(nwindows, 0);
+    std::vector<uint64_t> maxLag(nwindows, 0);
+    uint64_t worstLag = 0;
+    for (size_t l = 0; l < lateGenTimes.size(); ++l) {
+        size_t w = (lateGenTimes[l] > roiStartNs) ?
+            (lateGenTimes[l] - roiStartNs) / reportWindowNs : 0;
+        w = std::min(w, nwindows - 1);
+        lateReqs[w]++;
+        maxLag[w] = std::max(maxLag[w], lateLags[l]);
+        worstLag = std::max(worstLag, lateLags[l]);
+    }
+
+    std::ofstream out("windows.csv");
+    out << "window,start_s,reqs,qps,p50_us,p95_us,p99_us,max_us,late_reqs,"
+        "max_late_us" << std::endl;
+    for (size_t w = 0; w < nwindows; ++w) {
+        std::vector<uint64_t>& s = sjrns[w];
+        std::sort(s.begin(), s.end());
+
+        uint64_t startNs = w * reportWindowNs;
+        uint64_t lenNs = (w == nwindows - 1) ?
+            roiNs - std::min(roiNs, startNs) : reportWindowNs;
+        double qps = lenNs ? s.size() * 1e9 / lenNs : 0.0;
+
+        out << w << "," << startNs / 1e9 << "," << s.size() << "," << qps
+            << "," << percentile(s, 0.5) / 1e3 << ","
+            << percentile(s, 0.95) / 1e3 << ","
+            << percentile(s, 0.99) / 1e3 << ","
+            << (s.empty() ? 0 : s.back()) / 1e3 << "," << lateReqs[w] << ","
+            << maxLag[w] / 1e3 << std::endl;
+    }
+    out.close();
+
+    if (!lateGenTimes.empty()) {
+        double frac = 100.0 * lateGenTimes.size() /
+            std::max<size_t>(sjrnTimes.size(), 1);
+        std::cerr << "[CLIENT] " << lateGenTimes.size() << " ROI requests ("
+            << frac << "%) were sent more than " << lateThresholdNs / 1e3
+            << " us behind schedule, by up to " << worstLag / 1e3 << " us"
+            << std::endl;
+        if (frac > 1.0) {
+            std::cerr << "[CLIENT] WARNING: the client could not keep up with"
+                " TBENCH_QPS, so latencies include time spent waiting in the"
+                " client" << std::endl;
+        }
+    }
 }
 
 /*******************************************************************************
  * Networked Client
  *******************************************************************************/
-NetworkedClient::NetworkedClient(int nthreads, std::string serverip,
-        int serverport) : Client(nthreads)
-{
-    pthread_mutex_init(&sendLock, nullptr);
-    pthread_mutex_init(&recvLock, nullptr);
+int NetworkedClient::connectTo(struct addrinfo* servInfo) {
+    int fd = socket(servInfo->ai_family, servInfo->ai_socktype, \
+            servInfo->ai_protocol);
+    if (fd == -1) {
+        std::cerr << "socket() failed: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+
+    if (connect(fd, servInfo->ai_addr, servInfo->ai_addrlen) == -1) {
+        std::cerr << "connect() failed: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+
+    int nodelay = 1;
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+                reinterpret_cast<char*>(&nodelay), sizeof(nodelay)) == -1) {
+        std::cerr << "setsockopt(TCP_NODELAY) failed: " << strerror(errno) \
+            << std::endl;
+        exit(-1);
+    }
+
+    return fd;
+}
 
+NetworkedClient::NetworkedClient(int nthreads, int nconns,
+        std::string serverip, int serverport) : Client(nthreads)
+{
     // Get address info
     int status;
     struct addrinfo hints;
@@ -191,63 +344,56 @@ NetworkedClient::NetworkedClient(int nthreads, std::string serverip,
         exit(-1);
     }
 
-    serverFd = socket(servInfo->ai_family, servInfo->ai_socktype, \
-            servInfo->ai_protocol);
-    if (serverFd == -1) {
-        std::cerr << "socket() failed: " << strerror(errno) << std::endl;
-        exit(-1);
+    for (int c = 0; c < nconns; ++c) {
+        serverFds.push_back(connectTo(servInfo));
     }
-
-    if (connect(serverFd, servInfo->ai_addr, servInfo->ai_addrlen) == -1) {
-        std::cerr << "connect() failed: " << strerror(errno) << std::endl;
-        exit(-1);
+    sendLocks.resize(nconns);
+    for (int c = 0; c < nconns; ++c) {
+        pthread_mutex_init(&sendLocks[c], nullptr);
     }
+    errors.resize(nconns);
 
-    int nodelay = 1;
-    if (setsockopt(serverFd, IPPROTO_TCP, TCP_NODELAY,
-                reinterpret_cast<char*>(&nodelay), sizeof(nodelay)) == -1) {
-        std::cerr << "setsockopt(TCP_NODELAY) failed: " << strerror(errno) \
-            << std::endl;
-        exit(-1);
-    }
+    freeaddrinfo(servInfo);
 }
 
-bool NetworkedClient::send(Request* req) {
-    pthread_mutex_lock(&sendLock);
+bool NetworkedClient::send(int conn, Request* req) {
+    // The response may be in, and req freed, as soon as it's sent
+    uint64_t id = req->id;
+    uint64_t startTsc = Tracer::now();
+    pthread_mutex_lock(&sendLocks[conn]);
 
     int len = sizeof(Request) - MAX_REQ_BYTES + req->len;
-    int sent = sendfull(serverFd, reinterpret_cast<const char*>(req), len, 0);
+    int sent = sendfull(serverFds[conn], reinterpret_cast<const char*>(req),
+            len, 0);
     if (sent != len) {
-        error = strerror(errno);
+        errors[conn] = strerror(errno);
     }
 
-    pthread_mutex_unlock(&sendLock);
+    pthread_mutex_unlock(&sendLocks[conn]);
+    tracer->slice("send", id, startTsc, Tracer::now());
 
     return (sent == len);
 }
 
-bool NetworkedClient::recv(Response* resp) {
-    pthread_mutex_lock(&recvLock);
+bool NetworkedClient::recv(int conn, Response* resp) {
+    int fd = serverFds[conn];
 
     int len = sizeof(Response) - MAX_RESP_BYTES; // Read request header first
-    int recvd = recvfull(serverFd, reinterpret_cast<char*>(resp), len, 0);
+    int recvd = recvfull(fd, reinterpret_cast<char*>(resp), len, 0);
     if (recvd != len) {
-        error = strerror(errno);
+        errors[conn] = strerror(errno);
         return false;
     }
 
     if (resp->type == RESPONSE) {
-        recvd = recvfull(serverFd, reinterpret_cast<char*>(&resp->data), \
+        recvd = recvfull(fd, reinterpret_cast<char*>(&resp->data), \
                 resp->len, 0);
 
         if (static_cast<size_t>(recvd) != resp->len) {
-            error = strerror(errno);
+            errors[conn] = strerror(errno);
             return false;
         }
     }
 
-    pthread_mutex_unlock(&recvLock);
-
     return true;
 }
-
@@ -20,7 +20,9 @@
 #include "msgs.h"
 #include "msgs.h"
 #include "dist.h"
+#include "trace.h"
 
+#include <netdb.h>
 #include <pthread.h>
 #include <stdint.h>
 
@@ -38,17 +40,37 @@ class Client {
         pthread_mutex_t lock;
         pthread_barrier_t barrier;
 
+        // Senders block in startReq() while maxInFlight requests are
+        // outstanding, and finiReq() wakes them up
+        int maxInFlight;
+        pthread_cond_t inFlightCv;
+
         uint64_t minSleepNs;
         uint64_t seed;
         double lambda;
         ExpDist* dist;
 
+        Tracer* tracer;
+
         uint64_t startedReqs;
         std::unordered_map<uint64_t, Request*> inFlightReqs;
 
         std::vector<uint64_t> svcTimes;
         std::vector<uint64_t> queueTimes;
         std::vector<uint64_t> sjrnTimes;
+        std::vector<uint64_t> ctrDeltas; // NUM_CTRS per request
+        bool gotCtrs; // Whether the server measured any counters
+
+        // For the per-window report and for detecting when the client falls
+        // behind its arrival schedule, in which case latencies include time
+        // the request spent waiting in the client
+        uint64_t reportWindowNs;
+        bool detectLate;
+        uint64_t lateThresholdNs;
+        uint64_t roiStartNs;
+        std::vector<uint64_t> doneTimes; // When each ROI request finished
+        std::vector<uint64_t> lateGenTimes; // genNs of late ROI requests...
+        std::vector<uint64_t> lateLags; // ...and how late they were sent
 
         void _startRoi();
 
@@ -62,22 +84,46 @@ class Client {
 
         void startRoi();
         void dumpStats();
+        void dumpWindows();
 
 };
 
+// Opens nconns connections to the server. Sends on a connection are
+// serialized by its own lock, which is uncontended when every sender thread
+// has connections to itself. Each connection must be received on by a single
+// thread at a time.
 class NetworkedClient : public Client {
     private:
-        pthread_mutex_t sendLock;
-        pthread_mutex_t recvLock;
+        std::vector<int> serverFds;
+        std::vector<pthread_mutex_t> sendLocks;
+        std::vector<std::string> errors;
+
+        static int connectTo(struct addrinfo* servInfo);
+
+    public:
+        NetworkedClient(int nthreads, int nconns, std::string serverip,
+                int serverport);
+        int numConns() const { return serverFds.size(); }
+        bool send(int conn, Request* req);
+        bool recv(int conn, Response* resp);
+        const std::string& errmsg(int conn) const { return errors[conn]; }
+};
 
-        int serverFd;
-        std::string error;
+struct ShmHeader;
+
+// Talks to a ShmServer over its shared-memory rings. Each queue must be sent
+// on by a single thread and received on by a single thread. Implemented in
+// tbench_client_shm.cpp, so that client.o doesn't pull in shm_open().
+class ShmClient : public Client {
+    private:
+        ShmHeader* shm;
+        uint32_t spins;
 
     public:
-        NetworkedClient(int nthreads, std::string serverip, int serverport);
-        bool send(Request* req);
-        bool recv(Response* resp);
-        const std::string& errmsg() const { return error; }
+        ShmClient(int nthreads, std::string name);
+        int numQueues() const;
+        bool send(int queue, Request* req);
+        bool recv(int queue, Response* resp);
 };
 
 #endif
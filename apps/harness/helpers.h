@@ -18,12 +18,18 @@
 #define __HELPERS_H
 
 #include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <string.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <unistd.h>
 
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 template<typename T>
 static T getOpt(const char* name, T defVal) {
@@ -85,7 +91,7 @@ static int recvfull(int fd, char* msg, int len, int flags) {
     int recvd;
 
     while (remaining > 0) {
-        recvd = recv(fd, reinterpret_cast<void*>(cur), len, flags);
+        recvd = recv(fd, reinterpret_cast<void*>(cur), remaining, flags);
         if ((recvd == -1) || (recvd == 0)) break;
         cur += recvd;
         remaining -= recvd;
@@ -94,4 +100,86 @@ static int recvfull(int fd, char* msg, int len, int flags) {
     return (len - remaining);
 }
 
+// Listens on ip:port and blocks until nclients connections have been accepted
+static std::vector<int> acceptClients(std::string ip, int port, int nclients) {
+    // Get address info
+    int status;
+    struct addrinfo hints;
+    struct addrinfo* servInfo;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    std::stringstream portstr;
+    portstr << port;
+
+    const char* ipstr = (ip.size() > 0) ? ip.c_str() : nullptr;
+
+    if ((status = getaddrinfo(ipstr, portstr.str().c_str(), &hints, &servInfo))\
+            != 0) {
+        std::cerr << "getaddrinfo() failed: " << gai_strerror(status) \
+            << std::endl;
+        exit(-1);
+    }
+
+    // Create listening socket
+    int listener = socket(servInfo->ai_family, servInfo->ai_socktype, \
+            servInfo->ai_protocol);
+    if (listener == -1) {
+        std::cerr << "socket() failed: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+
+    int yes = 1;
+    if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) \
+            == -1)  {
+        std::cerr << "setsockopt() failed: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+
+    if (bind(listener, servInfo->ai_addr, servInfo->ai_addrlen) == -1) {
+        std::cerr << "bind() failed: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+
+    if (listen(listener, 10) == -1) {
+        std::cerr << "listen() failed: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+
+    // Establish connections with clients
+    std::vector<int> clientFds;
+    struct sockaddr_storage clientAddr;
+    socklen_t clientAddrSize;
+
+    for (int c = 0; c < nclients; ++c) {
+        clientAddrSize = sizeof(clientAddr);
+        memset(&clientAddr, 0, clientAddrSize);
+
+        int clientFd = accept(listener, \
+                reinterpret_cast<struct sockaddr*>(&clientAddr), \
+                &clientAddrSize);
+
+        if (clientFd == -1) {
+            std::cerr << "accept() failed: " << strerror(errno) << std::endl;
+            exit(-1);
+        }
+
+        int nodelay = 1;
+        if (setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY,
+                reinterpret_cast<char*>(&nodelay), sizeof(nodelay)) == -1) {
+            std::cerr << "setsockopt(TCP_NODELAY) failed: " << strerror(errno) \
+                << std::endl;
+            exit(-1);
+        }
+
+        clientFds.push_back(clientFd);
+    }
+
+    freeaddrinfo(servInfo);
+    return clientFds;
+}
+
 #endif
@@ -25,6 +25,11 @@ const int MAX_RESP_BYTES = 1 << 20; // 1 MB
 
 enum ResponseType { RESPONSE, ROI_BEGIN, FINISH };
 
+// Hardware counters the server measures around each request's handler when
+// TBENCH_PERF_CTRS=1 (see perfctrs.h)
+enum PerfCtr { CTR_INSTRS, CTR_CYCLES, CTR_LLC_MISSES, CTR_BRANCH_MISSES,
+    NUM_CTRS };
+
 struct Request {
     uint64_t id;
     uint64_t genNs;
@@ -36,6 +41,7 @@ struct Response {
     ResponseType type;
     uint64_t id;
     uint64_t svcNs;
+    uint64_t ctrs[NUM_CTRS]; // Deltas over svcNs, all 0 if not measured
     size_t len;
     char data[MAX_RESP_BYTES];
 };
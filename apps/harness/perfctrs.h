@@ -0,0 +1,149 @@
+/** $lic$
+ * Copyright (C) 2016-2017 by Massachusetts Institute of Technology
+ *
+ * This file is part of TailBench.
+ *
+ * If you use this software in your research, we request that you reference the
+ * TaiBench paper ("TailBench: A Benchmark Suite and Evaluation Methodology for
+ * Latency-Critical Applications", Kasture and Sanchez, IISWC-2016) as the
+ * source in any publications that use this software, and that you send us a
+ * citation of your work.
+ *
+ * TailBench is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __PERFCTRS_H
+#define __PERFCTRS_H
+
+// User-level hardware counters for the calling thread, read with rdpmc from
+// the perf mmap page instead of a read() syscall, so sampling them around
+// every request costs tens of cycles. The counters form one perf group, so
+// they are always scheduled onto the PMU together. If the kernel doesn't let
+// us rdpmc (or the group is currently multiplexed out), we fall back to
+// read().
+
+#include "msgs.h"
+
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <iostream>
+
+class PerfCounters {
+    private:
+        int fds[NUM_CTRS];
+        struct perf_event_mmap_page* pages[NUM_CTRS];
+
+        static uint64_t rdpmc(uint32_t counter) {
+            uint32_t lo, hi;
+            __asm__ __volatile__("rdpmc" : "=a"(lo), "=d"(hi) : "c"(counter));
+            return lo | (static_cast<uint64_t>(hi) << 32);
+        }
+
+        uint64_t read(int c) const {
+            volatile struct perf_event_mmap_page* pc = pages[c];
+            uint32_t seq;
+            uint64_t count;
+            bool viaRdpmc;
+
+            // Retry if perf updated the page (e.g., on a context switch)
+            // while we were reading it
+            do {
+                seq = pc->lock;
+                __asm__ __volatile__("" ::: "memory");
+
+                uint32_t idx = pc->index;
+                viaRdpmc = pc->cap_user_rdpmc && idx;
+                count = pc->offset;
+                if (viaRdpmc) {
+                    uint32_t width = pc->pmc_width;
+                    int64_t pmc = rdpmc(idx - 1);
+                    pmc <<= 64 - width;
+                    pmc >>= 64 - width; // Sign-extend
+                    count += pmc;
+                }
+
+                __asm__ __volatile__("" ::: "memory");
+            } while (pc->lock != seq);
+
+            if (!viaRdpmc) {
+                if (::read(fds[c], &count, sizeof(count)) != sizeof(count)) {
+                    return 0;
+                }
+            }
+
+            return count;
+        }
+
+    public:
+        // Opens the group for the calling thread; check ok() afterwards
+        PerfCounters() {
+            const uint64_t configs[NUM_CTRS] = {
+                PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CPU_CYCLES,
+                PERF_COUNT_HW_CACHE_MISSES,
+                PERF_COUNT_HW_BRANCH_MISSES
+            };
+
+            for (int c = 0; c < NUM_CTRS; ++c) {
+                fds[c] = -1;
+                pages[c] = nullptr;
+            }
+
+            for (int c = 0; c < NUM_CTRS; ++c) {
+                struct perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = configs[c];
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+
+                fds[c] = syscall(__NR_perf_event_open, &attr, 0, -1,
+                        c == 0 ? -1 : fds[0], 0);
+                if (fds[c] == -1) {
+                    std::cerr << "[TBENCH_SERVER] perf_event_open() failed: " \
+                        << strerror(errno) << ", not measuring per-request" \
+                        " counters on this thread" << std::endl;
+                    close();
+                    return;
+                }
+
+                void* page = mmap(nullptr, sysconf(_SC_PAGESIZE), PROT_READ,
+                        MAP_SHARED, fds[c], 0);
+                if (page == MAP_FAILED) {
+                    std::cerr << "[TBENCH_SERVER] mmap(perf event) failed: " \
+                        << strerror(errno) << std::endl;
+                    close();
+                    return;
+                }
+                pages[c] = reinterpret_cast<struct perf_event_mmap_page*>(page);
+            }
+        }
+
+        ~PerfCounters() { close(); }
+
+        bool ok() const { return fds[0] != -1; }
+
+        void close() {
+            for (int c = 0; c < NUM_CTRS; ++c) {
+                if (pages[c]) munmap(pages[c], sysconf(_SC_PAGESIZE));
+                if (fds[c] != -1) ::close(fds[c]);
+                pages[c] = nullptr;
+                fds[c] = -1;
+            }
+        }
+
+        void readAll(uint64_t* vals) const {
+            for (int c = 0; c < NUM_CTRS; ++c) vals[c] = read(c);
+        }
+};
+
+#endif
@@ -21,10 +21,16 @@
 #include "dist.h"
 #include "helpers.h"
 #include "msgs.h"
+#include "perfctrs.h"
+#include "trace.h"
 
 #include <pthread.h>
 #include <stdint.h>
+#include <string.h>
 
+#include <atomic>
+#include <deque>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -33,20 +39,132 @@ class Server {
         struct ReqInfo {
             uint64_t id;
             uint64_t startNs;
+            uint64_t ctrs[NUM_CTRS]; // Start values, then deltas
+            uint64_t recvTsc; // Trace stamps, see trace.h
+            uint64_t appTsc;
+            uint64_t sendTsc;
         };
 
         uint64_t finishedReqs;
         uint64_t maxReqs;
         uint64_t warmupReqs;
 
+        // With TBENCH_ROI_SECS set, warmup and ROI are time windows measured
+        // from the first finished request, and the request counts are ignored
+        uint64_t warmupNs;
+        uint64_t roiNs;
+        std::atomic<uint64_t> firstNs;
+        std::atomic<uint64_t> roiStartNs;
+
+        enum Phase { WARMUP_PHASE, ROI_PHASE, DONE_PHASE };
+        std::atomic<int> phase;
+
+        enum WindowEvent { NO_EVENT, WARMUP_DONE, ROI_DONE };
+
+        // Called after each request finishes, with the number of requests
+        // finished so far. Tells the caller to start or end the ROI; each
+        // event is returned exactly once, even with concurrent callers.
+        WindowEvent windowEvent(uint64_t finished) {
+            int p = phase.load();
+            if (p == DONE_PHASE) return NO_EVENT;
+
+            bool due;
+            uint64_t curNs = 0;
+            if (roiNs) {
+                curNs = getCurNs();
+                uint64_t first = 0;
+                firstNs.compare_exchange_strong(first, curNs);
+                // The thread that ended warmup publishes roiStartNs after
+                // its CAS, so 0 here means the ROI has only just begun
+                uint64_t start = roiStartNs;
+                due = (p == WARMUP_PHASE) ? curNs >= firstNs + warmupNs :
+                    start && curNs >= start + roiNs;
+            } else {
+                due = (p == WARMUP_PHASE) ? finished >= warmupReqs :
+                    maxReqs && finished >= warmupReqs + maxReqs;
+            }
+
+            if (!due || !phase.compare_exchange_strong(p, p + 1)) {
+                return NO_EVENT;
+            }
+
+            if (p == WARMUP_PHASE) {
+                roiStartNs = curNs ? curNs : getCurNs();
+                return WARMUP_DONE;
+            }
+            return ROI_DONE;
+        }
+
         std::vector<ReqInfo> reqInfo; // Request info for each thread 
 
+        bool measureCtrs;
+        std::vector<PerfCounters*> perfCtrs; // Opened lazily by each thread
+
+        // Called by server thread id last thing in recvReq() and first thing
+        // in sendResp(), so that the counters only cover the application
+        void startCtrs(int id) {
+            if (!measureCtrs) return;
+            if (!perfCtrs[id]) perfCtrs[id] = new PerfCounters();
+            if (perfCtrs[id]->ok()) perfCtrs[id]->readAll(reqInfo[id].ctrs);
+        }
+
+        void stopCtrs(int id) {
+            ReqInfo& info = reqInfo[id];
+            if (!measureCtrs || !perfCtrs[id]->ok()) {
+                memset(info.ctrs, 0, sizeof(info.ctrs));
+                return;
+            }
+
+            uint64_t end[NUM_CTRS];
+            perfCtrs[id]->readAll(end);
+            for (int c = 0; c < NUM_CTRS; ++c) info.ctrs[c] = end[c] - info.ctrs[c];
+        }
+
+        Tracer* tracer;
+
+        // Called by server thread id on entering recvReq(), once it has the
+        // request's id, on entering sendResp() and on leaving it. Slices
+        // recvReq() (waiting for and receiving the request), the application
+        // handler, and sendResp().
+        void traceRecvStart(int id) {
+            if (tracer->on()) reqInfo[id].recvTsc = Tracer::now();
+        }
+
+        void traceRecvEnd(int id) {
+            if (!tracer->on()) return;
+            ReqInfo& info = reqInfo[id];
+            info.appTsc = Tracer::now();
+            tracer->slice("recvReq", info.id, info.recvTsc, info.appTsc);
+        }
+
+        void traceSendStart(int id) {
+            if (!tracer->on()) return;
+            ReqInfo& info = reqInfo[id];
+            info.sendTsc = Tracer::now();
+            tracer->slice("app", info.id, info.appTsc, info.sendTsc);
+        }
+
+        void traceSendEnd(int id) {
+            if (!tracer->on()) return;
+            ReqInfo& info = reqInfo[id];
+            tracer->slice("sendResp", info.id, info.sendTsc, Tracer::now());
+        }
+
     public:
         Server(int nthreads) {
             finishedReqs = 0;
             maxReqs = getOpt("TBENCH_MAXREQS", 0);
             warmupReqs = getOpt("TBENCH_WARMUPREQS", 0);
+            warmupNs = getOpt<double>("TBENCH_WARMUP_SECS", 0) * 1e9;
+            roiNs = getOpt<double>("TBENCH_ROI_SECS", 0) * 1e9;
+            firstNs = 0;
+            roiStartNs = 0;
+            phase = WARMUP_PHASE;
+            measureCtrs = getOpt("TBENCH_PERF_CTRS", 0);
             reqInfo.resize(nthreads);
+            perfCtrs.resize(nthreads, nullptr);
+            tracer = &Tracer::get();
+            tracer->setRole("server");
         }
 
         virtual size_t recvReq(int id, void** data) = 0;
@@ -92,4 +210,102 @@ class NetworkedServer : public Server {
         void finish();
 };
 
+class Uring;
+struct io_uring_buf_ring;
+struct io_uring_cqe;
+
+// Same wire protocol as NetworkedServer, but all socket I/O goes through a
+// shared io_uring. Every connection has a multishot recv armed that fills
+// buffers from a provided buffer ring, so receiving a request normally costs
+// no syscall at all; responses are queued as async sends. Whichever thread
+// holds recvLock reaps completions for everyone.
+class UringServer : public Server {
+    private:
+        struct OutMsg {
+            int conn;
+            char* data;
+            size_t len;
+            size_t off;
+        };
+
+        struct Conn {
+            int fd;
+            bool open;
+            std::vector<char> inbuf; // Received bytes not yet parsed
+            size_t inOff;
+            bool sending; // Sends on a connection go out one at a time
+            std::deque<OutMsg*> sendQueue;
+            bool needArm; // Recv could not be armed for lack of an SQE
+        };
+
+        struct ReadyReq {
+            int conn;
+            std::vector<char> bytes;
+        };
+
+        Uring* ring;
+        pthread_mutex_t sqLock; // Protects SQ, sending, sendQueue, needArm
+        pthread_mutex_t recvLock; // Protects CQ, buffer ring, inbufs, ready
+
+        // Set when the ring refused an SQE or a submission; the held-back
+        // work is retried by submitSq() once CQEs have been reaped
+        bool sqStalled;
+
+        std::vector<Conn> conns;
+        int openConns;
+        std::deque<ReadyReq> ready;
+
+        struct io_uring_buf_ring* bufRing;
+        char* bufs;
+        unsigned numBufs;
+        unsigned bufBytes;
+        unsigned bufTail;
+
+        std::vector<std::vector<char>> reqbufs; // One for each server thread
+        std::vector<int> activeConns;
+
+        // Helper Functions
+        void armRecv(int c);
+        void recycleBuf(unsigned bid);
+        void queueSend(OutMsg* msg);
+        void prepSend(OutMsg* msg);
+        void sendCtrl(ResponseType type);
+        void submitSq();
+        void unstall();
+        void closeConn(int c);
+        void parseReqs(int c);
+        void handleCqe(struct io_uring_cqe* cqe);
+        void reapAvailable();
+    public:
+        UringServer(int nthreads, std::string ip, int port, int nclients);
+
+        size_t recvReq(int id, void** data);
+        void sendResp(int id, const void* data, size_t size);
+        void finish();
+};
+
+struct ShmHeader;
+
+// Serves requests from a client process over shared-memory rings instead of
+// sockets. Server thread id only ever receives from and responds on queue id,
+// so the client, not the server, decides which thread serves each request.
+class ShmServer : public Server {
+    private:
+        ShmHeader* shm;
+        std::string shmName;
+        uint32_t spins;
+
+        Request *reqbuf; // One for each server thread
+
+        void clientLeft();
+        void sendCtrl(int id, ResponseType type);
+    public:
+        ShmServer(int nthreads, std::string name, uint64_t ringBytes);
+        ~ShmServer();
+
+        size_t recvReq(int id, void** data);
+        void sendResp(int id, const void* data, size_t size);
+        void finish();
+};
+
 #endif
@@ -0,0 +1,264 @@
+/** $lic$
+ * Copyright (C) 2016-2017 by Massachusetts Institute of Technology
+ *
+ * This file is part of TailBench.
+ *
+ * If you use this software in your research, we request that you reference the
+ * TaiBench paper ("TailBench: A Benchmark Suite and Evaluation Methodology for
+ * Latency-Critical Applications", Kasture and Sanchez, IISWC-2016) as the
+ * source in any publications that use this software, and that you send us a
+ * citation of your work.
+ *
+ * TailBench is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __SHMRING_H
+#define __SHMRING_H
+
+// Shared-memory transport between a TailBench client and server running as
+// separate processes on the same host. The server creates a segment with one
+// pair of single-producer/single-consumer byte rings per server thread: one
+// carries Requests from the client, the other Responses back. Messages use
+// the same framing as the networked harness (fixed header, then len bytes).
+//
+// A side that finds its ring empty (or full) spins for a while and then
+// sleeps on a futex; the other side only makes a futex syscall if someone is
+// actually asleep.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+
+const uint64_t SHM_MAGIC = 0x474e495242543031ul; // "10TBRING"
+
+// Sleep/wake point for one side of a ring
+struct ShmWaiter {
+    std::atomic<uint32_t> event;
+    std::atomic<uint32_t> sleeping;
+
+    // Waits until ready() holds. Gives up and returns false if peerPid dies
+    // while we are asleep.
+    template <typename F>
+    bool wait(F ready, uint32_t spins, pid_t peerPid) {
+        for (uint32_t i = 0; i < spins; ++i) {
+            if (ready()) return true;
+            __asm__ __volatile__("pause");
+        }
+
+        while (true) {
+            uint32_t ev = event.load();
+            sleeping.store(1);
+            if (ready()) {
+                sleeping.store(0);
+                return true;
+            }
+
+            struct timespec timeout = {0, 100 * 1000 * 1000};
+            syscall(SYS_futex, &event, FUTEX_WAIT, ev, &timeout, nullptr, 0);
+            sleeping.store(0);
+
+            if (ready()) return true;
+            if (peerPid > 0 && kill(peerPid, 0) == -1 && errno == ESRCH) {
+                return false;
+            }
+        }
+    }
+
+    void wake() {
+        if (sleeping.load()) {
+            event.fetch_add(1);
+            syscall(SYS_futex, &event, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+        }
+    }
+};
+
+// Byte ring with monotonically increasing head (consumer) and tail
+// (producer) offsets. Capacity must be a power of 2.
+struct ShmRing {
+    alignas(64) std::atomic<uint64_t> tail;
+    ShmWaiter notEmpty;
+    alignas(64) std::atomic<uint64_t> head;
+    ShmWaiter notFull;
+    alignas(64) uint64_t capacity;
+    uint64_t dataOffset; // From the start of the segment
+
+    char* data(char* base) { return base + dataOffset; }
+
+    // Producer side
+    bool write(char* base, const void* msg, uint64_t len, uint32_t spins,
+            pid_t peerPid) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (!notFull.wait([&] { return t + len - head.load() <= capacity; },
+                    spins, peerPid)) {
+            return false;
+        }
+
+        uint64_t off = t & (capacity - 1);
+        uint64_t first = std::min(len, capacity - off);
+        memcpy(data(base) + off, msg, first);
+        memcpy(data(base), reinterpret_cast<const char*>(msg) + first,
+                len - first);
+
+        tail.store(t + len);
+        notEmpty.wake();
+        return true;
+    }
+
+    // Consumer side
+    bool read(char* base, void* msg, uint64_t len, uint32_t spins,
+            pid_t peerPid) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (!notEmpty.wait([&] { return tail.load() - h >= len; }, spins,
+                    peerPid)) {
+            return false;
+        }
+
+        uint64_t off = h & (capacity - 1);
+        uint64_t first = std::min(len, capacity - off);
+        memcpy(msg, data(base) + off, first);
+        memcpy(reinterpret_cast<char*>(msg) + first, data(base), len - first);
+
+        head.store(h + len);
+        notFull.wake();
+        return true;
+    }
+};
+
+struct ShmQueuePair {
+    ShmRing reqs;
+    ShmRing resps;
+};
+
+struct ShmHeader {
+    std::atomic<uint64_t> magic; // Set once the server is done initializing
+    std::atomic<int> serverPid;
+    std::atomic<int> clientPid; // Set by the client when it attaches
+    uint32_t nqueues;
+    uint64_t ringBytes;
+    uint64_t segmentBytes;
+    ShmQueuePair queues[0];
+};
+
+static uint64_t shmRoundUpPow2(uint64_t v) {
+    uint64_t p = 1;
+    while (p < v) p <<= 1;
+    return p;
+}
+
+// Creates and initializes the segment; only the server calls this
+static ShmHeader* shmCreate(const std::string& name, uint32_t nqueues,
+        uint64_t ringBytes) {
+    ringBytes = shmRoundUpPow2(ringBytes);
+    uint64_t hdrBytes = sizeof(ShmHeader) + nqueues * sizeof(ShmQueuePair);
+    hdrBytes = (hdrBytes + 4095) & ~4095ul;
+    uint64_t segmentBytes = hdrBytes + 2 * nqueues * ringBytes;
+
+    shm_unlink(name.c_str()); // Stale segment from a previous run
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd == -1) {
+        std::cerr << "shm_open(" << name << ") failed: " << strerror(errno) \
+            << std::endl;
+        exit(-1);
+    }
+
+    if (ftruncate(fd, segmentBytes) == -1) {
+        std::cerr << "ftruncate() failed: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+
+    void* base = mmap(nullptr, segmentBytes, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "mmap() failed: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+
+    ShmHeader* hdr = reinterpret_cast<ShmHeader*>(base);
+    memset(base, 0, hdrBytes);
+    hdr->serverPid = getpid();
+    hdr->clientPid = 0;
+    hdr->nqueues = nqueues;
+    hdr->ringBytes = ringBytes;
+    hdr->segmentBytes = segmentBytes;
+
+    uint64_t off = hdrBytes;
+    for (uint32_t q = 0; q < nqueues; ++q) {
+        hdr->queues[q].reqs.capacity = ringBytes;
+        hdr->queues[q].reqs.dataOffset = off;
+        off += ringBytes;
+        hdr->queues[q].resps.capacity = ringBytes;
+        hdr->queues[q].resps.dataOffset = off;
+        off += ringBytes;
+    }
+
+    hdr->magic.store(SHM_MAGIC);
+    return hdr;
+}
+
+// Maps a segment created by shmCreate(), waiting up to timeoutSecs for the
+// server to create it
+static ShmHeader* shmAttach(const std::string& name, int timeoutSecs) {
+    int fd = -1;
+    for (int i = 0; i < timeoutSecs * 10 && fd == -1; ++i) {
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd == -1) usleep(100 * 1000);
+    }
+    if (fd == -1) {
+        std::cerr << "shm_open(" << name << ") failed: " << strerror(errno) \
+            << ". Is the server running?" << std::endl;
+        exit(-1);
+    }
+
+    // The segment may not be sized or initialized yet
+    struct stat st;
+    ShmHeader* hdr = nullptr;
+    for (int i = 0; i < timeoutSecs * 10; ++i) {
+        if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(ShmHeader)) {
+            void* base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, 0);
+            if (base == MAP_FAILED) {
+                std::cerr << "mmap() failed: " << strerror(errno) << std::endl;
+                exit(-1);
+            }
+            hdr = reinterpret_cast<ShmHeader*>(base);
+            if (hdr->magic.load() == SHM_MAGIC) break;
+            munmap(base, st.st_size);
+            hdr = nullptr;
+        }
+        usleep(100 * 1000);
+    }
+    close(fd);
+
+    if (!hdr) {
+        std::cerr << "Shared memory segment " << name << " was never"
+            " initialized" << std::endl;
+        exit(-1);
+    }
+
+    int expected = 0;
+    if (!hdr->clientPid.compare_exchange_strong(expected, getpid())) {
+        std::cerr << "Another client (pid " << expected << ") is already"
+            " attached to " << name << std::endl;
+        exit(-1);
+    }
+
+    return hdr;
+}
+
+#endif
@@ -26,33 +26,53 @@
 #include <string>
 #include <vector>
 
-void* send(void* c) {
-    NetworkedClient* client = reinterpret_cast<NetworkedClient*>(c);
-
+// With at least as many connections as threads, each sender thread owns the
+// connections whose index is congruent to its own modulo the number of
+// threads, and spreads its requests over them round robin. With fewer, sender
+// thread t shares connection t modulo the number of connections with the
+// other threads mapped to it. Every connection has its own receiver thread.
+struct ThreadArgs {
+    NetworkedClient* client;
+    int nthreads;
+    int id;
+};
+
+pthread_mutex_t finishLock = PTHREAD_MUTEX_INITIALIZER;
+
+void* send(void* a) {
+    ThreadArgs* args = reinterpret_cast<ThreadArgs*>(a);
+    NetworkedClient* client = args->client;
+
+    int first = args->id % client->numConns();
+    int conn = first;
     while (true) {
-        if (client->numReqsInFlight <= 100000) {
-            Request* req = client->startReq();
-            if (!client->send(req)) {
-                std::cerr << "[CLIENT] send() failed : " << client->errmsg() \
-                    << std::endl;
-                std::cerr << "[CLIENT] Not sending further request" << std::endl;
-
-                break; // We are done
-            }
+        // Blocks while TBENCH_MAX_INFLIGHT requests are outstanding
+        Request* req = client->startReq();
+        if (!client->send(conn, req)) {
+            std::cerr << "[CLIENT] send() failed on connection " << conn \
+                << " : " << client->errmsg(conn) << std::endl;
+            std::cerr << "[CLIENT] Not sending further request" << std::endl;
+
+            break; // We are done
         }
+
+        conn += args->nthreads;
+        if (conn >= client->numConns()) conn = first;
     }
 
     return nullptr;
 }
 
-void* recv(void* c) {
-    NetworkedClient* client = reinterpret_cast<NetworkedClient*>(c);
+void* recv(void* a) {
+    ThreadArgs* args = reinterpret_cast<ThreadArgs*>(a);
+    NetworkedClient* client = args->client;
+    int conn = args->id;
 
     Response resp;
     while (true) {
-        if (!client->recv(&resp)) {
-            std::cerr << "[CLIENT] recv() failed : " << client->errmsg() \
-                << std::endl;
+        if (!client->recv(conn, &resp)) {
+            std::cerr << "[CLIENT] recv() failed on connection " << conn \
+                << " : " << client->errmsg(conn) << std::endl;
             return nullptr;
         }
 
@@ -61,6 +81,9 @@ void* recv(void* c) {
         } else if (resp.type == ROI_BEGIN) {
             client->startRoi();
         } else if (resp.type == FINISH) {
+            // FINISH arrives on every connection; the first receiver dumps
+            // stats and exits while the others wait here
+            pthread_mutex_lock(&finishLock);
             client->dumpStats();
             syscall(SYS_exit_group, 0);
         } else {
@@ -75,29 +98,45 @@ int main(int argc, char* argv[]) {
     std::string server = getOpt<std::string>("TBENCH_SERVER", "");
     int serverport = getOpt<int>("TBENCH_SERVER_PORT", 8080);
 
-    NetworkedClient* client = new NetworkedClient(nthreads, server, serverport);
+    // Total connections opened by this client; the server's TBENCH_NCLIENTS
+    // must count every connection of every client. The default of one
+    // connection matches the server's default TBENCH_NCLIENTS.
+    int nconns = getOpt<int>("TBENCH_CLIENT_CONNS", 1);
+    if (nconns < 1) {
+        std::cerr << "[CLIENT] TBENCH_CLIENT_CONNS (" << nconns << ") must be"
+            " at least 1" << std::endl;
+        exit(-1);
+    }
+
+    NetworkedClient* client = new NetworkedClient(nthreads, nconns, server,
+            serverport);
 
+    std::vector<ThreadArgs> senderArgs(nthreads);
+    std::vector<ThreadArgs> receiverArgs(nconns);
     std::vector<pthread_t> senders(nthreads);
-    std::vector<pthread_t> receivers(nthreads);
+    std::vector<pthread_t> receivers(nconns);
 
     for (int t = 0; t < nthreads; ++t) {
+        senderArgs[t] = { client, nthreads, t };
         int status = pthread_create(&senders[t], nullptr, send,
-                reinterpret_cast<void*>(client));
+                reinterpret_cast<void*>(&senderArgs[t]));
         assert(status == 0);
     }
 
-    for (int t = 0; t < nthreads; ++t) {
-        int status = pthread_create(&receivers[t], nullptr, recv,
-                reinterpret_cast<void*>(client));
+    for (int c = 0; c < nconns; ++c) {
+        receiverArgs[c] = { client, nthreads, c };
+        int status = pthread_create(&receivers[c], nullptr, recv,
+                reinterpret_cast<void*>(&receiverArgs[c]));
         assert(status == 0);
     }
 
     for (int t = 0; t < nthreads; ++t) {
-        int status;
-        status = pthread_join(senders[t], nullptr);
+        int status = pthread_join(senders[t], nullptr);
         assert(status == 0);
+    }
 
-        status = pthread_join(receivers[t], nullptr);
+    for (int c = 0; c < nconns; ++c) {
+        int status = pthread_join(receivers[c], nullptr);
         assert(status == 0);
     }
 
@@ -0,0 +1,173 @@
+/** $lic$
+ * Copyright (C) 2016-2017 by Massachusetts Institute of Technology
+ *
+ * This file is part of TailBench.
+ *
+ * If you use this software in your research, we request that you reference the
+ * TaiBench paper ("TailBench: A Benchmark Suite and Evaluation Methodology for
+ * Latency-Critical Applications", Kasture and Sanchez, IISWC-2016) as the
+ * source in any publications that use this software, and that you send us a
+ * citation of your work.
+ *
+ * TailBench is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include "client.h"
+#include "helpers.h"
+#include "shmring.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*******************************************************************************
+ * Shared-memory Client
+ *******************************************************************************/
+ShmClient::ShmClient(int nthreads, std::string name) : Client(nthreads) {
+    spins = getOpt<uint32_t>("TBENCH_SHM_SPINS", 1000);
+    int timeout = getOpt<int>("TBENCH_SHM_ATTACH_TIMEOUT", 30);
+    shm = shmAttach(name, timeout);
+}
+
+int ShmClient::numQueues() const {
+    return shm->nqueues;
+}
+
+bool ShmClient::send(int queue, Request* req) {
+    // The response may be in, and req freed, as soon as it's sent
+    uint64_t id = req->id;
+    uint64_t startTsc = Tracer::now();
+    ShmRing& ring = shm->queues[queue].reqs;
+    int len = sizeof(Request) - MAX_REQ_BYTES + req->len;
+    bool ok = ring.write(reinterpret_cast<char*>(shm), req, len, spins,
+            shm->serverPid.load());
+    tracer->slice("send", id, startTsc, Tracer::now());
+    return ok;
+}
+
+bool ShmClient::recv(int queue, Response* resp) {
+    ShmRing& ring = shm->queues[queue].resps;
+    char* base = reinterpret_cast<char*>(shm);
+    pid_t serverPid = shm->serverPid.load();
+
+    int len = sizeof(Response) - MAX_RESP_BYTES; // Read response header first
+    if (!ring.read(base, resp, len, spins, serverPid)) return false;
+
+    if (resp->type == RESPONSE) {
+        return ring.read(base, &resp->data, resp->len, spins, serverPid);
+    }
+
+    return true;
+}
+
+/*******************************************************************************
+ * Driver
+ *******************************************************************************/
+// There is one queue per server thread. Sender thread t owns the queues
+// congruent to t modulo the number of sender threads and spreads requests
+// over them round robin; every queue has its own receiver thread.
+struct ThreadArgs {
+    ShmClient* client;
+    int nthreads;
+    int id;
+};
+
+pthread_mutex_t finishLock = PTHREAD_MUTEX_INITIALIZER;
+
+void* send(void* a) {
+    ThreadArgs* args = reinterpret_cast<ThreadArgs*>(a);
+    ShmClient* client = args->client;
+
+    int queue = args->id;
+    while (true) {
+        Request* req = client->startReq();
+        if (!client->send(queue, req)) {
+            std::cerr << "[CLIENT] Server exited, not sending further" \
+                " requests" << std::endl;
+            break;
+        }
+
+        queue += args->nthreads;
+        if (queue >= client->numQueues()) queue = args->id;
+    }
+
+    return nullptr;
+}
+
+void* recv(void* a) {
+    ThreadArgs* args = reinterpret_cast<ThreadArgs*>(a);
+    ShmClient* client = args->client;
+
+    Response* resp = new Response;
+    while (true) {
+        if (!client->recv(args->id, resp)) {
+            std::cerr << "[CLIENT] Server exited" << std::endl;
+            return nullptr;
+        }
+
+        if (resp->type == RESPONSE) {
+            client->finiReq(resp);
+        } else if (resp->type == ROI_BEGIN) {
+            client->startRoi();
+        } else if (resp->type == FINISH) {
+            pthread_mutex_lock(&finishLock);
+            client->dumpStats();
+            syscall(SYS_exit_group, 0);
+        } else {
+            std::cerr << "Unknown response type: " << resp->type << std::endl;
+            return nullptr;
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int nthreads = getOpt<int>("TBENCH_CLIENT_THREADS", 1);
+    std::string name = getOpt<std::string>("TBENCH_SHM_NAME", "/tbench");
+
+    ShmClient* client = new ShmClient(nthreads, name);
+    int nqueues = client->numQueues();
+    if (nthreads > nqueues) {
+        std::cerr << "[CLIENT] TBENCH_CLIENT_THREADS (" << nthreads << ") is" \
+            " larger than the number of server threads (" << nqueues << ")" \
+            << std::endl;
+        exit(-1);
+    }
+
+    std::vector<ThreadArgs> senderArgs(nthreads);
+    std::vector<ThreadArgs> receiverArgs(nqueues);
+    std::vector<pthread_t> senders(nthreads);
+    std::vector<pthread_t> receivers(nqueues);
+
+    for (int t = 0; t < nthreads; ++t) {
+        senderArgs[t] = { client, nthreads, t };
+        int status = pthread_create(&senders[t], nullptr, send,
+                reinterpret_cast<void*>(&senderArgs[t]));
+        assert(status == 0);
+    }
+
+    for (int q = 0; q < nqueues; ++q) {
+        receiverArgs[q] = { client, nthreads, q };
+        int status = pthread_create(&receivers[q], nullptr, recv,
+                reinterpret_cast<void*>(&receiverArgs[q]));
+        assert(status == 0);
+    }
+
+    for (int t = 0; t < nthreads; ++t) {
+        int status = pthread_join(senders[t], nullptr);
+        assert(status == 0);
+    }
+
+    for (int q = 0; q < nqueues; ++q) {
+        int status = pthread_join(receivers[q], nullptr);
+        assert(status == 0);
+    }
+
+    return 0;
+}
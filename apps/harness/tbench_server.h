@@ -33,6 +33,14 @@ size_t tBenchRecvReq(void** data);
 
 void tBenchSendResp(const void* data, size_t size);
 
+// tBenchServerInit() expects nthreads server threads, each registered by
+// tBenchServerThreadStart(). Applications whose other threads should be
+// profiled too (e.g., a compute pool) expect them up front and have each one
+// register itself; the thread table is published once all have.
+void tBenchServerExpectThreads(int nthreads);
+
+void tBenchServerRegisterThread(const char* role, int index);
+
 #ifdef __cplusplus 
 }
 #endif
@@ -21,6 +21,7 @@
 
 #include "helpers.h"
 #include "server.h"
+#include "threadreg.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -40,25 +41,37 @@
 #include <string>
 #include <fstream>
 
-#define gettid() ((pid_t)syscall(SYS_gettid))
 /*******************************************************************************
  * IntegratedServer
  *******************************************************************************/
 IntegratedServer::IntegratedServer(int nthreads)
     : Server(nthreads)
     , Client(nthreads)
-{ }
+{
+    Server::tracer->setRole("integrated");
+
+    // Server threads generate their own requests when they are free, so a
+    // request issued after its genNs has been queueing, not held up by the
+    // client
+    detectLate = false;
+}
 
 size_t IntegratedServer::recvReq(int id, void** data) {
+    traceRecvStart(id);
     Request* req = Client::startReq();
     *data = reinterpret_cast<void*>(&req->data);
     uint64_t curNs = getCurNs();
     reqInfo[id].id = req->id;
     reqInfo[id].startNs = curNs;
+    traceRecvEnd(id);
+    startCtrs(id);
     return req->len;
 };
 
 void IntegratedServer::sendResp(int id, const void* data, size_t len) {
+    stopCtrs(id);
+    traceSendStart(id);
+
     Response* resp = new Response;
 
     resp->type = RESPONSE;
@@ -70,6 +83,7 @@ void IntegratedServer::sendResp(int id, const void* data, size_t len) {
     assert(curNs > reqInfo[id].startNs);
 
     resp->svcNs = curNs - reqInfo[id].startNs;
+    memcpy(resp->ctrs, reqInfo[id].ctrs, sizeof(resp->ctrs));
 
     Client::finiReq(resp);
 
@@ -78,14 +92,17 @@ void IntegratedServer::sendResp(int id, const void* data, size_t len) {
     pthread_mutex_lock(&lock);
     ++finishedReqs;
 
-    if (finishedReqs == warmupReqs) {
+    WindowEvent ev = windowEvent(finishedReqs);
+    if (ev == WARMUP_DONE) {
         Client::_startRoi();
-    } else if (finishedReqs == warmupReqs + maxReqs) {
+    } else if (ev == ROI_DONE) {
         Client::dumpStats();
         syscall(SYS_exit_group, 0);
     }
 
     pthread_mutex_unlock(&lock);
+
+    traceSendEnd(id);
 }
 
 
@@ -105,20 +122,13 @@ IntegratedServer* server;
  *******************************************************************************/
 void tBenchServerInit(int nthreads) {
     curTid = 0;
+    tBenchServerExpectThreads(nthreads);
     server = new IntegratedServer(nthreads);
 }
 
 void tBenchServerThreadStart() {
     tid = curTid++;
-
-    // Save the tid in a temporary file to be read by the datamime optimizer.
-    std::string tmpdir = getOpt<std::string>("SCRATCH_DIR", "/tmp");
-    std::string tidfp = tmpdir + "/tbench_server_tid.txt";
-    std::cerr << "[TBENCH_SERVER] Saving thread id file at " << tidfp << std::endl;
-    std::ofstream tidFile;
-    tidFile.open(tidfp.c_str());
-    tidFile << gettid() << std::endl;
-    tidFile.close();
+    tBenchServerRegisterThread("server", tid);
 }
 
 void tBenchServerFinish() {
@@ -22,6 +22,7 @@
 
 #include "helpers.h"
 #include "server.h"
+#include "threadreg.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -42,7 +43,6 @@
 #include <string>
 #include <fstream>
 
-#define gettid() ((pid_t)syscall(SYS_gettid))
 /*******************************************************************************
  * NetworkedServer
  *******************************************************************************/
@@ -59,80 +59,7 @@ NetworkedServer::NetworkedServer(int nthreads, std::string ip, int port, \
 
     recvClientHead = 0;
 
-    // Get address info
-    int status;
-    struct addrinfo hints;
-    struct addrinfo* servInfo;
-
-    memset(&hints, 0, sizeof(hints));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = AI_PASSIVE;
-
-    std::stringstream portstr;
-    portstr << port;
-
-    const char* ipstr = (ip.size() > 0) ? ip.c_str() : nullptr;
-
-    if ((status = getaddrinfo(ipstr, portstr.str().c_str(), &hints, &servInfo))\
-            != 0) {
-        std::cerr << "getaddrinfo() failed: " << gai_strerror(status) \
-            << std::endl;
-        exit(-1);
-    }
-
-    // Create listening socket
-    int listener = socket(servInfo->ai_family, servInfo->ai_socktype, \
-            servInfo->ai_protocol);
-    if (listener == -1) {
-        std::cerr << "socket() failed: " << strerror(errno) << std::endl;
-        exit(-1);
-    }
-
-    int yes = 1;
-    if (setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) \
-            == -1)  {
-        std::cerr << "setsockopt() failed: " << strerror(errno) << std::endl;
-        exit(-1);
-    }
-
-    if (bind(listener, servInfo->ai_addr, servInfo->ai_addrlen) == -1) {
-        std::cerr << "bind() failed: " << strerror(errno) << std::endl;
-        exit(-1);
-    }
-
-    if (listen(listener, 10) == -1) {
-        std::cerr << "listen() failed: " << strerror(errno) << std::endl;
-        exit(-1);
-    }
-
-    // Establish connections with clients
-    struct sockaddr_storage clientAddr;
-    socklen_t clientAddrSize;
-
-    for (int c = 0; c < nclients; ++c) {
-        clientAddrSize = sizeof(clientAddr);
-        memset(&clientAddr, 0, clientAddrSize);
-
-        int clientFd = accept(listener, \
-                reinterpret_cast<struct sockaddr*>(&clientAddr), \
-                &clientAddrSize);
-
-        if (clientFd == -1) {
-            std::cerr << "accept() failed: " << strerror(errno) << std::endl;
-            exit(-1);
-        }
-
-        int nodelay = 1;
-        if (setsockopt(clientFd, IPPROTO_TCP, TCP_NODELAY,
-                reinterpret_cast<char*>(&nodelay), sizeof(nodelay)) == -1) {
-            std::cerr << "setsockopt(TCP_NODELAY) failed: " << strerror(errno) \
-                << std::endl;
-            exit(-1);
-        }
-
-        clientFds.push_back(clientFd);
-    }
+    clientFds = acceptClients(ip, port, nclients);
 }
 
 NetworkedServer::~NetworkedServer() {
@@ -168,6 +95,7 @@ bool NetworkedServer::checkRecv(int recvd, int expected, int fd) {
 }
 
 size_t NetworkedServer::recvReq(int id, void** data) {
+    traceRecvStart(id);
     pthread_mutex_lock(&recvLock);
 
     bool success = false;
@@ -231,11 +159,18 @@ size_t NetworkedServer::recvReq(int id, void** data) {
 
     pthread_mutex_unlock(&recvLock);
 
+    traceRecvEnd(id);
+    startCtrs(id);
     return req->len;
 };
 
 void NetworkedServer::sendResp(int id, const void* data, size_t len) {
+    stopCtrs(id);
+    traceSendStart(id);
+
+    uint64_t lockTsc = Tracer::now();
     pthread_mutex_lock(&sendLock);
+    tracer->slice("sendLock", reqInfo[id].id, lockTsc, Tracer::now());
 
     Response* resp = new Response();
 
@@ -247,6 +182,7 @@ void NetworkedServer::sendResp(int id, const void* data, size_t len) {
     uint64_t curNs = getCurNs();
     assert(curNs > reqInfo[id].startNs);
     resp->svcNs = curNs - reqInfo[id].startNs;
+    memcpy(resp->ctrs, reqInfo[id].ctrs, sizeof(resp->ctrs));
 
     int fd = activeFds[id];
     int totalLen = sizeof(Response) - MAX_RESP_BYTES + len;
@@ -255,14 +191,15 @@ void NetworkedServer::sendResp(int id, const void* data, size_t len) {
 
     ++finishedReqs;
 
-    if (finishedReqs == warmupReqs) {
+    WindowEvent ev = windowEvent(finishedReqs);
+    if (ev == WARMUP_DONE) {
         resp->type = ROI_BEGIN;
         for (int fd : clientFds) {
             totalLen = sizeof(Response) - MAX_RESP_BYTES;
             sent = sendfull(fd, reinterpret_cast<const char*>(resp), totalLen, 0);
             assert(sent == totalLen);
         }
-    } else if (finishedReqs == warmupReqs + maxReqs) {
+    } else if (ev == ROI_DONE) {
         resp->type = FINISH;
         for (int fd : clientFds) {
             totalLen = sizeof(Response) - MAX_RESP_BYTES;
@@ -274,6 +211,8 @@ void NetworkedServer::sendResp(int id, const void* data, size_t len) {
     delete resp;
 
     pthread_mutex_unlock(&sendLock);
+
+    traceSendEnd(id);
 }
 
 void NetworkedServer::finish() {
@@ -309,6 +248,7 @@ NetworkedServer* server;
  *******************************************************************************/
 void tBenchServerInit(int nthreads) {
     curTid = 0;
+    tBenchServerExpectThreads(nthreads);
     std::string serverurl = getOpt<std::string>("TBENCH_SERVER", "");
     int serverport = getOpt<int>("TBENCH_SERVER_PORT", 8080);
     int nclients = getOpt<int>("TBENCH_NCLIENTS", 1);
@@ -317,15 +257,7 @@ void tBenchServerInit(int nthreads) {
 
 void tBenchServerThreadStart() {
     tid = curTid++;
-
-    // Save the tid in a temporary file to be read by the datamime optimizer.
-    std::string tmpdir = getOpt<std::string>("SCRATCH_DIR", "/tmp");
-    std::string tidfp = tmpdir + "/tbench_server_tid.txt";
-    std::cerr << "[TBENCH_SERVER] Saving thread id file at " << tidfp << std::endl;
-    std::ofstream tidFile;
-    tidFile.open(tidfp);
-    tidFile << gettid() << std::endl;
-    tidFile.close();
+    tBenchServerRegisterThread("server", tid);
 }
 
 void tBenchServerFinish() {
@@ -0,0 +1,193 @@
+/** $lic$
+ * Copyright (C) 2016-2017 by Massachusetts Institute of Technology
+ *
+ * This file is part of TailBench.
+ *
+ * If you use this software in your research, we request that you reference the
+ * TaiBench paper ("TailBench: A Benchmark Suite and Evaluation Methodology for
+ * Latency-Critical Applications", Kasture and Sanchez, IISWC-2016) as the
+ * source in any publications that use this software, and that you send us a
+ * citation of your work.
+ *
+ * TailBench is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include "tbench_server.h"
+
+#include <atomic>
+#include <vector>
+
+#include "helpers.h"
+#include "server.h"
+#include "threadreg.h"
+#include "shmring.h"
+
+#include <assert.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+/*******************************************************************************
+ * ShmServer
+ *******************************************************************************/
+ShmServer::ShmServer(int nthreads, std::string name, uint64_t ringBytes)
+    : Server(nthreads)
+{
+    shmName = name;
+    spins = getOpt<uint32_t>("TBENCH_SHM_SPINS", 1000);
+
+    // A ring must fit at least one message of the largest size
+    uint64_t minBytes = sizeof(Request) > sizeof(Response) ?
+        sizeof(Request) : sizeof(Response);
+    if (ringBytes < minBytes) {
+        std::cerr << "TBENCH_SHM_RING_BYTES must be at least " << minBytes \
+            << std::endl;
+        exit(-1);
+    }
+
+    reqbuf = new Request[nthreads];
+    shm = shmCreate(shmName, nthreads, ringBytes);
+
+    std::cerr << "[TBENCH_SERVER] Shared memory segment " << shmName << ": " \
+        << nthreads << " queues, " << (shm->ringBytes >> 10) \
+        << " kB rings" << std::endl;
+}
+
+ShmServer::~ShmServer() {
+    delete[] reqbuf;
+    munmap(shm, shm->segmentBytes);
+    shm_unlink(shmName.c_str());
+}
+
+void ShmServer::clientLeft() {
+    std::cerr << "Client left. Server finishing" << std::endl;
+    shm_unlink(shmName.c_str());
+    exit(0);
+}
+
+size_t ShmServer::recvReq(int id, void** data) {
+    traceRecvStart(id);
+    ShmRing& ring = shm->queues[id].reqs;
+    char* base = reinterpret_cast<char*>(shm);
+    Request* req = &reqbuf[id];
+
+    int len = sizeof(Request) - MAX_REQ_BYTES; // Read request header first
+    if (!ring.read(base, req, len, spins, shm->clientPid.load())) clientLeft();
+    if (!ring.read(base, req->data, req->len, spins, shm->clientPid.load())) {
+        clientLeft();
+    }
+
+    uint64_t curNs = getCurNs();
+    reqInfo[id].id = req->id;
+    reqInfo[id].startNs = curNs;
+    traceRecvEnd(id);
+    startCtrs(id);
+
+    *data = reinterpret_cast<void*>(&req->data);
+    return req->len;
+}
+
+void ShmServer::sendCtrl(int id, ResponseType type) {
+    Response resp;
+    resp.type = type;
+    resp.len = 0;
+
+    ShmRing& ring = shm->queues[id].resps;
+    if (!ring.write(reinterpret_cast<char*>(shm), &resp,
+                sizeof(Response) - MAX_RESP_BYTES, spins,
+                shm->clientPid.load())) {
+        clientLeft();
+    }
+}
+
+void ShmServer::sendResp(int id, const void* data, size_t len) {
+    stopCtrs(id);
+    traceSendStart(id);
+
+    Response* resp = new Response();
+
+    resp->type = RESPONSE;
+    resp->id = reqInfo[id].id;
+    resp->len = len;
+    memcpy(reinterpret_cast<void*>(&resp->data), data, len);
+
+    uint64_t curNs = getCurNs();
+    assert(curNs > reqInfo[id].startNs);
+    resp->svcNs = curNs - reqInfo[id].startNs;
+    memcpy(resp->ctrs, reqInfo[id].ctrs, sizeof(resp->ctrs));
+
+    ShmRing& ring = shm->queues[id].resps;
+    int totalLen = sizeof(Response) - MAX_RESP_BYTES + len;
+    if (!ring.write(reinterpret_cast<char*>(shm), resp, totalLen, spins,
+                shm->clientPid.load())) {
+        clientLeft();
+    }
+
+    delete resp;
+
+    // Each response ring has a single producer, so control messages go out
+    // only on this thread's queue; the client acts on the first one it sees
+    uint64_t finished = __sync_add_and_fetch(&finishedReqs, 1);
+    WindowEvent ev = windowEvent(finished);
+    if (ev == WARMUP_DONE) {
+        sendCtrl(id, ROI_BEGIN);
+    } else if (ev == ROI_DONE) {
+        sendCtrl(id, FINISH);
+    }
+
+    traceSendEnd(id);
+}
+
+// Must only be called once server threads have stopped sending responses
+void ShmServer::finish() {
+    for (uint32_t q = 0; q < shm->nqueues; ++q) {
+        sendCtrl(q, FINISH);
+    }
+}
+
+/*******************************************************************************
+ * Per-thread State
+ *******************************************************************************/
+__thread int tid;
+
+/*******************************************************************************
+ * Global data
+ *******************************************************************************/
+std::atomic_int curTid;
+ShmServer* server;
+
+/*******************************************************************************
+ * API
+ *******************************************************************************/
+void tBenchServerInit(int nthreads) {
+    curTid = 0;
+    tBenchServerExpectThreads(nthreads);
+    std::string name = getOpt<std::string>("TBENCH_SHM_NAME", "/tbench");
+    uint64_t ringBytes = getOpt<uint64_t>("TBENCH_SHM_RING_BYTES", 4 << 20);
+    server = new ShmServer(nthreads, name, ringBytes);
+}
+
+void tBenchServerThreadStart() {
+    tid = curTid++;
+    tBenchServerRegisterThread("server", tid);
+}
+
+void tBenchServerFinish() {
+    server->finish();
+}
+
+size_t tBenchRecvReq(void** data) {
+    return server->recvReq(tid, data);
+}
+
+void tBenchSendResp(const void* data, size_t size) {
+    return server->sendResp(tid, data, size);
+}
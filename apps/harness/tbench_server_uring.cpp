@@ -0,0 +1,479 @@
+/** $lic$
+ * Copyright (C) 2016-2017 by Massachusetts Institute of Technology
+ *
+ * This file is part of TailBench.
+ *
+ * If you use this software in your research, we request that you reference the
+ * TaiBench paper ("TailBench: A Benchmark Suite and Evaluation Methodology for
+ * Latency-Critical Applications", Kasture and Sanchez, IISWC-2016) as the
+ * source in any publications that use this software, and that you send us a
+ * citation of your work.
+ *
+ * TailBench is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#include "tbench_server.h"
+
+#include <atomic>
+#include <vector>
+
+#include "helpers.h"
+#include "server.h"
+#include "threadreg.h"
+#include "uring.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+
+const unsigned URING_BGID = 0;
+
+// user_data of recv completions is (conn << 1); that of send completions is
+// the OutMsg pointer with the low bit set
+const uint64_t SEND_TAG = 1;
+
+/*******************************************************************************
+ * UringServer
+ *******************************************************************************/
+UringServer::UringServer(int nthreads, std::string ip, int port, int nclients)
+    : Server(nthreads)
+{
+    pthread_mutex_init(&sqLock, nullptr);
+    pthread_mutex_init(&recvLock, nullptr);
+    sqStalled = false;
+
+    reqbufs.resize(nthreads);
+    activeConns.resize(nthreads);
+
+    unsigned entries = getOpt<unsigned>("TBENCH_URING_ENTRIES", 256);
+    bool sqpoll = getOpt<int>("TBENCH_URING_SQPOLL", 0);
+    numBufs = getOpt<unsigned>("TBENCH_URING_BUFS", 256);
+    bufBytes = getOpt<unsigned>("TBENCH_URING_BUF_BYTES", 64 * 1024);
+    if (numBufs == 0 || (numBufs & (numBufs - 1)) || numBufs > 32768) {
+        std::cerr << "TBENCH_URING_BUFS must be a power of 2 up to 32768" \
+            << std::endl;
+        exit(-1);
+    }
+
+    ring = new Uring(entries, sqpoll);
+
+    // Provided buffers the kernel picks from on each multishot recv
+    size_t ringBytes = numBufs * sizeof(struct io_uring_buf);
+    void* br = mmap(nullptr, ringBytes, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    bufs = reinterpret_cast<char*>(mmap(nullptr, (size_t)numBufs * bufBytes,
+                PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS |
+                MAP_POPULATE, -1, 0));
+    if (br == MAP_FAILED || bufs == MAP_FAILED) {
+        std::cerr << "mmap() failed: " << strerror(errno) << std::endl;
+        exit(-1);
+    }
+    bufRing = reinterpret_cast<struct io_uring_buf_ring*>(br);
+    bufTail = 0;
+    for (unsigned b = 0; b < numBufs; ++b) recycleBuf(b);
+    ring->registerBufRing(bufRing, numBufs, URING_BGID);
+
+    std::vector<int> fds = acceptClients(ip, port, nclients);
+    conns.resize(fds.size());
+    openConns = fds.size();
+
+    pthread_mutex_lock(&sqLock);
+    for (size_t c = 0; c < fds.size(); ++c) {
+        conns[c].fd = fds[c];
+        conns[c].open = true;
+        conns[c].inOff = 0;
+        conns[c].sending = false;
+        armRecv(c);
+    }
+    submitSq();
+    pthread_mutex_unlock(&sqLock);
+
+    std::cerr << "[TBENCH_SERVER] io_uring backend: " << entries \
+        << " entries, " << numBufs << " x " << (bufBytes >> 10) \
+        << " kB recv buffers" << (sqpoll ? ", SQPOLL" : "") << std::endl;
+}
+
+// Call with sqLock held
+void UringServer::armRecv(int c) {
+    struct io_uring_sqe* sqe = ring->getSqe();
+    if (!sqe) {
+        conns[c].needArm = true;
+        sqStalled = true;
+        return;
+    }
+    conns[c].needArm = false;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conns[c].fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BGID;
+    sqe->user_data = static_cast<uint64_t>(c) << 1;
+}
+
+// Call with recvLock held (or before any recv is armed)
+void UringServer::recycleBuf(unsigned bid) {
+    // Not bufRing->bufs: in C++, the empty struct in __DECLARE_FLEX_ARRAY
+    // takes space and shifts bufs by one element
+    struct io_uring_buf* buf = reinterpret_cast<struct io_uring_buf*>(bufRing)
+        + (bufTail & (numBufs - 1));
+    buf->addr = reinterpret_cast<uint64_t>(bufs + (size_t)bid * bufBytes);
+    buf->len = bufBytes;
+    buf->bid = bid;
+    bufTail++;
+    __atomic_store_n(&bufRing->tail, (uint16_t)bufTail, __ATOMIC_RELEASE);
+}
+
+// Call with sqLock held
+void UringServer::prepSend(OutMsg* msg) {
+    struct io_uring_sqe* sqe = ring->getSqe();
+    if (!sqe) {
+        // Back to the head of the queue until submitSq() retries it
+        Conn& conn = conns[msg->conn];
+        conn.sendQueue.push_front(msg);
+        conn.sending = false;
+        sqStalled = true;
+        return;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conns[msg->conn].fd;
+    sqe->addr = reinterpret_cast<uint64_t>(msg->data + msg->off);
+    sqe->len = msg->len - msg->off;
+    sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<uint64_t>(msg) | SEND_TAG;
+}
+
+// Call with sqLock held
+void UringServer::queueSend(OutMsg* msg) {
+    Conn& conn = conns[msg->conn];
+    if (!conn.open) {
+        delete[] msg->data;
+        delete msg;
+    } else if (conn.sending) {
+        conn.sendQueue.push_back(msg);
+    } else {
+        conn.sending = true;
+        prepSend(msg);
+    }
+}
+
+// Call with sqLock held
+void UringServer::sendCtrl(ResponseType type) {
+    for (size_t c = 0; c < conns.size(); ++c) {
+        OutMsg* msg = new OutMsg;
+        msg->conn = c;
+        msg->len = sizeof(Response) - MAX_RESP_BYTES;
+        msg->off = 0;
+        msg->data = new char[msg->len];
+        memset(msg->data, 0, msg->len);
+        reinterpret_cast<Response*>(msg->data)->type = type;
+        queueSend(msg);
+    }
+}
+
+// Submits the SQEs prepared so far, first retrying any recvs and sends held
+// back by a stalled ring. Call with sqLock held.
+void UringServer::submitSq() {
+    if (sqStalled) {
+        sqStalled = false;
+        for (size_t c = 0; c < conns.size(); ++c) {
+            Conn& conn = conns[c];
+            if (!conn.open) continue;
+            if (conn.needArm) armRecv(c);
+            if (!conn.sending && !conn.sendQueue.empty()) {
+                OutMsg* msg = conn.sendQueue.front();
+                conn.sendQueue.pop_front();
+                conn.sending = true;
+                prepSend(msg);
+            }
+        }
+    }
+    if (!ring->submit()) sqStalled = true;
+}
+
+// Retries held-back work now that CQEs have been reaped, which is what lets
+// a busy ring take submissions again. Call with recvLock held.
+void UringServer::unstall() {
+    pthread_mutex_lock(&sqLock);
+    if (sqStalled) submitSq();
+    pthread_mutex_unlock(&sqLock);
+}
+
+// Call with recvLock held
+void UringServer::closeConn(int c) {
+    pthread_mutex_lock(&sqLock);
+    Conn& conn = conns[c];
+    if (conn.open) {
+        std::cerr << "Client left, removing" << std::endl;
+        conn.open = false;
+        --openConns;
+        for (OutMsg* msg : conn.sendQueue) {
+            delete[] msg->data;
+            delete msg;
+        }
+        conn.sendQueue.clear();
+    }
+    pthread_mutex_unlock(&sqLock);
+}
+
+// Splits the bytes received on a connection into requests. Call with recvLock
+// held.
+void UringServer::parseReqs(int c) {
+    Conn& conn = conns[c];
+    const size_t hdrLen = sizeof(Request) - MAX_REQ_BYTES;
+
+    while (conn.inbuf.size() - conn.inOff >= hdrLen) {
+        const char* start = conn.inbuf.data() + conn.inOff;
+        size_t len = reinterpret_cast<const Request*>(start)->len;
+        if (len > MAX_REQ_BYTES) {
+            std::cerr << "ERROR! Request of " << len << " bytes" << std::endl;
+            exit(-1);
+        }
+        if (conn.inbuf.size() - conn.inOff < hdrLen + len) break;
+
+        ready.push_back(ReadyReq());
+        ready.back().conn = c;
+        ready.back().bytes.assign(start, start + hdrLen + len);
+        conn.inOff += hdrLen + len;
+    }
+
+    if (conn.inOff == conn.inbuf.size()) {
+        conn.inbuf.clear();
+        conn.inOff = 0;
+    } else if (conn.inOff > conn.inbuf.size() / 2) {
+        conn.inbuf.erase(conn.inbuf.begin(), conn.inbuf.begin() + conn.inOff);
+        conn.inOff = 0;
+    }
+}
+
+// Call with recvLock held
+void UringServer::handleCqe(struct io_uring_cqe* cqe) {
+    if (cqe->user_data & SEND_TAG) {
+        OutMsg* msg = reinterpret_cast<OutMsg*>(cqe->user_data & ~SEND_TAG);
+
+        pthread_mutex_lock(&sqLock);
+        Conn& conn = conns[msg->conn];
+        if (cqe->res > 0 && msg->off + cqe->res < msg->len && conn.open) {
+            msg->off += cqe->res; // Short send, push out the rest
+            prepSend(msg);
+        } else {
+            // On errors the client is gone, and its recv will tell us so
+            delete[] msg->data;
+            delete msg;
+            conn.sending = false;
+            if (conn.open && !conn.sendQueue.empty()) {
+                conn.sending = true;
+                OutMsg* next = conn.sendQueue.front();
+                conn.sendQueue.pop_front();
+                prepSend(next);
+            }
+        }
+        submitSq();
+        pthread_mutex_unlock(&sqLock);
+        return;
+    }
+
+    int c = cqe->user_data >> 1;
+    Conn& conn = conns[c];
+
+    if (cqe->res > 0) {
+        assert(cqe->flags & IORING_CQE_F_BUFFER);
+        unsigned bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        const char* buf = bufs + (size_t)bid * bufBytes;
+        conn.inbuf.insert(conn.inbuf.end(), buf, buf + cqe->res);
+        recycleBuf(bid);
+        parseReqs(c);
+    } else if (cqe->res == 0 || cqe->res == -ECONNRESET) { // Client exited
+        closeConn(c);
+        return;
+    } else if (cqe->res != -ENOBUFS) {
+        std::cerr << "recv() failed: " << strerror(-cqe->res) \
+            << ". Exiting" << std::endl;
+        exit(-1);
+    }
+
+    // The kernel stops a multishot recv when it runs out of buffers
+    if (!(cqe->flags & IORING_CQE_F_MORE) && conn.open) {
+        pthread_mutex_lock(&sqLock);
+        armRecv(c);
+        submitSq();
+        pthread_mutex_unlock(&sqLock);
+    }
+}
+
+// Call with recvLock held
+void UringServer::reapAvailable() {
+    struct io_uring_cqe* cqe;
+    while ((cqe = ring->peekCqe())) {
+        handleCqe(cqe);
+        ring->cqeSeen();
+    }
+    unstall();
+}
+
+size_t UringServer::recvReq(int id, void** data) {
+    traceRecvStart(id);
+    pthread_mutex_lock(&recvLock);
+
+    while (ready.empty() && openConns > 0) {
+        struct io_uring_cqe* cqe = ring->peekCqe();
+        if (!cqe) {
+            unstall();
+            ring->waitCqe();
+            continue;
+        }
+        handleCqe(cqe);
+        ring->cqeSeen();
+    }
+
+    if (ready.empty()) {
+        std::cerr << "All clients exited. Server finishing" << std::endl;
+        exit(0);
+    }
+
+    activeConns[id] = ready.front().conn;
+    reqbufs[id].swap(ready.front().bytes);
+    ready.pop_front();
+
+    pthread_mutex_unlock(&recvLock);
+
+    Request* req = reinterpret_cast<Request*>(reqbufs[id].data());
+    uint64_t curNs = getCurNs();
+    reqInfo[id].id = req->id;
+    reqInfo[id].startNs = curNs;
+    traceRecvEnd(id);
+    startCtrs(id);
+
+    *data = reinterpret_cast<void*>(&req->data);
+    return req->len;
+}
+
+void UringServer::sendResp(int id, const void* data, size_t len) {
+    stopCtrs(id);
+    traceSendStart(id);
+
+    OutMsg* msg = new OutMsg;
+    msg->conn = activeConns[id];
+    msg->len = sizeof(Response) - MAX_RESP_BYTES + len;
+    msg->off = 0;
+    msg->data = new char[msg->len];
+
+    Response* resp = reinterpret_cast<Response*>(msg->data);
+    resp->type = RESPONSE;
+    resp->id = reqInfo[id].id;
+    resp->len = len;
+    memcpy(reinterpret_cast<void*>(&resp->data), data, len);
+
+    uint64_t curNs = getCurNs();
+    assert(curNs > reqInfo[id].startNs);
+    resp->svcNs = curNs - reqInfo[id].startNs;
+    memcpy(resp->ctrs, reqInfo[id].ctrs, sizeof(resp->ctrs));
+
+    uint64_t lockTsc = Tracer::now();
+    pthread_mutex_lock(&sqLock);
+    tracer->slice("sqLock", reqInfo[id].id, lockTsc, Tracer::now());
+
+    queueSend(msg);
+
+    ++finishedReqs;
+
+    WindowEvent ev = windowEvent(finishedReqs);
+    if (ev == WARMUP_DONE) {
+        sendCtrl(ROI_BEGIN);
+    } else if (ev == ROI_DONE) {
+        sendCtrl(FINISH);
+    }
+
+    submitSq();
+    pthread_mutex_unlock(&sqLock);
+
+    // Free completed sends if no thread is waiting for requests right now
+    if (pthread_mutex_trylock(&recvLock) == 0) {
+        reapAvailable();
+        pthread_mutex_unlock(&recvLock);
+    }
+
+    traceSendEnd(id);
+}
+
+void UringServer::finish() {
+    pthread_mutex_lock(&sqLock);
+    sendCtrl(FINISH);
+    submitSq();
+    pthread_mutex_unlock(&sqLock);
+
+    // Wait until FINISH is out on every connection
+    pthread_mutex_lock(&recvLock);
+    while (true) {
+        bool sending = false;
+        pthread_mutex_lock(&sqLock);
+        for (Conn& conn : conns) {
+            sending |= (conn.open &&
+                    (conn.sending || !conn.sendQueue.empty()));
+        }
+        pthread_mutex_unlock(&sqLock);
+        if (!sending) break;
+
+        struct io_uring_cqe* cqe = ring->peekCqe();
+        if (!cqe) {
+            unstall();
+            ring->waitCqe();
+            continue;
+        }
+        handleCqe(cqe);
+        ring->cqeSeen();
+    }
+    pthread_mutex_unlock(&recvLock);
+}
+
+/*******************************************************************************
+ * Per-thread State
+ *******************************************************************************/
+__thread int tid;
+
+/*******************************************************************************
+ * Global data
+ *******************************************************************************/
+std::atomic_int curTid;
+UringServer* server;
+
+/*******************************************************************************
+ * API
+ *******************************************************************************/
+void tBenchServerInit(int nthreads) {
+    curTid = 0;
+    tBenchServerExpectThreads(nthreads);
+    std::string serverurl = getOpt<std::string>("TBENCH_SERVER", "");
+    int serverport = getOpt<int>("TBENCH_SERVER_PORT", 8080);
+    int nclients = getOpt<int>("TBENCH_NCLIENTS", 1);
+    server = new UringServer(nthreads, serverurl, serverport, nclients);
+}
+
+void tBenchServerThreadStart() {
+    tid = curTid++;
+    tBenchServerRegisterThread("server", tid);
+}
+
+void tBenchServerFinish() {
+    server->finish();
+}
+
+size_t tBenchRecvReq(void** data) {
+    return server->recvReq(tid, data);
+}
+
+void tBenchSendResp(const void* data, size_t size) {
+    return server->sendResp(tid, data, size);
+}
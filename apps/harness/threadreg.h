@@ -0,0 +1,125 @@
+/** $lic$
+ * Copyright (C) 2016-2017 by Massachusetts Institute of Technology
+ *
+ * This file is part of TailBench.
+ *
+ * If you use this software in your research, we request that you reference the
+ * TaiBench paper ("TailBench: A Benchmark Suite and Evaluation Methodology for
+ * Latency-Critical Applications", Kasture and Sanchez, IISWC-2016) as the
+ * source in any publications that use this software, and that you send us a
+ * citation of your work.
+ *
+ * TailBench is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __THREADREG_H
+#define __THREADREG_H
+
+// Registry of the server threads the profiler should attach to. Each thread
+// adds a "role index tid core" record; once the expected number of threads
+// has registered, the table is written to a temporary file and renamed to
+// $SCRATCH_DIR/tbench_server_threads.txt, so readers never see a partial
+// table. If the launcher created a FIFO at that path plus ".ready", a byte is
+// written to it on publication, so the launcher can block instead of polling.
+//
+// This defines the tBenchServer*Thread* API, so it must be included by exactly
+// one source per binary, i.e. by the tbench_server_*.cpp variants, which are
+// never linked together.
+
+#include "helpers.h"
+#include "tbench_server.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class ThreadRegistry {
+    private:
+        pthread_mutex_t lock;
+        unsigned expected;
+        std::vector<std::string> records;
+        std::string path;
+
+        ThreadRegistry() : expected(0) {
+            pthread_mutex_init(&lock, nullptr);
+            std::string tmpdir = getOpt<std::string>("SCRATCH_DIR", "/tmp");
+            path = tmpdir + "/tbench_server_threads.txt";
+        }
+
+        // Call with lock held
+        void publish() {
+            std::string tmpPath = path + ".tmp";
+            std::ofstream out(tmpPath.c_str(), std::ios::trunc);
+            for (const std::string& r : records) out << r << std::endl;
+            out.close();
+
+            if (rename(tmpPath.c_str(), path.c_str()) == -1) {
+                std::cerr << "[TBENCH_SERVER] rename(" << tmpPath << ") failed: " \
+                    << strerror(errno) << std::endl;
+                return;
+            }
+            std::cerr << "[TBENCH_SERVER] Published " << records.size() \
+                << " threads at " << path << std::endl;
+
+            std::string readyPath = path + ".ready";
+            struct stat st;
+            if (stat(readyPath.c_str(), &st) == 0 && S_ISFIFO(st.st_mode)) {
+                // Fails with ENXIO if nobody is listening, which is fine
+                int fd = open(readyPath.c_str(), O_WRONLY | O_NONBLOCK);
+                if (fd != -1) {
+                    if (write(fd, "1", 1) != 1) {
+                        std::cerr << "[TBENCH_SERVER] Could not signal " \
+                            << readyPath << std::endl;
+                    }
+                    close(fd);
+                }
+            }
+        }
+
+    public:
+        static ThreadRegistry& get() {
+            static ThreadRegistry registry;
+            return registry;
+        }
+
+        void expect(unsigned n) {
+            pthread_mutex_lock(&lock);
+            expected += n;
+            pthread_mutex_unlock(&lock);
+        }
+
+        // Records the calling thread. Threads that register after the table
+        // was first published cause it to be republished.
+        void add(const char* role, int index) {
+            pid_t tid = (pid_t)syscall(SYS_gettid);
+            std::stringstream rec;
+            rec << role << " " << index << " " << tid << " " << sched_getcpu();
+
+            pthread_mutex_lock(&lock);
+            records.push_back(rec.str());
+            if (records.size() >= expected) publish();
+            pthread_mutex_unlock(&lock);
+        }
+};
+
+void tBenchServerExpectThreads(int nthreads) {
+    ThreadRegistry::get().expect(nthreads);
+}
+
+void tBenchServerRegisterThread(const char* role, int index) {
+    ThreadRegistry::get().add(role, index);
+}
+
+#endif
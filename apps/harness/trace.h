@@ -0,0 +1,232 @@
+/** $lic$
+ * Copyright (C) 2016-2017 by Massachusetts Institute of Technology
+ *
+ * This file is part of TailBench.
+ *
+ * If you use this software in your research, we request that you reference the
+ * TaiBench paper ("TailBench: A Benchmark Suite and Evaluation Methodology for
+ * Latency-Critical Applications", Kasture and Sanchez, IISWC-2016) as the
+ * source in any publications that use this software, and that you send us a
+ * citation of your work.
+ *
+ * TailBench is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __TRACE_H
+#define __TRACE_H
+
+// Opt-in request lifecycle tracing (TBENCH_TRACE=1). Client and server stamp
+// the stages of a request with the TSC into a per-thread ring that only that
+// thread writes, so tracing takes no locks. The rings keep the last
+// TBENCH_TRACE_EVENTS events of each thread and are written out in Chrome
+// trace format (viewable in Perfetto or chrome://tracing) when the process
+// exits or the client dumps its stats.
+//
+// Only requests whose id is a multiple of TBENCH_TRACE_SAMPLE are traced.
+// Request ids are assigned by the client, so the client and a separate server
+// process trace the same requests. Timestamps are converted to CLOCK_REALTIME,
+// so the traces of processes on the same host line up.
+
+#include "helpers.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+class Tracer {
+    private:
+        struct Event {
+            const char* name; // Must be a literal
+            uint64_t reqId;
+            uint64_t start;
+            uint64_t end;
+            char phase; // 'X' (slice), 'b'/'e' (request begin/end)
+            bool startIsNs; // start is CLOCK_REALTIME ns instead of TSC
+        };
+
+        struct Ring {
+            pid_t tid;
+            std::vector<Event> events;
+            std::atomic<uint64_t> head;
+        };
+
+        bool enabled;
+        uint64_t sampleEvery;
+        uint64_t ringEvents;
+        std::string role;
+
+        uint64_t tsc0;
+        uint64_t ns0;
+
+        pthread_mutex_t lock; // Protects rings and dumped
+        std::vector<Ring*> rings;
+        bool dumped;
+
+        Tracer() : dumped(false) {
+            pthread_mutex_init(&lock, nullptr);
+            enabled = getOpt<int>("TBENCH_TRACE", 0);
+            sampleEvery = getOpt<uint64_t>("TBENCH_TRACE_SAMPLE", 1);
+            ringEvents = getOpt<uint64_t>("TBENCH_TRACE_EVENTS", 1 << 16);
+            if (sampleEvery == 0) sampleEvery = 1;
+            if (ringEvents == 0) enabled = false;
+
+            tsc0 = now();
+            ns0 = getCurNs();
+            if (enabled) atexit(dumpAtExit);
+        }
+
+        static void dumpAtExit() { get().dump(); }
+
+        Ring* threadRing() {
+            static __thread Ring* ring = nullptr;
+            if (!ring) {
+                ring = new Ring;
+                ring->tid = (pid_t)syscall(SYS_gettid);
+                ring->events.resize(ringEvents);
+                ring->head = 0;
+
+                pthread_mutex_lock(&lock);
+                rings.push_back(ring);
+                pthread_mutex_unlock(&lock);
+            }
+            return ring;
+        }
+
+        void record(const char* name, uint64_t reqId, uint64_t start,
+                uint64_t end, char phase, bool startIsNs) {
+            Ring* ring = threadRing();
+            uint64_t h = ring->head.load(std::memory_order_relaxed);
+            Event& ev = ring->events[h % ringEvents];
+            ev.name = name;
+            ev.reqId = reqId;
+            ev.start = start;
+            ev.end = end;
+            ev.phase = phase;
+            ev.startIsNs = startIsNs;
+            ring->head.store(h + 1, std::memory_order_release);
+        }
+
+    public:
+        static Tracer& get() {
+            // Never destroyed, so that it outlives dumpAtExit()
+            static Tracer* tracer = new Tracer();
+            return *tracer;
+        }
+
+        static uint64_t now() {
+            return __builtin_ia32_rdtsc();
+        }
+
+        bool on() const { return enabled; }
+
+        // Whether to trace request reqId
+        bool on(uint64_t reqId) const {
+            return enabled && reqId % sampleEvery == 0;
+        }
+
+        // Names this process in the trace, e.g., "client" or "server"
+        void setRole(const char* r) { role = r; }
+
+        // A stage of request reqId on this thread, between two now() stamps
+        void slice(const char* name, uint64_t reqId, uint64_t startTsc,
+                uint64_t endTsc) {
+            if (on(reqId)) record(name, reqId, startTsc, endTsc, 'X', false);
+        }
+
+        // The whole life of a request, from its generation time (genNs) to
+        // its completion, shown as an async span keyed by the request id
+        void requestBegin(uint64_t reqId, uint64_t genNs) {
+            if (on(reqId)) record("request", reqId, genNs, 0, 'b', true);
+        }
+
+        void requestEnd(uint64_t reqId) {
+            if (on(reqId)) record("request", reqId, now(), 0, 'e', false);
+        }
+
+        // Writes tbench_trace_<role>_<pid>.json in the working directory.
+        // Only the first call has an effect. Threads may still be recording,
+        // so their last few events can be torn.
+        void dump() {
+            if (!enabled) return;
+            pthread_mutex_lock(&lock);
+            if (dumped) {
+                pthread_mutex_unlock(&lock);
+                return;
+            }
+            dumped = true;
+
+            // Calibrate the TSC against the wall clock over the whole run
+            uint64_t tsc1 = now();
+            uint64_t ns1 = getCurNs();
+            double nsPerTsc = (tsc1 > tsc0) ?
+                static_cast<double>(ns1 - ns0) / (tsc1 - tsc0) : 1.0;
+            // Wall-clock ns since the epoch need more than a double's 53 bits
+            // to stay exact, so only the TSC delta goes through floating point
+            auto toNs = [&](uint64_t t, bool isNs) -> uint64_t {
+                if (isNs) return t;
+                int64_t delta = static_cast<int64_t>(t - tsc0);
+                return ns0 + static_cast<int64_t>(delta * nsPerTsc);
+            };
+
+            const char* r = role.empty() ? "tbench" : role.c_str();
+            int pid = getpid();
+            std::string path = std::string("tbench_trace_") + r + "_" +
+                std::to_string(pid) + ".json";
+            FILE* out = fopen(path.c_str(), "w");
+            if (!out) {
+                std::cerr << "[TBENCH] Could not write trace " << path \
+                    << std::endl;
+                pthread_mutex_unlock(&lock);
+                return;
+            }
+
+            fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+            fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                    "\"args\":{\"name\":\"%s\"}}", pid, r);
+
+            uint64_t total = 0;
+            for (Ring* ring : rings) {
+                uint64_t head = ring->head.load(std::memory_order_acquire);
+                uint64_t first = (head > ringEvents) ? head - ringEvents : 0;
+                for (uint64_t h = first; h < head; ++h) {
+                    const Event& ev = ring->events[h % ringEvents];
+                    uint64_t ts = toNs(ev.start, ev.startIsNs);
+                    fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"tbench\","
+                            "\"ph\":\"%c\",\"pid\":%d,\"tid\":%d,"
+                            "\"ts\":%lu.%03lu",
+                            ev.name, ev.phase, pid, ring->tid, ts / 1000,
+                            ts % 1000);
+                    if (ev.phase == 'X') {
+                        uint64_t dur = (ev.end > ev.start) ?
+                            static_cast<uint64_t>((ev.end - ev.start) *
+                                    nsPerTsc) : 0;
+                        fprintf(out, ",\"dur\":%lu.%03lu", dur / 1000,
+                                dur % 1000);
+                    } else {
+                        fprintf(out, ",\"id\":\"%lu\"", ev.reqId);
+                    }
+                    fprintf(out, ",\"args\":{\"req\":%lu}}", ev.reqId);
+                }
+                total += head - first;
+            }
+
+            fprintf(out, "\n]}\n");
+            fclose(out);
+            std::cerr << "[TBENCH] Wrote " << total << " trace events to " \
+                << path << std::endl;
+
+            pthread_mutex_unlock(&lock);
+        }
+};
+
+#endif
@@ -0,0 +1,204 @@
+/** $lic$
+ * Copyright (C) 2016-2017 by Massachusetts Institute of Technology
+ *
+ * This file is part of TailBench.
+ *
+ * If you use this software in your research, we request that you reference the
+ * TaiBench paper ("TailBench: A Benchmark Suite and Evaluation Methodology for
+ * Latency-Critical Applications", Kasture and Sanchez, IISWC-2016) as the
+ * source in any publications that use this software, and that you send us a
+ * citation of your work.
+ *
+ * TailBench is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef __URING_H
+#define __URING_H
+
+// Minimal io_uring wrapper on top of the raw syscalls, so the harness doesn't
+// depend on liburing. Needs Linux 5.19+ (multishot recv, provided buffer
+// rings). Callers synchronize: one thread at a time may fill and submit SQEs,
+// and one thread at a time may consume CQEs. The kernel refuses submissions
+// with EBUSY while completions it could not post are waiting for CQ space, so
+// when getSqe() or submit() fail, callers must reap CQEs and then retry.
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <iostream>
+
+class Uring {
+    private:
+        int ringFd;
+        bool sqpoll;
+
+        unsigned* sqHead;
+        unsigned* sqTail;
+        unsigned* sqFlags;
+        unsigned sqMask;
+        unsigned sqEntries;
+        unsigned sqLocalTail;
+        struct io_uring_sqe* sqes;
+
+        unsigned* cqHead;
+        unsigned* cqTail;
+        unsigned cqMask;
+        struct io_uring_cqe* cqes;
+
+        static void fail(const char* what) {
+            std::cerr << what << " failed: " << strerror(errno) << std::endl;
+            exit(-1);
+        }
+
+        int enter(unsigned toSubmit, unsigned minComplete, unsigned flags) {
+            int ret;
+            do {
+                ret = syscall(__NR_io_uring_enter, ringFd, toSubmit,
+                        minComplete, flags, nullptr, 0);
+            } while (ret == -1 && errno == EINTR);
+            if (ret == -1 && errno != EBUSY && errno != EAGAIN) {
+                fail("io_uring_enter()");
+            }
+            return ret;
+        }
+
+    public:
+        // With sqpoll, a kernel thread picks up submissions and submit()
+        // rarely needs a syscall; attachFd shares that thread with another
+        // ring.
+        Uring(unsigned entries, bool _sqpoll, int attachFd = -1) {
+            sqpoll = _sqpoll;
+
+            struct io_uring_params p;
+            memset(&p, 0, sizeof(p));
+            p.flags = IORING_SETUP_CQSIZE;
+            p.cq_entries = 4 * entries;
+            if (sqpoll) {
+                p.flags |= IORING_SETUP_SQPOLL;
+                p.sq_thread_idle = 1000; // ms
+                if (attachFd != -1) {
+                    p.flags |= IORING_SETUP_ATTACH_WQ;
+                    p.wq_fd = attachFd;
+                }
+            }
+
+            ringFd = syscall(__NR_io_uring_setup, entries, &p);
+            if (ringFd == -1) fail("io_uring_setup()");
+            if (!(p.features & IORING_FEAT_SINGLE_MMAP) ||
+                    !(p.features & IORING_FEAT_NODROP)) {
+                std::cerr << "io_uring: kernel is too old" << std::endl;
+                exit(-1);
+            }
+
+            size_t sqBytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+            size_t cqBytes = p.cq_off.cqes +
+                p.cq_entries * sizeof(struct io_uring_cqe);
+            size_t ringBytes = sqBytes > cqBytes ? sqBytes : cqBytes;
+            char* ring = reinterpret_cast<char*>(mmap(nullptr, ringBytes,
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd, IORING_OFF_SQ_RING));
+            if (ring == MAP_FAILED) fail("mmap(sq/cq ring)");
+
+            sqes = reinterpret_cast<struct io_uring_sqe*>(mmap(nullptr,
+                        p.sq_entries * sizeof(struct io_uring_sqe),
+                        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd, IORING_OFF_SQES));
+            if (sqes == MAP_FAILED) fail("mmap(sqes)");
+
+            sqHead = reinterpret_cast<unsigned*>(ring + p.sq_off.head);
+            sqTail = reinterpret_cast<unsigned*>(ring + p.sq_off.tail);
+            sqFlags = reinterpret_cast<unsigned*>(ring + p.sq_off.flags);
+            sqMask = *reinterpret_cast<unsigned*>(ring + p.sq_off.ring_mask);
+            sqEntries = p.sq_entries;
+            sqLocalTail = *sqTail;
+
+            // SQE i always lives in slot i
+            unsigned* sqArray = reinterpret_cast<unsigned*>(ring + p.sq_off.array);
+            for (unsigned i = 0; i < sqEntries; ++i) sqArray[i] = i;
+
+            cqHead = reinterpret_cast<unsigned*>(ring + p.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(ring + p.cq_off.tail);
+            cqMask = *reinterpret_cast<unsigned*>(ring + p.cq_off.ring_mask);
+            cqes = reinterpret_cast<struct io_uring_cqe*>(ring + p.cq_off.cqes);
+        }
+
+        int fd() const { return ringFd; }
+
+        // Returns a zeroed SQE, submitting pending ones first if the SQ is
+        // full, or null if it is still full after that
+        struct io_uring_sqe* getSqe() {
+            if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >=
+                    sqEntries) {
+                submit();
+                if (sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >=
+                        sqEntries) {
+                    return nullptr;
+                }
+            }
+            struct io_uring_sqe* sqe = &sqes[sqLocalTail & sqMask];
+            memset(sqe, 0, sizeof(*sqe));
+            sqLocalTail++;
+            return sqe;
+        }
+
+        // Hands all SQEs obtained so far to the kernel. Returns false if the
+        // kernel refused some of them (EBUSY or EAGAIN); they stay queued
+        // and go out with the next submit().
+        bool submit() {
+            __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+            if (sqpoll) {
+                if (__atomic_load_n(sqFlags, __ATOMIC_ACQUIRE) &
+                        IORING_SQ_NEED_WAKEUP) {
+                    enter(0, 0, IORING_ENTER_SQ_WAKEUP);
+                }
+                return true;
+            }
+
+            // Count from the kernel's head, not the last tail we published,
+            // so SQEs a refused call left behind are submitted too
+            unsigned pending = sqLocalTail -
+                __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+            if (pending == 0) return true;
+            return enter(pending, 0, 0) != -1 &&
+                __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) == sqLocalTail;
+        }
+
+        // Returns the next completion without entering the kernel, or null
+        struct io_uring_cqe* peekCqe() {
+            unsigned head = *cqHead;
+            if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+                return nullptr;
+            }
+            return &cqes[head & cqMask];
+        }
+
+        void cqeSeen() {
+            __atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+        }
+
+        // Blocks until at least one completion is available
+        void waitCqe() {
+            enter(0, 1, IORING_ENTER_GETEVENTS);
+        }
+
+        void registerBufRing(struct io_uring_buf_ring* br, unsigned entries,
+                unsigned bgid) {
+            struct io_uring_buf_reg reg;
+            memset(&reg, 0, sizeof(reg));
+            reg.ring_addr = reinterpret_cast<uint64_t>(br);
+            reg.ring_entries = entries;
+            reg.bgid = bgid;
+            if (syscall(__NR_io_uring_register, ringFd,
+                        IORING_REGISTER_PBUF_RING, &reg, 1) == -1) {
+                fail("io_uring_register(PBUF_RING)");
+            }
+        }
+};
+
+#endif
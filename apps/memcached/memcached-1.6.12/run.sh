@@ -4,7 +4,7 @@
 DIR="$( cd "$( dirname "${BASH_SOURCE[0]}" )" && pwd )"
 source ${DIR}/../../run_configs.sh
 
-rm ${SCRATCH_DIR}/memcached_worker.tid
+rm -f ${SCRATCH_DIR}/memcached_worker_threads.txt
 
 SCRATCH_DIR=${SCRATCH_DIR} \
 ./memcached -t 1 -l 127.0.0.1 -m 2048 -I 128m
@@ -15,6 +15,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "queue.h"
 
@@ -28,8 +32,8 @@
 
 #define ITEMS_PER_ALLOC 64
 
-#ifndef gettid
 #include <sys/syscall.h>
+#ifndef gettid
 #define gettid() ((pid_t)syscall(SYS_gettid))
 #endif
 
@@ -484,30 +488,88 @@ static void setup_thread(LIBEVENT_THREAD *me) {
 }
 
 /*
- * Worker thread: main event loop
+ * Registry of worker thread ids, read by the dataset searcher so that it can
+ * profile every worker. Each worker adds a "role index tid core" record; once
+ * all have, the table is written to a temporary file and renamed into place,
+ * and a byte is written to the ".ready" FIFO if the launcher created one, so
+ * the launcher can block on it instead of polling.
  */
-static void *worker_libevent(void *arg) {
-    // hrlee: We need some form of inter-process communication to let
-    // the dataset searcher know of this worker thread's id.
-    // let's just use a very crude form of writing to a file for now.
-    // TODO: Use a more flexible and robust IPC mechanism.
+static pthread_mutex_t tid_registry_lock = PTHREAD_MUTEX_INITIALIZER;
+static char *tid_registry = NULL;
+static size_t tid_registry_len = 0;
+static int tid_registry_count = 0;
 
+static void publish_tid_registry(void) {
     char const* tmpdir = getenv("SCRATCH_DIR");
-    char tidfilepath[100];
-    if (tmpdir == NULL)
-        strcpy(tidfilepath, "/tmp");
-    else
-        strcpy(tidfilepath, tmpdir);
+    char path[PATH_MAX], tmppath[PATH_MAX + 8], readypath[PATH_MAX + 8];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s/memcached_worker_threads.txt",
+             tmpdir ? tmpdir : "/tmp");
+    snprintf(tmppath, sizeof(tmppath), "%s.tmp", path);
+    snprintf(readypath, sizeof(readypath), "%s.ready", path);
+
+    FILE *f = fopen(tmppath, "w");
+    if (f == NULL) {
+        fprintf(stderr, "[memcached] Could not open %s: %s\n", tmppath,
+                strerror(errno));
+        return;
+    }
+    fwrite(tid_registry, 1, tid_registry_len, f);
+    fclose(f);
 
-    strcat(tidfilepath, "/memcached_worker.tid");
+    if (rename(tmppath, path) != 0) {
+        fprintf(stderr, "[memcached] Could not rename %s: %s\n", tmppath,
+                strerror(errno));
+        return;
+    }
+    fprintf(stderr, "[memcached] Published %d worker threads at %s\n",
+            tid_registry_count, path);
+
+    if (stat(readypath, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        /* Fails with ENXIO if nobody is listening, which is fine */
+        int fd = open(readypath, O_WRONLY | O_NONBLOCK);
+        if (fd != -1) {
+            if (write(fd, "1", 1) != 1) {
+                fprintf(stderr, "[memcached] Could not signal %s\n", readypath);
+            }
+            close(fd);
+        }
+    }
+}
 
-    fprintf(stderr, "[memcached] Saving worker thread id file at %s\n", tidfilepath);
-    FILE *tidfile =  fopen(tidfilepath, "w");
-    fprintf(tidfile, "%d", gettid());
-    fclose(tidfile);
+static void register_worker_tid(int index) {
+    char rec[64];
+    unsigned cpu = 0;
+    syscall(SYS_getcpu, &cpu, NULL, NULL);
+    int len = snprintf(rec, sizeof(rec), "worker %d %d %u\n", index, gettid(),
+                       cpu);
+
+    pthread_mutex_lock(&tid_registry_lock);
+    char *grown = realloc(tid_registry, tid_registry_len + len);
+    if (grown == NULL) {
+        fprintf(stderr, "[memcached] Could not grow the thread registry\n");
+        pthread_mutex_unlock(&tid_registry_lock);
+        return;
+    }
+    tid_registry = grown;
+    memcpy(tid_registry + tid_registry_len, rec, len);
+    tid_registry_len += len;
+    tid_registry_count++;
+    if (tid_registry_count == settings.num_threads) {
+        publish_tid_registry();
+    }
+    pthread_mutex_unlock(&tid_registry_lock);
+}
 
+/*
+ * Worker thread: main event loop
+ */
+static void *worker_libevent(void *arg) {
     LIBEVENT_THREAD *me = arg;
 
+    register_worker_tid(me - threads);
+
     /* Any per-thread setup can happen here; memcached_thread_init() will block until
      * all threads have finished initializing.
      */
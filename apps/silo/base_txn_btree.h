@@ -168,6 +168,18 @@ protected:
             const typename P::Key &k,
             ValueReader &value_reader);
 
+  // same as calling do_search() on each of the n keys in order, with the
+  // reader value_reader_for(i) for key i, but looks the keys up in the
+  // underlying btree together and prefetches the tuples found before reading
+  // them
+  template <typename Traits, typename ValueReaderFor>
+  inline void
+  do_multi_search(Transaction<Traits> &t,
+                  const typename P::Key *ks,
+                  size_t n,
+                  bool *found,
+                  ValueReaderFor value_reader_for);
+
   template <typename Traits, typename Callback,
             typename KeyReader, typename ValueReader>
   inline void
@@ -239,6 +251,52 @@ base_txn_btree<Transaction, P>::do_search(
   }
 }
 
+template <template <typename> class Transaction, typename P>
+template <typename Traits, typename ValueReaderFor>
+void
+base_txn_btree<Transaction, P>::do_multi_search(
+    Transaction<Traits> &t,
+    const typename P::Key *ks,
+    size_t n,
+    bool *found,
+    ValueReaderFor value_reader_for)
+{
+  t.ensure_active();
+
+  const size_t group = concurrent_btree::NMultiSearchGroup;
+  varkey vks[group];
+  typename concurrent_btree::value_type underlying_vs[group];
+  concurrent_btree::versioned_node_t search_infos[group];
+
+  for (size_t base = 0; base < n; base += group) {
+    const size_t m = std::min(n - base, group);
+    for (size_t i = 0; i < m; i++) {
+      typename P::KeyWriter key_writer(&ks[base + i]);
+      vks[i] = varkey(*key_writer.fully_materialize(true, t.string_allocator()));
+    }
+
+    this->underlying_btree.multi_search(
+        vks, m, underlying_vs, found + base, search_infos);
+
+    for (size_t i = 0; i < m; i++)
+      if (found[base + i])
+        reinterpret_cast<const dbtuple *>(underlying_vs[i])->prefetch();
+
+    // record the reads in key order, as do_search() would have
+    for (size_t i = 0; i < m; i++) {
+      if (found[base + i]) {
+        const dbtuple * const tuple =
+          reinterpret_cast<const dbtuple *>(underlying_vs[i]);
+        auto value_reader = value_reader_for(base + i);
+        found[base + i] = t.do_tuple_read(tuple, value_reader);
+      } else {
+        // not found, add to absent_set
+        t.do_node_read(search_infos[i].first, search_infos[i].second);
+      }
+    }
+  }
+}
+
 template <template <typename> class Transaction, typename P>
 std::map<std::string, uint64_t>
 base_txn_btree<Transaction, P>::unsafe_purge(bool dump_stats)
@@ -29,6 +29,24 @@ public:
       std::string &value,
       size_t max_bytes_read = std::string::npos) = 0;
 
+  /**
+   * Get n keys at once. Equivalent to calling get() on each key in order,
+   * setting found[i] to its result and values[i] to its value, but lets
+   * the underlying DB overlap the lookups. Default implementation calls
+   * get() in a loop.
+   */
+  virtual void multi_get(
+      void *txn,
+      const std::string *keys,
+      size_t n,
+      std::string *values,
+      bool *found,
+      size_t max_bytes_read = std::string::npos)
+  {
+    for (size_t i = 0; i < n; i++)
+      found[i] = get(txn, keys[i], values[i], max_bytes_read);
+  }
+
   class scan_callback {
   public:
     virtual ~scan_callback() {}
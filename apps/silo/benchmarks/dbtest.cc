@@ -71,6 +71,7 @@ main(int argc, char **argv)
   int nofsync = 0;
   int do_compress = 0;
   int fake_writes = 0;
+  int log_numa_aware = 0;
   int disable_gc = 0;
   int disable_snapshots = 0;
   vector<string> logfiles;
@@ -100,6 +101,7 @@ main(int argc, char **argv)
       {"log-nofsync"                , no_argument       , &nofsync                   , 1}   ,
       {"log-compress"               , no_argument       , &do_compress               , 1}   ,
       {"log-fake-writes"            , no_argument       , &fake_writes               , 1}   ,
+      {"log-numa-aware"             , no_argument       , &log_numa_aware            , 1}   ,
       {"disable-gc"                 , no_argument       , &disable_gc                , 1}   ,
       {"disable-snapshots"          , no_argument       , &disable_snapshots         , 1}   ,
       {"stats-server-sockfile"      , required_argument , 0                          , 'x'} ,
@@ -222,6 +224,11 @@ main(int argc, char **argv)
     return 1;
   }
 
+  if (log_numa_aware && logfiles.empty()) {
+    cerr << "[ERROR] --log-numa-aware specified without logging enabled" << endl;
+    return 1;
+  }
+
   if (fake_writes && nofsync) {
     cerr << "[WARNING] --log-nofsync has no effect with --log-fake-writes enabled" << endl;
   }
@@ -283,7 +290,8 @@ main(int argc, char **argv)
   } else if (db_type == "ndb-proto1") {
     // XXX: hacky simulation of proto1
     db = new ndb_wrapper<transaction_proto2>(
-        logfiles, assignments, !nofsync, do_compress, fake_writes);
+        logfiles, assignments, !nofsync, do_compress, fake_writes,
+        log_numa_aware);
     transaction_proto2_static::set_hack_status(true);
     ALWAYS_ASSERT(transaction_proto2_static::get_hack_status());
 #ifdef PROTO2_CAN_DISABLE_GC
@@ -292,7 +300,8 @@ main(int argc, char **argv)
 #endif
   } else if (db_type == "ndb-proto2") {
     db = new ndb_wrapper<transaction_proto2>(
-        logfiles, assignments, !nofsync, do_compress, fake_writes);
+        logfiles, assignments, !nofsync, do_compress, fake_writes,
+        log_numa_aware);
     ALWAYS_ASSERT(!transaction_proto2_static::get_hack_status());
 #ifdef PROTO2_CAN_DISABLE_GC
     if (!disable_gc)
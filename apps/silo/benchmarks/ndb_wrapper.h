@@ -44,7 +44,8 @@ public:
       const std::vector<std::vector<unsigned>> &assignments_given,
       bool call_fsync,
       bool use_compression,
-      bool fake_writes);
+      bool fake_writes,
+      bool numa_aware = false);
 
   virtual ssize_t txn_max_batch_size() const OVERRIDE { return 100; }
 
@@ -120,6 +121,13 @@ public:
       void *txn,
       const std::string &key,
       std::string &value, size_t max_bytes_read);
+  virtual void multi_get(
+      void *txn,
+      const std::string *keys,
+      size_t n,
+      std::string *values,
+      bool *found,
+      size_t max_bytes_read);
   virtual const char * put(
       void *txn,
       const std::string &key,
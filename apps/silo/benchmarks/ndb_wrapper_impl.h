@@ -127,7 +127,8 @@ ndb_wrapper<Transaction>::ndb_wrapper(
     const std::vector<std::vector<unsigned>> &assignments_given,
     bool call_fsync,
     bool use_compression,
-    bool fake_writes)
+    bool fake_writes,
+    bool numa_aware)
 {
   if (logfiles.empty())
     return;
@@ -136,13 +137,15 @@ ndb_wrapper<Transaction>::ndb_wrapper(
       nthreads, logfiles, assignments_given, &assignments_used,
       call_fsync,
       use_compression,
-      fake_writes);
+      fake_writes,
+      numa_aware);
   if (verbose) {
     std::cerr << "[logging subsystem]" << std::endl;
     std::cerr << "  assignments: " << assignments_used << std::endl;
     std::cerr << "  call fsync : " << call_fsync       << std::endl;
     std::cerr << "  compression: " << use_compression  << std::endl;
     std::cerr << "  fake_writes: " << fake_writes      << std::endl;
+    std::cerr << "  numa_aware : " << txn_logger::IsNumaAware() << std::endl;
   }
 }
 
@@ -333,6 +336,38 @@ ndb_ordered_index<Transaction>::get(
   }
 }
 
+template <template <typename> class Transaction>
+void
+ndb_ordered_index<Transaction>::multi_get(
+    void *txn,
+    const std::string *keys,
+    size_t n,
+    std::string *values,
+    bool *found,
+    size_t max_bytes_read)
+{
+  PERF_DECL(static std::string probe1_name(std::string(__PRETTY_FUNCTION__) + std::string(":total:")));
+  ANON_REGION(probe1_name.c_str(), &private_::ndb_get_probe0_cg);
+  ndbtxn * const p = reinterpret_cast<ndbtxn *>(txn);
+  try {
+#define MY_OP_X(a, b) \
+  case a: \
+    { \
+      auto t = cast< b >()(p); \
+      btr.multi_search(*t, keys, n, values, found, max_bytes_read); \
+      return; \
+    }
+    switch (p->hint) {
+      TXN_PROFILE_HINT_OP(MY_OP_X)
+    default:
+      ALWAYS_ASSERT(false);
+    }
+#undef MY_OP_X
+  } catch (transaction_abort_exception &ex) {
+    throw abstract_db::abstract_abort_exception();
+  }
+}
+
 // XXX: find way to remove code duplication below using C++ templates!
 
 template <template <typename> class Transaction>
@@ -526,11 +526,19 @@ public:
     obj_key0.reserve(str_arena::MinStrReserveLength);
     obj_key1.reserve(str_arena::MinStrReserveLength);
     obj_v.reserve(str_arena::MinStrReserveLength);
+    for (size_t i = 0; i < NMaxMultiGetKeys; i++) {
+      multi_keys[i].reserve(str_arena::MinStrReserveLength);
+      multi_v0[i].reserve(str_arena::MinStrReserveLength);
+      multi_v1[i].reserve(str_arena::MinStrReserveLength);
+    }
   }
 
   // XXX(stephentu): tune this
   static const size_t NMaxCustomerIdxScanElems = 512;
 
+  // keys per multi_get(); covers the 15 lines of a new order
+  static const size_t NMaxMultiGetKeys = 16;
+
   txn_result txn_new_order();
 
   static txn_result
@@ -631,6 +639,12 @@ private:
   string obj_key0;
   string obj_key1;
   string obj_v;
+
+  // scratch space for multi_get()
+  string multi_keys[NMaxMultiGetKeys];
+  string multi_v0[NMaxMultiGetKeys];
+  string multi_v1[NMaxMultiGetKeys];
+  bool multi_found[NMaxMultiGetKeys];
 };
 
 class tpcc_warehouse_loader : public bench_loader, public tpcc_worker_mixin {
@@ -1350,21 +1364,59 @@ tpcc_worker::txn_new_order()
 
     tbl_oorder_c_id_idx(warehouse_id)->insert(txn, Encode(str(), k_oo_idx), Encode(str(), v_oo_idx));
 
+    // look up all items, and the stock of each line, up front so that the
+    // index lookups overlap. a line whose stock row came up on an earlier
+    // line reads it again below, after that line's put, as does every line
+    // if the stock rows are split across several indexes.
+    for (uint i = 0; i < numItems; i++) {
+      const item::key k_i(itemIDs[i]);
+      Encode(multi_keys[i], k_i);
+    }
+    tbl_item(1)->multi_get(txn, multi_keys, numItems, multi_v0, multi_found);
+    for (uint i = 0; i < numItems; i++)
+      ALWAYS_ASSERT(multi_found[i]);
+
+    int stock_batch_idx[15];
+    uint n_stock_batch = 0;
+    bool stock_batched = true;
+    for (uint i = 0; i < numItems && stock_batched; i++)
+      stock_batched = tbl_stock(supplierWarehouseIDs[i]) == tbl_stock(warehouse_id);
+    for (uint i = 0; i < numItems; i++) {
+      stock_batch_idx[i] = -1;
+      if (!stock_batched)
+        continue;
+      bool repeated = false;
+      for (uint j = 0; j < i && !repeated; j++)
+        repeated = itemIDs[j] == itemIDs[i] &&
+                   supplierWarehouseIDs[j] == supplierWarehouseIDs[i];
+      if (repeated)
+        continue;
+      const stock::key k_s(supplierWarehouseIDs[i], itemIDs[i]);
+      Encode(multi_keys[n_stock_batch], k_s);
+      stock_batch_idx[i] = n_stock_batch++;
+    }
+    if (n_stock_batch) {
+      tbl_stock(warehouse_id)->multi_get(txn, multi_keys, n_stock_batch, multi_v1, multi_found);
+      for (uint i = 0; i < n_stock_batch; i++)
+        ALWAYS_ASSERT(multi_found[i]);
+    }
+
     for (uint ol_number = 1; ol_number <= numItems; ol_number++) {
       const uint ol_supply_w_id = supplierWarehouseIDs[ol_number - 1];
       const uint ol_i_id = itemIDs[ol_number - 1];
       const uint ol_quantity = orderQuantities[ol_number - 1];
 
       const item::key k_i(ol_i_id);
-      ALWAYS_ASSERT(tbl_item(1)->get(txn, Encode(obj_key0, k_i), obj_v));
       item::value v_i_temp;
-      const item::value *v_i = Decode(obj_v, v_i_temp);
+      const item::value *v_i = Decode(multi_v0[ol_number - 1], v_i_temp);
       checker::SanityCheckItem(&k_i, v_i);
 
       const stock::key k_s(ol_supply_w_id, ol_i_id);
-      ALWAYS_ASSERT(tbl_stock(ol_supply_w_id)->get(txn, Encode(obj_key0, k_s), obj_v));
+      const int stock_idx = stock_batch_idx[ol_number - 1];
+      if (stock_idx < 0)
+        ALWAYS_ASSERT(tbl_stock(ol_supply_w_id)->get(txn, Encode(obj_key0, k_s), obj_v));
       stock::value v_s_temp;
-      const stock::value *v_s = Decode(obj_v, v_s_temp);
+      const stock::value *v_s = Decode(stock_idx < 0 ? obj_v : multi_v1[stock_idx], v_s_temp);
       checker::SanityCheckStock(&k_s, v_s);
 
       stock::value v_s_new(*v_s);
@@ -1925,24 +1977,35 @@ tpcc_worker::txn_stock_level()
       tbl_order_line(warehouse_id)->scan(txn, Encode(obj_key0, k_ol_0), &Encode(obj_key1, k_ol_1), c, s_arena.get());
     }
     {
+      // join NMaxMultiGetKeys items at a time, so their stock lookups overlap
       small_unordered_map<uint, bool, 512> s_i_ids_distinct;
-      for (auto &p : c.s_i_ids) {
+      uint i_ids[NMaxMultiGetKeys];
+      size_t n_i_ids = 0;
+      auto it = c.s_i_ids.begin();
+      while (it != c.s_i_ids.end()) {
         ANON_REGION("StockLevelLoopJoinIter:", &stock_level_probe1_cg);
 
         const size_t nbytesread = serializer<int16_t, true>::max_nbytes();
 
-        const stock::key k_s(warehouse_id, p.first);
-        INVARIANT(p.first >= 1 && p.first <= NumItems());
+        for (n_i_ids = 0; n_i_ids < NMaxMultiGetKeys && it != c.s_i_ids.end(); ++it) {
+          const stock::key k_s(warehouse_id, it->first);
+          INVARIANT(it->first >= 1 && it->first <= NumItems());
+          Encode(multi_keys[n_i_ids], k_s);
+          i_ids[n_i_ids++] = it->first;
+        }
         {
           ANON_REGION("StockLevelLoopJoinGet:", &stock_level_probe2_cg);
-          ALWAYS_ASSERT(tbl_stock(warehouse_id)->get(txn, Encode(obj_key0, k_s), obj_v, nbytesread));
+          tbl_stock(warehouse_id)->multi_get(txn, multi_keys, n_i_ids, multi_v0, multi_found, nbytesread);
+        }
+        for (size_t i = 0; i < n_i_ids; i++) {
+          ALWAYS_ASSERT(multi_found[i]);
+          INVARIANT(multi_v0[i].size() <= nbytesread);
+          const uint8_t *ptr = (const uint8_t *) multi_v0[i].data();
+          int16_t i16tmp;
+          ptr = serializer<int16_t, true>::read(ptr, &i16tmp);
+          if (i16tmp < int(threshold))
+            s_i_ids_distinct[i_ids[i]] = 1;
         }
-        INVARIANT(obj_v.size() <= nbytesread);
-        const uint8_t *ptr = (const uint8_t *) obj_v.data();
-        int16_t i16tmp;
-        ptr = serializer<int16_t, true>::read(ptr, &i16tmp);
-        if (i16tmp < int(threshold))
-          s_i_ids_distinct[p.first] = 1;
       }
       evt_avg_stock_level_loop_join_lookups.offer(c.s_i_ids.size());
       // NB(stephentu): s_i_ids_distinct.size() is the computed result of this txn
@@ -813,6 +813,46 @@ test_random_keys()
   ALWAYS_ASSERT(btr.size() == 0);
 }
 
+static void
+test_multi_search()
+{
+  testing_concurrent_btree btr;
+  fast_random r(7725321);
+
+  // variable length keys, so that some lookups descend several layers
+  const size_t nkeys = 10000;
+  set<string> keyset;
+  vector<string> keys;
+  for (size_t i = 0; i < nkeys; i++) {
+    string k = r.next_readable_string(r.next() % 40);
+    if (!keyset.insert(k).second)
+      continue;
+    keys.push_back(k);
+  }
+  for (size_t i = 0; i < keys.size(); i += 2)
+    btr.insert(varkey(keys[i]), (typename testing_concurrent_btree::value_type) keys[i].data());
+
+  // batches of every size, mixing present and absent keys
+  for (size_t base = 0, n = 1; base + n <= keys.size(); base += n, n = n % 50 + 1) {
+    vector<varkey> ks;
+    for (size_t i = base; i < base + n; i++)
+      ks.push_back(varkey(keys[i]));
+    vector<typename testing_concurrent_btree::value_type> vs(n, nullptr);
+    vector<typename testing_concurrent_btree::versioned_node_t> infos(n);
+    unique_ptr<bool[]> found(new bool[n]);
+    btr.multi_search(ks.data(), n, vs.data(), found.get(), infos.data());
+    for (size_t i = 0; i < n; i++) {
+      typename testing_concurrent_btree::value_type v = 0;
+      typename testing_concurrent_btree::versioned_node_t info;
+      ALWAYS_ASSERT(found[i] == btr.search(ks[i], v, &info));
+      ALWAYS_ASSERT(found[i] == ((base + i) % 2 == 0));
+      if (found[i])
+        ALWAYS_ASSERT(vs[i] == v);
+      ALWAYS_ASSERT(infos[i] == info);
+    }
+  }
+}
+
 static void
 test_insert_remove_mix()
 {
@@ -1984,6 +2024,7 @@ TestConcurrentBtreeFast()
   test_null_keys();
   test_null_keys_2();
   test_random_keys();
+  test_multi_search();
   test_insert_remove_mix();
   mp_test_pinning();
   mp_test_inserts_removes();
@@ -1238,6 +1238,27 @@ public:
     return search_impl(k, v, ns, search_info);
   }
 
+  // keys callers should pass to multi_search() at a time
+  static const size_t NMultiSearchGroup = 16;
+
+  /**
+   * Equivalent to calling search() on each of the n keys in ks; found[i] is
+   * what search() would return. Unlike mbtree, this does not interleave the
+   * lookups.
+   */
+  inline void
+  multi_search(const key_type *ks, size_t n, value_type *vs, bool *found,
+               versioned_node_t *search_infos = nullptr) const
+  {
+    rcu_region guard;
+    typename util::vec<leaf_node *>::type ns;
+    for (size_t i = 0; i < n; i++) {
+      ns.clear();
+      found[i] = search_impl(ks[i], vs[i], ns,
+                             search_infos ? &search_infos[i] : nullptr);
+    }
+  }
+
   /**
    * The low level callback interface is as follows:
    *
@@ -259,6 +259,20 @@ public:
   inline bool search(const key_type &k, value_type &v,
                      versioned_node_t *search_info = nullptr) const;
 
+  // keys looked up together by multi_search()
+  static const size_t NMultiSearchGroup = 16;
+
+  /**
+   * Equivalent to calling search() on each of the n keys in ks, but the
+   * descents of up to NMultiSearchGroup keys are interleaved level by level
+   * and prefetched first, so their cache misses overlap instead of each
+   * lookup stalling on its own. found[i] is set as search() would return;
+   * vs[i] and search_infos[i] (if not null) are set as search() would.
+   */
+  inline void multi_search(const key_type *ks, size_t n,
+                           value_type *vs, bool *found,
+                           versioned_node_t *search_infos = nullptr) const;
+
   /**
    * The low level callback interface is as follows:
    *
@@ -475,6 +489,7 @@ public:
   Masstree::basic_table<P> table_;
 
   static leaf_type* leftmost_descend_layer(node_base_type* n);
+  inline void prefetch_descents(const key_type *ks, size_t n) const;
   class size_walk_callback;
   template <bool Reverse> class search_range_scanner_base;
   template <bool Reverse> class low_level_search_range_scanner;
@@ -595,6 +610,63 @@ inline bool mbtree<P>::search(const key_type &k, value_type &v,
   return found;
 }
 
+/**
+ * Walks down to the first-layer leaf of each key, one level of all keys per
+ * round, prefetching the next node of each key. The walk takes no versions,
+ * so a concurrent split or a stale root only makes it prefetch the wrong
+ * node; multi_search() redoes every lookup with the usual checks.
+ */
+template <typename P>
+inline void mbtree<P>::prefetch_descents(const key_type *ks, size_t n) const
+{
+  INVARIANT(n <= NMultiSearchGroup);
+  const node_base_type *cur[NMultiSearchGroup];
+  const node_base_type *root = table_.root()->unsplit_ancestor();
+  root->prefetch_full();
+  for (size_t i = 0; i < n; i++)
+    cur[i] = root;
+
+  size_t live = n;
+  while (live) {
+    live = 0;
+    for (size_t i = 0; i < n; i++) {
+      const node_base_type *x = cur[i];
+      if (!x || x->isleaf())
+        continue;
+      const internode_type *in = static_cast<const internode_type *>(x);
+      typename node_base_type::key_type ka(
+          reinterpret_cast<const char *>(ks[i].data()), ks[i].length());
+      x = in->child_[internode_type::bound_type::upper(ka, *in)];
+      if (x) {
+        x->prefetch_full();
+        live++;
+      }
+      cur[i] = x;
+    }
+  }
+}
+
+template <typename P>
+inline void mbtree<P>::multi_search(const key_type *ks, size_t n,
+                                    value_type *vs, bool *found,
+                                    versioned_node_t *search_infos) const
+{
+  rcu_region guard;
+  threadinfo ti;
+  for (size_t base = 0; base < n; base += NMultiSearchGroup) {
+    const size_t end = std::min(n, base + NMultiSearchGroup);
+    prefetch_descents(ks + base, end - base);
+    for (size_t i = base; i < end; i++) {
+      Masstree::unlocked_tcursor<P> lp(table_, ks[i].data(), ks[i].length());
+      found[i] = lp.find_unlocked(ti);
+      if (found[i])
+        vs[i] = lp.value();
+      if (search_infos)
+        search_infos[i] = versioned_node_t(lp.node(), lp.full_version_value());
+    }
+  }
+}
+
 template <typename P>
 inline bool mbtree<P>::insert(const key_type &k, value_type v,
                               value_type *old_v,
@@ -261,6 +261,14 @@ public:
   // CPU-specific
   void pin_current_thread(size_t cpu);
 
+  // returns the CPU the current thread was pinned to, or -1 if the thread
+  // was never pinned
+  inline ssize_t
+  pinned_cpu()
+  {
+    return mysync().get_pin_cpu();
+  }
+
   void fault_region();
 
   static rcu s_instance CACHE_ALIGNED; // system wide instance
@@ -311,6 +311,22 @@ public:
     return this->do_search(t, k, r);
   }
 
+  // looks up the n keys in ks together; equivalent to calling search() on
+  // each, with found[i] set to its result and vs[i] to its value
+  template <typename Traits>
+  inline void
+  multi_search(Transaction<Traits> &t,
+               const key_type *ks,
+               size_t n,
+               value_type *vs,
+               bool *found,
+               size_type max_bytes_read = string_type::npos)
+  {
+    this->do_multi_search(t, ks, n, found, [vs, max_bytes_read](size_t i) {
+      return single_value_reader_type(&vs[i], max_bytes_read);
+    });
+  }
+
   template <typename Traits>
   inline void
   search_range_call(Transaction<Traits> &t,
@@ -4,7 +4,9 @@
 #include <unistd.h>
 #include <sys/uio.h>
 #include <limits.h>
+#include <sched.h>
 #include <numa.h>
+#include <map>
 
 #include "txn_proto2_impl.h"
 #include "counter.h"
@@ -19,6 +21,7 @@ bool txn_logger::g_persist = false;
 bool txn_logger::g_call_fsync = true;
 bool txn_logger::g_use_compression = false;
 bool txn_logger::g_fake_writes = false;
+bool txn_logger::g_pin_loggers_to_numa_nodes = false;
 size_t txn_logger::g_nworkers = 0;
 txn_logger::epoch_array
   txn_logger::per_thread_sync_epochs_[txn_logger::g_nmax_loggers];
@@ -52,6 +55,15 @@ event_avg_counter
 static event_avg_counter
   evt_avg_log_buffer_iov_len("avg_log_buffer_iov_len");
 
+// worker i runs on cpu i (modulo the number of cpus), see
+// rcu::pin_current_thread()
+static int
+worker_numa_node(unsigned worker)
+{
+  const int node = numa_node_of_cpu(worker % coreid::num_cpus_online());
+  return node < 0 ? 0 : node;
+}
+
 void
 txn_logger::Init(
     size_t nworkers,
@@ -60,7 +72,8 @@ txn_logger::Init(
     vector<vector<unsigned>> *assignments_used,
     bool call_fsync,
     bool use_compression,
-    bool fake_writes)
+    bool fake_writes,
+    bool numa_aware)
 {
   INVARIANT(!g_persist);
   INVARIANT(g_nworkers == 0);
@@ -87,10 +100,32 @@ txn_logger::Init(
     for (size_t j = 0; j < g_nworkers; j++)
       per_thread_sync_epochs_[i].epochs_[j].store(0, memory_order_release);
 
+  if (numa_aware && numa_available() == -1) {
+    cerr << "[WARNING] NUMA-aware logging requested, but libnuma is unavailable"
+         << endl;
+    numa_aware = false;
+  }
+  g_pin_loggers_to_numa_nodes = numa_aware;
+
   vector<thread> writers;
   vector<vector<unsigned>> assignments(assignments_given);
-
-  if (assignments.empty()) {
+  vector<int> logger_nodes;
+
+  if (assignments.empty() && numa_aware) {
+    assignments = ComputeNumaAssignments(fds.size(), g_nworkers, logger_nodes);
+  } else if (numa_aware) {
+    // explicit assignment: run each logger where most of its workers are
+    for (auto &assignment : assignments) {
+      map<int, size_t> counts;
+      for (auto w : assignment)
+        counts[worker_numa_node(w)]++;
+      int best = -1;
+      for (auto &p : counts)
+        if (best == -1 || p.second > counts[best])
+          best = p.first;
+      logger_nodes.push_back(best);
+    }
+  } else if (assignments.empty()) {
     // compute assuming homogenous disks
     if (g_nworkers <= fds.size()) {
       // each thread gets its own logging worker
@@ -114,7 +149,8 @@ txn_logger::Init(
   for (size_t i = 0; i < assignments.size(); i++) {
     writers.emplace_back(
         &txn_logger::writer,
-        i, fds[i], assignments[i]);
+        i, fds[i], logger_nodes.empty() ? -1 : logger_nodes[i],
+        assignments[i]);
     writers.back().detach();
   }
 
@@ -125,6 +161,71 @@ txn_logger::Init(
     *assignments_used = assignments;
 }
 
+vector<vector<unsigned>>
+txn_logger::ComputeNumaAssignments(
+    unsigned nfds,
+    unsigned nworkers,
+    vector<int> &logger_nodes)
+{
+  INVARIANT(nfds > 0);
+  map<int, vector<unsigned>> workers_by_node;
+  for (unsigned w = 0; w < nworkers; w++)
+    workers_by_node[worker_numa_node(w)].push_back(w);
+
+  vector<vector<unsigned>> assignments;
+  logger_nodes.clear();
+  const size_t nnodes = workers_by_node.size();
+
+  if (nfds < nnodes) {
+    // not enough loggers to go around- nodes have to share, so some
+    // cross-node traffic is unavoidable
+    cerr << "[WARNING] only " << nfds << " logfiles for workers on "
+         << nnodes << " NUMA nodes" << endl;
+    assignments.resize(nfds);
+    size_t i = 0;
+    for (auto &p : workers_by_node) {
+      if (i < nfds)
+        logger_nodes.push_back(p.first);
+      auto &assignment = assignments[i % nfds];
+      assignment.insert(assignment.end(), p.second.begin(), p.second.end());
+      i++;
+    }
+    return assignments;
+  }
+
+  // each node gets an equal share of the loggers (never more loggers than
+  // workers), and splits its workers evenly among them
+  size_t n = 0;
+  for (auto &p : workers_by_node) {
+    const vector<unsigned> &workers = p.second;
+    const size_t nloggers = min(
+        workers.size(), nfds / nnodes + (n < (nfds % nnodes) ? 1 : 0));
+    const size_t workers_per_logger = workers.size() / nloggers;
+    for (size_t i = 0; i < nloggers; i++) {
+      const size_t b = i * workers_per_logger;
+      const size_t e =
+        ((i + 1) == nloggers) ? workers.size() : (i + 1) * workers_per_logger;
+      assignments.emplace_back(workers.begin() + b, workers.begin() + e);
+      logger_nodes.push_back(p.first);
+    }
+    n++;
+  }
+  return assignments;
+}
+
+void *
+txn_logger::alloc_node_local(size_t sz)
+{
+  // pinned threads already get node-local memory from the numa allocator;
+  // only unpinned ones need libnuma to bind the buffers to their node
+  if (rcu::s_instance.pinned_cpu() != -1)
+    return rcu::s_instance.alloc_static(sz);
+  const int node = numa_node_of_cpu(sched_getcpu());
+  void * const px = numa_alloc_onnode(sz, node < 0 ? 0 : node);
+  ALWAYS_ASSERT(px);
+  return px;
+}
+
 void
 txn_logger::persister(
     vector<vector<unsigned>> assignments)
@@ -222,12 +323,12 @@ txn_logger::advance_system_sync_epoch(
 
 void
 txn_logger::writer(
-    unsigned id, int fd,
+    unsigned id, int fd, int node,
     vector<unsigned> assignment)
 {
 
-  if (g_pin_loggers_to_numa_nodes) {
-    ALWAYS_ASSERT(!numa_run_on_node(id % numa_num_configured_nodes()));
+  if (node >= 0) {
+    ALWAYS_ASSERT(!numa_run_on_node(node));
     ALWAYS_ASSERT(!sched_yield());
   }
 
@@ -37,7 +37,6 @@ public:
   static const size_t g_buffer_size = (1<<20); // in bytes
   static const size_t g_horizon_buffer_size = 2 * (1<<16); // in bytes
   static const size_t g_max_lag_epochs = 128; // cannot lag more than 128 epochs
-  static const bool   g_pin_loggers_to_numa_nodes = false;
 
   static inline bool
   IsPersistenceEnabled()
@@ -51,10 +50,21 @@ public:
     return g_use_compression;
   }
 
+  static inline bool
+  IsNumaAware()
+  {
+    return g_pin_loggers_to_numa_nodes;
+  }
+
   // init the logging subsystem.
   //
   // should only be called ONCE is not thread-safe.  if assignments_used is not
   // null, then fills it with a copy of the assignment actually computed
+  //
+  // if numa_aware is set, loggers are pinned to the NUMA node of the workers
+  // they serve, and log buffers are allocated from node-local memory. when
+  // assignments_given is empty, the assignment is computed from the machine
+  // topology so that each worker only talks to a logger on its own node
   static void Init(
       size_t nworkers,
       const std::vector<std::string> &logfiles,
@@ -62,7 +72,8 @@ public:
       std::vector<std::vector<unsigned>> *assignments_used = nullptr,
       bool call_fsync = true,
       bool use_compression = false,
-      bool fake_writes = false);
+      bool fake_writes = false,
+      bool numa_aware = false);
 
   struct logbuf_header {
     uint64_t nentries_; // > 0 for all valid log buffers
@@ -178,6 +189,16 @@ public:
     return seen.size() == nworkers;
   }
 
+  // computes a worker => logger assignment from the NUMA topology. workers
+  // are assumed to run on the cpu matching their id (see
+  // rcu::pin_current_thread()), and are grouped by the node of that cpu. each
+  // node gets its share of the nfds loggers; logger_nodes is filled with the
+  // node each logger should be pinned to
+  static std::vector<std::vector<unsigned>>
+  ComputeNumaAssignments(unsigned nfds,
+                         unsigned nworkers,
+                         std::vector<int> &logger_nodes);
+
   typedef circbuf<pbuffer, g_perthread_buffers> pbuffer_circbuf;
 
   static std::tuple<uint64_t, uint64_t, double>
@@ -255,9 +276,10 @@ private:
   advance_system_sync_epoch(
       const std::vector<std::vector<unsigned>> &assignments);
 
-  // makes copy on purpose
+  // makes copy on purpose. if node >= 0, the writer pins itself to
+  // that NUMA node before doing any IO
   static void writer(
-      unsigned id, int fd,
+      unsigned id, int fd, int node,
       std::vector<unsigned> assignment);
 
   static void persister(
@@ -267,8 +289,15 @@ private:
     INITMODE_NONE, // no initialization
     INITMODE_REG,  // just use malloc() to init buffers
     INITMODE_RCU,  // try to use the RCU numa aware allocator
+    INITMODE_NUMA, // allocate from the calling thread's NUMA node
   };
 
+  // returns sz bytes of memory local to the calling thread's NUMA node. same
+  // as rcu::alloc_static() for pinned threads; unpinned threads get memory
+  // bound to the node they run on with libnuma, where alloc_static() would
+  // fall back to malloc(). the memory is never freed (like log buffers)
+  static void *alloc_node_local(size_t sz);
+
   static inline persist_ctx &
   persist_ctx_for(uint64_t core_id, InitMode imode)
   {
@@ -282,6 +311,8 @@ private:
       char *mem =
         (imode == INITMODE_REG) ?
           (char *) malloc(needed) :
+        (imode == INITMODE_NUMA) ?
+          (char *) alloc_node_local(needed) :
           (char *) rcu::s_instance.alloc_static(needed);
       if (IsCompressionEnabled()) {
         ctx.lz4ctx_ = mem;
@@ -310,6 +341,9 @@ private:
   static bool g_fake_writes; // whether or not to fake doing writes (to measure
                              // pure overhead of disk)
 
+  static bool g_pin_loggers_to_numa_nodes; // whether or not loggers and their
+                                           // buffers are placed by NUMA node
+
   static size_t g_nworkers; // assignments are computed based on g_nworkers
                             // but a logger responsible for core i is really
                             // responsible for cores i + k * g_nworkers, for k
@@ -1209,7 +1243,9 @@ struct txn_epoch_sync<transaction_proto2> : public transaction_proto2_static {
     // try to initialize using numa allocator
     txn_logger::persist_ctx_for(
         my_core_id,
-        loader ? txn_logger::INITMODE_REG : txn_logger::INITMODE_RCU);
+        loader ? txn_logger::INITMODE_REG :
+          (txn_logger::IsNumaAware() ? txn_logger::INITMODE_NUMA :
+                                       txn_logger::INITMODE_RCU));
   }
   static void
   thread_end()
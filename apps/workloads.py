@@ -28,6 +28,7 @@ import subprocess
 import psutil
 import time
 import sys, os
+import select
 import logging
 import math
 from decimal import Decimal
@@ -41,6 +42,47 @@ sys.path.append(os.path.join(os.getcwd(), "../profiler"))
 from workload_base import Workload
 from harness import profile_threads
 
+def reset_thread_registry(registry):
+    """Removes a thread registry left over from a previous run and creates the
+    FIFO the server signals once it has published the new one. Call before
+    launching the server."""
+    for path in [registry, registry + ".tmp", registry + ".ready"]:
+        if os.path.exists(path):
+            os.remove(path)
+    os.mkfifo(registry + ".ready")
+    # The server may drop privileges before its threads register
+    os.chmod(registry + ".ready", 0o666)
+
+def wait_for_threads(registry, proc, logger):
+    """Blocks until the server publishes its thread registry, i.e., a
+    "role index tid core" line per thread, and returns the distinct tids in
+    it. Sleeps on the .ready FIFO instead of polling the filesystem."""
+    fifo = os.open(registry + ".ready", os.O_RDONLY | os.O_NONBLOCK)
+    try:
+        while not os.path.exists(registry):
+            if proc.poll() is not None:
+                logger.error("Server exited before registering its threads")
+                sys.exit(1)
+            select.select([fifo], [], [], 1.0)
+    finally:
+        os.close(fifo)
+
+    tids = []
+    with open(registry) as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) != 4:
+                continue
+            logger.info("Server thread: {}".format(line.strip()))
+            if fields[2] not in tids:
+                tids.append(fields[2])
+    return tids
+
+def remove_thread_registry(registry):
+    for path in [registry, registry + ".ready"]:
+        if os.path.exists(path):
+            os.remove(path)
+
 """
     Implementations of different workloads
     Currently implemented: Memcached, Silo, Xapian, Dnn-As-A-Service
@@ -48,11 +90,10 @@ from harness import profile_threads
 class DnnWorkload(Workload):
 
     def run(self, params, header):
-        server_tidfile = os.path.join(self.scratch_dir, "tbench_server_tid.txt")
-
-        # Clean up the worker thread id file possibly left from previous run.
-        if os.path.exists(server_tidfile):
-            os.remove(server_tidfile)
+        # The server publishes its request threads and the intra-op and
+        # inter-op threads that actually run the model here
+        registry = os.path.join(self.scratch_dir, "tbench_server_threads.txt")
+        reset_thread_registry(registry)
 
         # First, create model and serialize
         cmd = [# Need to run the venv python
@@ -79,7 +120,7 @@ class DnnWorkload(Workload):
         dnn_env['TBENCH_WARMUPREQS'] = "100"
         dnn_env['TBENCH_MINSLEEPNS'] = "1000"
         dnn_env['OMP_NUM_THREADS'] = "4" # Limit to 4 threads
-        dnn_cmd = [self.server_bin, '-r', '10000000',
+        dnn_cmd = [self.server_bin, '-r', '10000000', '-i', '4',
             '-m', os.path.join(self.scratch_dir, 'custom_model.pt')]
         self.logger.info(subprocess.list2cmdline(dnn_cmd))
 
@@ -87,9 +128,7 @@ class DnnWorkload(Workload):
         with open(os.path.join(self.results_dir, "server.pid"), "w") as s:
             s.write("{}".format(dnn.pid))
 
-        while not os.path.exists(server_tidfile):
-            # Wait for worker thread to start up
-            pass
+        self.profiled_tids = wait_for_threads(registry, dnn, self.logger)
 
         # Important: profile AFTER server has started up its threads!
         # needed so that partthyme doesn't pin all of the child threads to the
@@ -99,20 +138,6 @@ class DnnWorkload(Workload):
         dnn_psutil = psutil.Process(dnn.pid)
         dnn_psutil.cpu_affinity([0, 1, 2, 3, 4, 5, 6, 7])
 
-        self.profiled_tids = []
-        with open(server_tidfile) as f:
-            pid = int(f.readline().strip())
-            self.profiled_tids.append(str(pid))
-            # Discover all worker threads and profile them
-            # FIXME: Does not work properly since partthyme sometimes does
-            # not correctly detach from multiple threads
-            #dnn_psutil_proc = psutil.Process(pid)
-            #with dnn_psutil_proc.oneshot(): # Purely performance boost
-            #    dnn_threads = dnn_psutil_proc.threads()
-            #    for thr in dnn_threads:
-            #        if str(thr.id) not in self.profiled_tids:
-            #            self.profiled_tids.append(str(thr.id))
-
         self.logger.info("Profiling threads: {}".format(self.profiled_tids))
 
         # Start profiling
@@ -131,7 +156,7 @@ class DnnWorkload(Workload):
         dnn.kill()
         dnn.wait()
         os.remove(os.path.join(os.path.join(self.results_dir, "server.pid")))
-        os.remove(server_tidfile)
+        remove_thread_registry(registry)
 
         if received_sigint:
             self.logger.info("Received SIGINT, exiting...")
@@ -140,11 +165,8 @@ class DnnWorkload(Workload):
 class XapianWorkload(Workload):
 
     def run(self, params, header):
-        server_tidfile = os.path.join(self.scratch_dir, "tbench_server_tid.txt")
-
-        # Clean up the worker thread id file possibly left from previous run.
-        if os.path.exists(server_tidfile):
-            os.remove(server_tidfile)
+        registry = os.path.join(self.scratch_dir, "tbench_server_threads.txt")
+        reset_thread_registry(registry)
 
         qps = params['qps']
         skew = params['skew']
@@ -181,14 +203,7 @@ class XapianWorkload(Workload):
         with open(os.path.join(self.results_dir, "server.pid"), "w") as s:
             s.write("{}".format(xapian.pid))
 
-        while not os.path.exists(server_tidfile):
-            # Wait for worker thread to start up
-            pass
-
-        time.sleep(1)
-        self.profiled_tids = []
-        with open(server_tidfile) as f:
-            self.profiled_tids.append(f.readline().strip())
+        self.profiled_tids = wait_for_threads(registry, xapian, self.logger)
 
         # Start profiling
         self.rawdata_dir = os.path.join(self.results_dir, "rawdata")
@@ -206,7 +221,7 @@ class XapianWorkload(Workload):
         xapian.kill()
         xapian.wait()
         os.remove(os.path.join(os.path.join(self.results_dir, "server.pid")))
-        os.remove(server_tidfile)
+        remove_thread_registry(registry)
 
         if received_sigint:
             self.logger.info("Received SIGINT, exiting...")
@@ -215,7 +230,7 @@ class XapianWorkload(Workload):
 class SiloWorkload(Workload):
 
     def run(self, params, header):
-        server_tidfile = os.path.join(self.scratch_dir, "tbench_server_tid.txt")
+        registry = os.path.join(self.scratch_dir, "tbench_server_threads.txt")
 
         # Convert the input parameters into arguments to pass to silo integrated harness.
         # The Tailbench harness accepts arguments via environment variables instead of command-line.
@@ -243,9 +258,7 @@ class SiloWorkload(Workload):
         silo_env['FQ_ORDERSTATUS'] = str(fq_orderstatus)
         silo_env['FQ_STOCKLEVEL'] = str(fq_stocklevel)
 
-        # Clean up the worker thread id file possibly left from previous run.
-        if os.path.exists(server_tidfile):
-            os.remove(server_tidfile)
+        reset_thread_registry(registry)
 
         silo_cmd = ['numactl', '-C', '3,4,5,6,7,11,12,13,14,15',
             self.server_bin, '--bench', 'tpcc',
@@ -259,14 +272,7 @@ class SiloWorkload(Workload):
         with open(os.path.join(self.results_dir, "server.pid"), "w") as s:
             s.write("{}".format(silo.pid))
 
-        while not os.path.exists(server_tidfile):
-            # Wait for worker thread to start up
-            pass
-
-        time.sleep(1)
-        self.profiled_tids = []
-        with open(server_tidfile) as f:
-            self.profiled_tids.append(f.readline().strip())
+        self.profiled_tids = wait_for_threads(registry, silo, self.logger)
 
         # Start profiling
         self.rawdata_dir = os.path.join(self.results_dir, "rawdata")
@@ -284,7 +290,7 @@ class SiloWorkload(Workload):
         silo.kill()
         silo.wait()
         os.remove(os.path.join(os.path.join(self.results_dir, "server.pid")))
-        os.remove(server_tidfile)
+        remove_thread_registry(registry)
 
         if received_sigint:
             self.logger.info("Received SIGINT, exiting...")
@@ -307,7 +313,7 @@ class MemcachedWorkload(Workload):
 
     def run(self, params, header):
 
-        server_tidfile = os.path.join(self.scratch_dir, "memcached_worker.tid")
+        registry = os.path.join(self.scratch_dir, "memcached_worker_threads.txt")
 
         # Convert the input parameters to arguments to pass to the mutilate (load-generator) client
         # Use fixed point since mutilate has a limited size buffer for string inputs
@@ -339,9 +345,7 @@ class MemcachedWorkload(Workload):
         # We fix to 1M records for memcached.
         num_records = 1000000
 
-        # Clean up the worker thread id file possibly left from previous run.
-        if os.path.exists(server_tidfile):
-            os.remove(server_tidfile)
+        reset_thread_registry(registry)
 
         # Bind to NUMA node 0
         memcached_env = os.environ.copy()
@@ -359,14 +363,7 @@ class MemcachedWorkload(Workload):
         with open(os.path.join(self.results_dir, "server.pid"), "w") as s:
             s.write("{}".format(memcached_pid))
 
-        while not os.path.exists(server_tidfile):
-            # Wait for worker thread to start up
-            pass
-
-        time.sleep(1)
-        self.profiled_tids = []
-        with open(server_tidfile) as f:
-            self.profiled_tids.append(f.readline().strip())
+        self.profiled_tids = wait_for_threads(registry, memcached, self.logger)
 
         # First run is just to load the records
         mutilate_path = self.client_bin
@@ -426,6 +423,7 @@ class MemcachedWorkload(Workload):
         memcached.kill()
         memcached.wait()
         os.remove(os.path.join(os.path.join(self.results_dir, "server.pid")))
+        remove_thread_registry(registry)
         time.sleep(1)
 
         if received_sigint:
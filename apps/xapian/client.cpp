@@ -1,6 +1,9 @@
 #include "getopt.h"
 #include "genzipf.h"
+#include "msgs.h"
+#include "searchreq.h"
 #include "tbench_client.h"
+#include "termtable.h"
 
 #include <unistd.h>
 
@@ -18,17 +21,18 @@
 class TermSet {
     private:
         pthread_mutex_t lock;
-        std::vector<std::pair<int, std::string>> terms;
+        TermTable terms;
         double skew;
         bool isUniform;
         ZipfSampler zs;
         std::default_random_engine randEngine;
         std::uniform_int_distribution<unsigned long> termGen;
-    public:
-        TermSet(std::string termsFile, double skew) : skew(skew) {
-            pthread_mutex_init(&lock, NULL);
-            isUniform = skew == 0 ? true : false;
 
+        // Terms are copied into a request buffer as-is
+        static const size_t maxTermLen = MAX_REQ_BYTES - sizeof(SearchReq) - 1;
+
+        // Parses a CSV terms file (term,freq per line) into a table
+        void loadCSV(std::string termsFile) {
             std::ifstream fin(termsFile);
             if (fin.fail()) {
                 std::cerr << "Error opening terms file " << termsFile << std::endl;
@@ -37,6 +41,7 @@ class TermSet {
 
             const unsigned MAX_TERM_LEN = 128;
             const unsigned MAX_DIGITS = 24;
+            std::vector<std::pair<int, std::string>> csvTerms;
             std::string term, freq;
             unsigned long termCount = 0;
             while (true) {
@@ -55,16 +60,52 @@ class TermSet {
 
                 ++termCount;
 
-                terms.push_back(std::make_pair(std::stoi(freq), term));
+                csvTerms.push_back(std::make_pair(std::stoi(freq), term));
                 if (fin.eof()) break;
             }
 
             fin.close();
-            std::sort(terms.begin(), terms.end(),
+            std::stable_sort(csvTerms.begin(), csvTerms.end(),
                 [] (const std::pair<int, std::string>& lhs, const std::pair<int, std::string>& rhs) {
                     return lhs.first > rhs.first;
                 });
-            zs.setParams((unsigned long)termCount, skew);
+
+            std::vector<std::string> sorted;
+            sorted.reserve(csvTerms.size());
+            for (auto& t : csvTerms) sorted.push_back(std::move(t.second));
+            terms.build(sorted);
+        }
+
+    public:
+        TermSet(std::string termsFile, double skew) : skew(skew) {
+            pthread_mutex_init(&lock, NULL);
+            isUniform = skew == 0 ? true : false;
+
+            // Prebuilt binary tables (see genTerms -b) are mapped as-is
+            if (TermTable::isTermTable(termsFile)) {
+                if (!terms.open(termsFile)) {
+                    std::cerr << "Error mapping terms table " << termsFile << std::endl;
+                    exit(-1);
+                }
+            } else {
+                loadCSV(termsFile);
+            }
+
+            // Sampled terms are checked as they are used (see getTerm()); a
+            // full scan up front is opt-in, since it costs O(numTerms)
+            if (getOpt<int>("TBENCH_CHECK_TERMS", 0) &&
+                    !terms.check(maxTermLen)) {
+                std::cerr << "Terms table " << termsFile << " is corrupt or has"
+                    " terms longer than " << maxTermLen << " bytes" << std::endl;
+                exit(-1);
+            }
+
+            unsigned long termCount = terms.numTerms();
+            if (termCount == 0) {
+                std::cerr << "No terms in " << termsFile << std::endl;
+                exit(-1);
+            }
+            zs.setParams(termCount, skew);
             termGen = std::uniform_int_distribution<unsigned long>(0, \
                     termCount - 1);
         }
@@ -75,11 +116,18 @@ class TermSet {
 
         void releaseLock() { pthread_mutex_unlock(&lock); }
 
-        const std::string& getTerm() {
+        // Returns a NUL-terminated term and sets len to its length
+        const char* getTerm(size_t& len) {
             acquireLock();
             unsigned long idx = isUniform ? termGen(randEngine) : zs.getSample() - 1;
             releaseLock();
-            return terms[idx].second;
+            if (!terms.termOk(idx, maxTermLen)) {
+                std::cerr << "Term #" << idx << " of the terms table is corrupt"
+                    " or longer than " << maxTermLen << " bytes" << std::endl;
+                exit(-1);
+            }
+            len = terms.termLen(idx);
+            return terms.term(idx);
         }
 };
 
@@ -87,6 +135,8 @@ class TermSet {
  * Global Data
  *******************************************************************************/
 TermSet* termSet = nullptr;
+uint32_t pageSize = DEFAULT_PAGE_SIZE;
+uint32_t msetDepth = DEFAULT_MSET_DEPTH;
 
 /*******************************************************************************
  * Liblat API
@@ -95,14 +145,22 @@ void tBenchClientInit() {
     std::string termsFile = getOpt<std::string>("TBENCH_TERMS_FILE", "terms.in");
     double skew = getOpt<double>("TBENCH_ZIPF_SKEW", 2.0);
     termSet = new TermSet(termsFile, skew);
+
+    // Results returned per query, and how deep Xapian ranks (0 = only the
+    // returned page)
+    pageSize = getOpt<uint32_t>("TBENCH_PAGE_SIZE", DEFAULT_PAGE_SIZE);
+    msetDepth = getOpt<uint32_t>("TBENCH_MSET_DEPTH", DEFAULT_MSET_DEPTH);
 }
 
 size_t tBenchClientGenReq(void* data) {
     // I could modify the search term distribution here.
-    std::string term = termSet->getTerm();
-    size_t len = term.size();
+    size_t len;
+    const char* term = termSet->getTerm(len);
 
-    memcpy(data, reinterpret_cast<const void*>(term.c_str()), len + 1);
+    SearchReq* req = reinterpret_cast<SearchReq*>(data);
+    req->pageSize = pageSize;
+    req->msetDepth = msetDepth;
+    memcpy(req->term, term, len + 1);
 
-    return len + 1;
+    return sizeof(SearchReq) + len + 1;
 }
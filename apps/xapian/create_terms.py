@@ -11,7 +11,6 @@
 
 import os
 import sys
-import time
 import subprocess
 
 if not len(sys.argv) == 4:
@@ -21,21 +20,17 @@ if not os.path.exists(sys.argv[3]):
     print("Creating directories recursively up to {}".format(sys.argv[2]))
     os.makedirs(sys.argv[3])
 
-processes = []
+# Index document frequencies of all terms once (on the first run), then
+# slice the index for every other upper limit with a binary search
+index_path = os.path.join(sys.argv[3], "terms.idx")
 ll = 100
 for ul in range(100, 10001, 100):
     if ll < ul:
         cmd = [
-            sys.argv[1], "-d",
-            sys.argv[2],
+            sys.argv[1], "-i", index_path,
             "-f",
             "{}/terms_ul{}.in".format(sys.argv[3], ul),
             "-u", str(ul), "-l", str(ll)]
-        processes.append(subprocess.Popen(cmd))
-        time.sleep(0.1)
-
-    # Don't go too crazy here.
-    if len(processes) >= 10:
-        processes[0].wait()
-        processes.pop(0)
-
+        if not os.path.exists(index_path):
+            cmd += ["-d", sys.argv[2]]
+        subprocess.check_call(cmd)
@@ -0,0 +1,134 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dbstage.h"
+
+using namespace std;
+
+static string realPath(const string& path) {
+    char* p = realpath(path.c_str(), NULL);
+    if (!p) return "";
+    string r(p);
+    free(p);
+    return r;
+}
+
+// Whether path is dir or lies below it (both must be canonical)
+static bool isWithin(const string& path, const string& dir) {
+    if (path == dir) return true;
+    string prefix = (dir == "/") ? dir : dir + "/";
+    return path.compare(0, prefix.size(), prefix) == 0;
+}
+
+StagedDatabase::StagedDatabase(const string& dbPath, const string& stageDir) {
+    // Staging into (or next to the contents of) the database itself would
+    // clobber the tables it copies from
+    string dbReal = realPath(dbPath);
+    if (dbReal.empty()) die("cannot resolve", dbPath);
+    string stageReal = realPath(stageDir);
+    if (stageReal.empty()) die("cannot resolve", stageDir);
+    if (isWithin(stageReal, dbReal) || isWithin(dbReal, stageReal)) {
+        cerr << "StagedDatabase: stage directory " << stageDir
+            << " must not be, contain or lie inside the database "
+            << dbPath << endl;
+        exit(-1);
+    }
+
+    DIR* dir = opendir(dbPath.c_str());
+    if (!dir) die("cannot open database", dbPath);
+
+    string base = dbReal.substr(dbReal.rfind('/') + 1);
+    string tmpl = stageReal + "/" + base + ".XXXXXX";
+    if (!mkdtemp(&tmpl[0])) die("cannot create a directory in", stageReal);
+    stagedPath = tmpl;
+
+    size_t totalBytes = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        string src = dbPath + "/" + ent->d_name;
+        struct stat st;
+        if (stat(src.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) continue;
+
+        string dst = stagedPath + "/" + ent->d_name;
+        stageFile(src, dst);
+        totalBytes += st.st_size;
+    }
+    closedir(dir);
+
+    cerr << "Staged " << totalBytes << " bytes of " << dbPath << " into "
+        << stagedPath << endl;
+}
+
+void StagedDatabase::stageFile(const string& src, const string& dst) {
+    int in = open(src.c_str(), O_RDONLY);
+    if (in < 0) die("cannot open", src);
+
+    struct stat st;
+    if (fstat(in, &st) != 0) die("cannot stat", src);
+    size_t size = st.st_size;
+
+    int out = open(dst.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (out < 0) die("cannot create", dst);
+    files.push_back(dst);
+
+    if (size == 0) {
+        close(in);
+        close(out);
+        return;
+    }
+
+    if (ftruncate(out, size) != 0) die("cannot resize", dst);
+
+    // Fault the table in through a hugepage-advised mapping, so the backing
+    // shmem pages are allocated as huge pages where the filesystem allows it
+    void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, out, 0);
+    if (addr == MAP_FAILED) die("cannot map", dst);
+    if (madvise(addr, size, MADV_HUGEPAGE) != 0)
+        cerr << "StagedDatabase: MADV_HUGEPAGE not supported for " << dst << endl;
+
+    char* p = static_cast<char*>(addr);
+    size_t off = 0;
+    while (off < size) {
+        ssize_t n = read(in, p + off, size - off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) die("cannot read", src);
+        off += n;
+    }
+
+    if (mlock(addr, size) != 0)
+        cerr << "StagedDatabase: cannot mlock " << dst
+            << " (check RLIMIT_MEMLOCK)" << endl;
+
+    mappings.push_back(make_pair(addr, size));
+    close(in);
+    close(out);
+}
+
+// Doesn't return. Removes whatever was staged so far, so a failed run
+// doesn't leave part of a database behind in memory.
+void StagedDatabase::die(const string& what, const string& path) {
+    cerr << "StagedDatabase: " << what << " " << path << ": "
+        << strerror(errno) << endl;
+    cleanup();
+    exit(-1);
+}
+
+void StagedDatabase::cleanup() {
+    for (auto& m : mappings) munmap(m.first, m.second);
+    mappings.clear();
+    for (auto& f : files) unlink(f.c_str());
+    files.clear();
+    if (!stagedPath.empty()) rmdir(stagedPath.c_str());
+}
+
+StagedDatabase::~StagedDatabase() {
+    cleanup();
+}
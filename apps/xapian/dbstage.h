@@ -0,0 +1,35 @@
+#ifndef __DBSTAGE_H
+#define __DBSTAGE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Copies an on-disk Xapian database into stageDir, which should be on a
+// memory-backed filesystem (e.g., a tmpfs mounted with huge=advise). Every
+// table is written through a shared mapping advised with MADV_HUGEPAGE and
+// kept mlock'ed for the lifetime of the object, so the block reads Xapian
+// issues during a run are served from resident, hugepage-backed memory
+// instead of faulting in 4KB page-cache pages from disk.
+//
+// The copy goes into a fresh directory created under stageDir, which must not
+// overlap the database, and only the files copied there are removed at
+// destruction, or when staging fails partway.
+class StagedDatabase {
+    private:
+        std::string stagedPath;
+        std::vector<std::pair<void*, size_t>> mappings;
+        std::vector<std::string> files;
+
+        void stageFile(const std::string& src, const std::string& dst);
+        void die(const std::string& what, const std::string& path);
+        void cleanup();
+
+    public:
+        StagedDatabase(const std::string& dbPath, const std::string& stageDir);
+        ~StagedDatabase();
+
+        const std::string& path() const { return stagedPath; }
+};
+
+#endif // __DBSTAGE_H
@@ -5,25 +5,111 @@
 #include <sstream>
 #include <iostream>
 #include <fstream>
+#include <vector>
+
+#include "termindex.h"
+#include "termtable.h"
 
 using namespace std;
 
 void usage() {
-    cout << "Usage: genterms -d db [ -f termsFile -u upperlimit -l lowerlimit -r]" << endl;
+    cout << "Usage: genterms (-d db [-i indexFile] | -i indexFile)" << endl
+         << "                [-f termsFile -l lowerlimit -u upperlimit | -r -o outDir] [-b]" << endl
+         << "  -d builds a term index from db in one pass (saved to -i if given)" << endl
+         << "  -i without -d loads a previously built index" << endl
+         << "  -b writes binary term tables the client can mmap instead of CSV" << endl;
     exit(-1);
 }
 
+// A query for a lowercase word is parsed with STEM_SOME into the stemmed "Z"
+// term, so the number of documents it matches is that term's frequency. This
+// gives the same counts as running get_mset() per term, in a single pass.
+void buildIndex(const char* dbPath, vector<IndexedTerm>& terms) {
+    Xapian::Database db;
+    try {
+        db.add_database(Xapian::Database(dbPath));
+    }
+    catch (const Xapian::Error& e) {
+        cerr << "Error opening database: " << e.get_msg() << endl;
+        usage();
+    }
+
+    Xapian::Stem stemmer("english");
+    string lowercase = "abcdefghijklmnopqrstuvwxyz";
+    unsigned long count = 0;
+
+    for (Xapian::TermIterator it = db.allterms_begin(); it != db.allterms_end(); it++) {
+        string term = *it;
+        if ((term.find_first_of(lowercase) == 0) &&
+            (term.find_first_not_of(lowercase) == string::npos)) {
+            IndexedTerm t;
+            t.term = term;
+            t.docFreq = db.get_termfreq("Z" + stemmer(term));
+            t.collFreq = db.get_collection_freq(term);
+            terms.push_back(t);
+        }
+        ++count;
+        if (count % 1000000 == 0) cerr << "count = " << count << endl;
+    }
+}
+
+// Binary terms files are pre-sorted the way the client samples them (most
+// frequent first), so the client can map them without any parsing
+void writeTermTable(const TermIndex& index, const string& termsFileName,
+                    unsigned llimit, unsigned ulimit) {
+    auto range = index.range(llimit, ulimit);
+    vector<const TermIndexEntry*> entries;
+    for (const TermIndexEntry* e = range.first; e != range.second; e++)
+        entries.push_back(e);
+    stable_sort(entries.begin(), entries.end(),
+        [] (const TermIndexEntry* lhs, const TermIndexEntry* rhs) {
+            return lhs->collFreq > rhs->collFreq;
+        });
+
+    vector<string> terms;
+    terms.reserve(entries.size());
+    for (auto e : entries) terms.push_back(index.term(e));
+    if (!TermTable::write(termsFileName, terms)) {
+        cerr << "Can't write terms file " << termsFileName << endl;
+        exit(-1);
+    }
+}
+
+void writeTermsFile(const TermIndex& index, const string& termsFileName,
+                    unsigned llimit, unsigned ulimit, bool binary) {
+    if (binary) {
+        writeTermTable(index, termsFileName, llimit, ulimit);
+        return;
+    }
+
+    ofstream termsFile(termsFileName);
+    if (termsFile.fail()) {
+        cerr << "Can't open terms file " << termsFileName << endl;
+        exit(-1);
+    }
+
+    auto range = index.range(llimit, ulimit);
+    for (const TermIndexEntry* e = range.first; e != range.second; e++)
+        termsFile << index.term(e) << "," << e->collFreq << endl;
+
+    termsFile.close();
+}
+
 int main(int argc, char* argv[]) {
 
     char* dbPath = NULL;
+    string indexFileName = "";
     string termsFileName = "terms.in";
+    string outDir = "terms";
     unsigned llimit = 100;
     unsigned ulimit = 1000;
     bool createInRange = false;
+    bool tempIndex = false;
+    bool binary = false;
 
     // Read command line options
     int c;
-    string optString = "d:f:l:u:r"; // d: db, t: terms file, n: numThreads
+    string optString = "d:f:l:u:ri:o:b"; // d: db, f: terms file, i: index file
     while ((c = getopt(argc, argv, optString.c_str())) != -1) {
         switch (c) {
             case 'd':
@@ -65,6 +151,26 @@ int main(int argc, char* argv[]) {
                 createInRange=true;
                 break;
 
+            case 'b':
+                binary = true;
+                break;
+
+            case 'i':
+                if(strcmp(optarg, "?") == 0) {
+                    cerr << "Missing index file" << endl;
+                    usage();
+                }
+                indexFileName = optarg;
+                break;
+
+            case 'o':
+                if(strcmp(optarg, "?") == 0) {
+                    cerr << "Missing output directory" << endl;
+                    usage();
+                }
+                outDir = optarg;
+                break;
+
             default:
                 cerr << "Unknown option: " << optopt << endl;
                 exit(-1);
@@ -73,119 +179,46 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    Xapian::Database db;
-    try {
-        db.add_database(Xapian::Database(dbPath));
-    }
-    catch (const Xapian::Error& e) {
-        cerr << "Error opening database: " << e.get_msg() << endl;
-        usage();
+    if (!dbPath && indexFileName.empty()) usage();
+
+    if (dbPath) {
+        vector<IndexedTerm> terms;
+        buildIndex(dbPath, terms);
+        cerr << "Indexed " << terms.size() << " terms" << endl;
+
+        // Without -i, the index only lives for this run
+        if (indexFileName.empty()) {
+            indexFileName = termsFileName + ".idx";
+            tempIndex = true;
+        }
+        if (!TermIndex::write(indexFileName, terms)) {
+            cerr << "Can't write index file " << indexFileName << endl;
+            exit(-1);
+        }
     }
 
-    Xapian::Enquire enquire(db);
-    Xapian::Stem stemmer("english");
-    Xapian::SimpleStopper stopper;
-    const char* stopWords[] = { "a", "about", "an", "and", "are", "as", "at", "be",
-        "by", "en", "for", "from", "how", "i", "in", "is", "it", "of", "on",
-        "or", "that", "the", "this", "to", "was", "what", "when", "where",
-        "which", "who", "why", "will", "with" };
-
-    stopper = Xapian::SimpleStopper(stopWords, \
-            stopWords + sizeof(stopWords) / sizeof(stopWords[0]));
-
-    Xapian::QueryParser parser;
-    parser.set_database(db);
-    parser.set_default_op(Xapian::Query::OP_OR);
-    parser.set_stemmer(stemmer);
-    parser.set_stemming_strategy(Xapian::QueryParser::STEM_SOME);
-    parser.set_stopper(&stopper);
+    TermIndex index;
+    if (!index.open(indexFileName)) {
+        cerr << "Can't read index file " << indexFileName << endl;
+        exit(-1);
+    }
 
     if (createInRange) {
-        ofstream termsFiles[11 * 1000];
         cerr << "Generating terms up to llimit=1K, ulimit=100K" << endl;
         for (unsigned ll = 0; ll <= 1000; ll += 100) { // 11
             for (unsigned ul = 100; ul <= 100000; ul += 100) { // 1000
+                if (ll >= ul) continue;
                 stringstream ss;
-                ss << "/gash/hrlee/terms/terms_ll" << ll << "_ul" << ul << ".in";
-                ofstream& termsFile = termsFiles[(ll / 100) * 1000 + ((ul / 100) - 1)];
-                termsFile.open(ss.str());
-                if (termsFile.fail()) {
-                    cerr << "Can't open terms file " << ss.str() << endl;
-                    exit(-1);
-                }
-            }
-        }
-        cerr << "Opened output files" << endl;
-
-        unsigned int MSET_SIZE = db.get_doccount();
-        Xapian::MSet mset;
-        unsigned long count = 0;
-
-        string lowercase = "abcdefghijklmnopqrstuvwxyz";
-
-        for (Xapian::TermIterator it = db.allterms_begin(); it != db.allterms_end(); it++) {
-            Xapian::termcount cnt = db.get_collection_freq(*it);
-            string term = *it;
-            if ((term.find_first_of(lowercase) == 0) &&
-                (term.find_first_not_of(lowercase) == string::npos)) {
-
-                unsigned int flags = Xapian::QueryParser::FLAG_DEFAULT;
-                Xapian::Query query = parser.parse_query(term, flags);
-                enquire.set_query(query);
-                mset = enquire.get_mset(0, MSET_SIZE);
-                auto mset_size = mset.size();
-
-                #pragma omp parallel for
-                for (int i = 0; i < 11000; i++) {
-                    unsigned ll = (i / 1000) * 100;
-                    unsigned ul = ((i % 1000) * 100) + 100;
-                    if (ll < ul && mset_size >= ll && mset_size <= ul)
-                        termsFiles[i] << term << "," << cnt << endl;
-                }
+                ss << outDir << "/terms_ll" << ll << "_ul" << ul << ".in";
+                writeTermsFile(index, ss.str(), ll, ul, binary);
             }
-            ++count;
-            if (count % 100000 == 0) cerr << "count = " << count << endl;
         }
-
-        for (int i = 0; i < 11000; i++)
-            termsFiles[i].close();
     } else {
-        // Open terms file
-        ofstream termsFile(termsFileName);
-        if (termsFile.fail()) {
-            cerr << "Can't open terms file " << termsFileName << endl;
-            exit(-1);
-        }
-
-        unsigned int MSET_SIZE = ulimit + 1;
-        Xapian::MSet mset;
-        unsigned long count = 0;
-
-        string lowercase = "abcdefghijklmnopqrstuvwxyz";
-
         cerr << "Generating terms with llimit=" << llimit << ", ulimit=" << ulimit << endl;
-        for (Xapian::TermIterator it = db.allterms_begin(); it != db.allterms_end(); it++) {
-            Xapian::termcount cnt = db.get_collection_freq(*it);
-            string term = *it;
-            if ((term.find_first_of(lowercase) == 0) &&
-                (term.find_first_not_of(lowercase) == string::npos)) {
-
-                unsigned int flags = Xapian::QueryParser::FLAG_DEFAULT;
-                Xapian::Query query = parser.parse_query(term, flags);
-                enquire.set_query(query);
-                mset = enquire.get_mset(0, MSET_SIZE);
-
-                if (mset.size() >= llimit &&
-                        mset.size() <= ulimit) {
-                    termsFile << *it << "," << cnt << endl;
-                }
-            }
-            ++count;
-            //if (count % 100000 == 0) cerr << "count = " << count << endl;
-        }
-
-        termsFile.close();
+        writeTermsFile(index, termsFileName, llimit, ulimit, binary);
     }
 
+    if (tempIndex) unlink(indexFileName.c_str());
+
     return 0;
 }
@@ -10,6 +10,7 @@
 #include "server.h"
 #include "tbench_server.h"
 #include "genDB.h"
+#include "dbstage.h"
 #include "rapidjson/document.h"
 #include "getopt.h"
 
@@ -24,7 +25,7 @@ pthread_barrier_t barrier;
 
 inline void usage() {
     cerr << "xapian_search [-n <numServers>]\
-        [-d <dbPath>] [-r <numRequests]" << endl;
+        [-d <dbPath>] [-r <numRequests] [-H <hugepageStageDir>]" << endl;
 }
 
 inline void sanityCheckArg(string msg) {
@@ -38,9 +39,10 @@ inline void sanityCheckArg(string msg) {
 int main(int argc, char* argv[]) {
     unsigned numServers = 4;
     string dbPath = "db";
+    string stageDir = "";
 
     int c;
-    string optString = "n:d:r:";
+    string optString = "n:d:r:H:";
     while ((c = getopt(argc, argv, optString.c_str())) != -1) {
         switch (c) {
             case 'n':
@@ -58,6 +60,11 @@ int main(int argc, char* argv[]) {
                 numReqsToProcess = atol(optarg);
                 break;
 
+            case 'H':
+                sanityCheckArg("Missing hugepage stage dir");
+                stageDir = optarg;
+                break;
+
             default:
                 cerr << "Unknown option " << c << endl;
                 usage();
@@ -66,9 +73,20 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    // Serve the database from a hugepage-backed, memory-resident copy so
+    // that disk and page-cache faults stay out of the measured profile
+    StagedDatabase* stagedDb = NULL;
+    if (!stageDir.empty()) {
+        stagedDb = new StagedDatabase(dbPath, stageDir);
+        dbPath = stagedDb->path();
+    }
+
     tBenchServerInit(numServers);
 
     Server::init(numReqsToProcess, numServers);
+    // Each server opens its own handle, since Xapian objects aren't
+    // thread-safe; the handles read the same files, so they still share the
+    // page cache (or the staged copy)
     Server** servers = new Server* [numServers];
     for (unsigned i = 0; i < numServers; i++)
         servers[i] = new Server(i, dbPath);
@@ -95,5 +113,7 @@ int main(int argc, char* argv[]) {
 
     Server::fini();
 
+    delete stagedDb;
+
     return 0;
 }
@@ -1,9 +1,16 @@
 #include <iostream>
 #include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
 #include <fstream>
 #include <sstream>
 #include <stdlib.h>
+#include <string.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
+#include <vector>
 #include <libxml/xmlreader.h>
 
 #include "genDB.h"
@@ -13,56 +20,111 @@
 using namespace std;
 
 void usage() {
-    cout << "Usage: pregenDB -d db -s path_to_src_db_file -n numdocs -l minDocLen -u maxDocLen" << endl;
+    cout << "Usage: pregenDB -s path_to_src_db_file [-t numThreads]" << endl
+         << "         -d db -n numdocs -l minDocLen -u maxDocLen" << endl
+         << "         [-v numdocs:minDocLen:maxDocLen:db ...]" << endl
+         << "Every -v adds another DB variant built in the same pass over the"
+         << " source file" << endl;
     exit(-1);
 }
 
-void genStackOverflowDB(string dbPath, string srcPath, int numDocs,
-                        int minDocLen, int maxDocLen) {
-    Xapian::WritableDatabase db(dbPath, Xapian::DB_CREATE_OR_OVERWRITE);
-    // Increase commit threshold to improve indexing throughput
-    setenv("XAPIAN_FLUSH_THRESHOLD", "100000", 1);
+// One output database: the first numDocs posts whose body length is in
+// [minDocLen, maxDocLen]
+struct Variant {
+    string dbPath;
+    int numDocs;
+    int minDocLen;
+    int maxDocLen;
 
-    Xapian::TermGenerator termgen;
-    Xapian::Stem stemmer("english");
-    Xapian::SimpleStopper stopper;
-    const char* stopWords[] = { "a", "about", "an", "and", "are", "as", "at", "be",
-        "by", "en", "for", "from", "how", "i", "in", "is", "it", "of", "on",
-        "or", "that", "the", "this", "to", "was", "what", "when", "where",
-        "which", "who", "why", "will", "with" };
+    // Only touched by the reader thread
+    int numRead;
+    vector<string> batch;
 
-    stopper = Xapian::SimpleStopper(stopWords, \
-            stopWords + sizeof(stopWords) / sizeof(stopWords[0]));
+    // shardPaths[t] is set if indexing thread t wrote a shard of this variant
+    vector<string> shardPaths;
+};
 
-    termgen.set_stemmer(stemmer);
-    termgen.set_stopper(&stopper);
+struct Batch {
+    unsigned variant;
+    vector<string> docs;
+};
+
+// Bounded queue of document batches from the reader to the indexing threads
+class BatchQueue {
+    private:
+        mutex lock;
+        condition_variable notEmpty;
+        condition_variable notFull;
+        deque<Batch> batches;
+        size_t maxBatches;
+        bool closed;
+
+    public:
+        BatchQueue(size_t maxBatches) : maxBatches(maxBatches), closed(false) {}
+
+        void push(Batch&& b) {
+            unique_lock<mutex> l(lock);
+            while (batches.size() >= maxBatches) notFull.wait(l);
+            batches.push_back(move(b));
+            notEmpty.notify_one();
+        }
+
+        // Returns false once the queue is closed and drained
+        bool pop(Batch& b) {
+            unique_lock<mutex> l(lock);
+            while (batches.empty() && !closed) notEmpty.wait(l);
+            if (batches.empty()) return false;
+            b = move(batches.front());
+            batches.pop_front();
+            notFull.notify_one();
+            return true;
+        }
+
+        void close() {
+            lock_guard<mutex> l(lock);
+            closed = true;
+            notEmpty.notify_all();
+        }
+};
+
+const size_t BATCH_SIZE = 1000;
+const unsigned COMMIT_INTERVAL = 10000;
 
-    // Assume XML Document
+// Splits the XML into per-variant batches. A single pass feeds all variants.
+void readPosts(string srcPath, vector<Variant>& variants, BatchQueue& queue) {
     xmlTextReaderPtr reader;
     int ret;
-    int idx = 0;
-	const char* filename = srcPath.c_str();
+    const char* filename = srcPath.c_str();
     reader = xmlNewTextReaderFilename(filename);
     const xmlChar *bodyattr = xmlCharStrdup("Body");
+    size_t numDone = 0;
+    for (Variant& var : variants)
+        if (var.numDocs <= 0) ++numDone;
+
     if (reader != NULL) {
         ret = xmlTextReaderRead(reader);
-        while (ret == 1) {
+        while (ret == 1 && numDone < variants.size()) {
             if (xmlTextReaderNodeType(reader) == 1) {
                 unsigned char* xmlbody = xmlTextReaderGetAttribute(reader, bodyattr);
                 if (xmlbody) {
                     string text(reinterpret_cast<char*>(xmlbody));
-                    if ((text.size() >= (unsigned int)minDocLen) && (text.size() <= (unsigned int)maxDocLen)) {
-                        Xapian::Document doc;
-                        doc.set_data(text);
-                        termgen.set_document(doc);
-                        termgen.index_text(text);
-                        db.add_document(doc);
-
-                        if (++idx % 10000 == 0) {
-                            db.commit();
+                    xmlFree(xmlbody);
+                    for (unsigned v = 0; v < variants.size(); v++) {
+                        Variant& var = variants[v];
+                        if (var.numRead >= var.numDocs) continue;
+                        if ((text.size() < (unsigned int)var.minDocLen) ||
+                                (text.size() > (unsigned int)var.maxDocLen))
+                            continue;
+
+                        var.batch.push_back(text);
+                        if (++var.numRead == var.numDocs) ++numDone;
+                        if (var.batch.size() == BATCH_SIZE ||
+                                var.numRead == var.numDocs) {
+                            Batch b;
+                            b.variant = v;
+                            b.docs.swap(var.batch);
+                            queue.push(move(b));
                         }
-                        if (idx > numDocs)
-                            break;
                     }
                 }
             }
@@ -70,24 +132,187 @@ void genStackOverflowDB(string dbPath, string srcPath, int numDocs,
             ret = xmlTextReaderRead(reader);
         }
         xmlFreeTextReader(reader);
-        if (ret != 0 && idx <= numDocs)
+        if (ret < 0)
             printf("%s : failed to parse\n", filename);
-        else
-            printf("Finished generating nd=%d,mindl=%d,maxdl=%d\n",
-                    numDocs, minDocLen, maxDocLen);
     } else {
         printf("Unable to open %s\n", filename);
     }
+
+    // Flush variants the source file didn't have enough posts for
+    for (unsigned v = 0; v < variants.size(); v++) {
+        Variant& var = variants[v];
+        if (var.numRead < var.numDocs)
+            printf("Only found %d of %d docs for %s\n", var.numRead,
+                    var.numDocs, var.dbPath.c_str());
+        if (!var.batch.empty()) {
+            Batch b;
+            b.variant = v;
+            b.docs.swap(var.batch);
+            queue.push(move(b));
+        }
+    }
+
+    queue.close();
+}
+
+// Indexes batches into this thread's own shard of each variant
+void indexPosts(unsigned tid, vector<Variant>& variants, BatchQueue& queue) {
+    Xapian::TermGenerator termgen;
+    Xapian::Stem stemmer("english");
+    Xapian::SimpleStopper stopper;
+    const char* stopWords[] = { "a", "about", "an", "and", "are", "as", "at", "be",
+        "by", "en", "for", "from", "how", "i", "in", "is", "it", "of", "on",
+        "or", "that", "the", "this", "to", "was", "what", "when", "where",
+        "which", "who", "why", "will", "with" };
+
+    stopper = Xapian::SimpleStopper(stopWords, \
+            stopWords + sizeof(stopWords) / sizeof(stopWords[0]));
+
+    termgen.set_stemmer(stemmer);
+    termgen.set_stopper(&stopper);
+
+    vector<Xapian::WritableDatabase*> shards(variants.size(), nullptr);
+    vector<unsigned> shardDocs(variants.size(), 0);
+
+    Batch b;
+    while (queue.pop(b)) {
+        Variant& var = variants[b.variant];
+        Xapian::WritableDatabase*& shard = shards[b.variant];
+        if (!shard) {
+            // Each thread only ever writes its own slot
+            var.shardPaths[tid] = var.dbPath + ".shard" + to_string(tid);
+            shard = new Xapian::WritableDatabase(var.shardPaths[tid],
+                    Xapian::DB_CREATE_OR_OVERWRITE);
+        }
+
+        for (const string& text : b.docs) {
+            Xapian::Document doc;
+            doc.set_data(text);
+            termgen.set_document(doc);
+            termgen.index_text(text);
+            shard->add_document(doc);
+
+            if (++shardDocs[b.variant] % COMMIT_INTERVAL == 0)
+                shard->commit();
+        }
+    }
+
+    for (auto shard : shards) {
+        if (!shard) continue;
+        shard->commit();
+        delete shard;
+    }
+}
+
+// Xapian DB directories are flat, so this doesn't need to recurse
+void removeDir(const string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+        unlink((path + "/" + ent->d_name).c_str());
+    }
+    closedir(dir);
+    rmdir(path.c_str());
+}
+
+// A destination we may replace: missing, empty, or an existing Xapian DB
+bool isReplaceableDB(const string& path) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir) return errno == ENOENT;
+    bool empty = true, isDB = false;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+            continue;
+        empty = false;
+        if (strncmp(ent->d_name, "iam", 3) == 0) isDB = true;
+    }
+    closedir(dir);
+    return empty || isDB;
+}
+
+// Merges all shards of a variant into its final DB (like xapian-compact).
+// The merge goes to a fresh directory that then replaces the old DB, so only
+// directories this tool created or checked in main() are ever removed.
+void mergeShards(Variant& var) {
+    string tmpTemplate = var.dbPath + ".mergeXXXXXX";
+    vector<char> tmpBuf(tmpTemplate.begin(), tmpTemplate.end());
+    tmpBuf.push_back('\0');
+    if (!mkdtemp(tmpBuf.data())) {
+        perror(("mkdtemp " + tmpTemplate).c_str());
+        exit(-1);
+    }
+    string tmpPath = tmpBuf.data();
+
+    Xapian::Compactor compactor;
+    compactor.set_destdir(tmpPath);
+    unsigned numShards = 0;
+    for (const string& shard : var.shardPaths) {
+        if (shard.empty()) continue;
+        compactor.add_source(shard);
+        ++numShards;
+    }
+
+    if (numShards == 0) {
+        // Still produce an (empty) database
+        Xapian::WritableDatabase db(tmpPath, Xapian::DB_CREATE_OR_OVERWRITE);
+    } else {
+        compactor.compact();
+    }
+
+    for (const string& shard : var.shardPaths)
+        if (!shard.empty()) removeDir(shard);
+
+    removeDir(var.dbPath);
+    if (rename(tmpPath.c_str(), var.dbPath.c_str()) != 0) {
+        perror(("rename " + tmpPath + " -> " + var.dbPath).c_str());
+        exit(-1);
+    }
+
+    printf("Finished generating %s (nd=%d,mindl=%d,maxdl=%d,shards=%u)\n",
+            var.dbPath.c_str(), var.numRead, var.minDocLen, var.maxDocLen,
+            numShards);
+}
+
+void genStackOverflowDBs(string srcPath, vector<Variant>& variants,
+                         unsigned numThreads) {
+    // Increase commit threshold to improve indexing throughput
+    setenv("XAPIAN_FLUSH_THRESHOLD", "100000", 1);
+
+    for (Variant& var : variants) {
+        var.numRead = 0;
+        var.shardPaths.assign(numThreads, "");
+    }
+
+    BatchQueue queue(4 * numThreads);
+    vector<thread> indexers;
+    for (unsigned t = 0; t < numThreads; t++)
+        indexers.push_back(thread(indexPosts, t, ref(variants), ref(queue)));
+
+    readPosts(srcPath, variants, queue);
+
+    for (thread& th : indexers) th.join();
+
+    // Compactions of different variants are independent
+    vector<thread> mergers;
+    for (Variant& var : variants)
+        mergers.push_back(thread(mergeShards, ref(var)));
+    for (thread& th : mergers) th.join();
 }
 
 
 int main(int argc, char* argv[]) {
-    string dbPath = "db";
-    string srcPath = "srcPath";
-    string optString = "d:s:n:l:u:";
-    int numDocs = 0, minDocLen = 0, maxDocLen = 0;
+    string srcPath = "";
+    string optString = "d:s:n:l:u:t:v:";
+    Variant legacy;
+    legacy.dbPath = "";
+    legacy.numDocs = legacy.minDocLen = legacy.maxDocLen = 0;
+    vector<Variant> variants;
+    unsigned numThreads = thread::hardware_concurrency();
     int c;
-    if (argc != 11) usage();
     while ((c = getopt(argc, argv, optString.c_str())) != -1) {
         switch (c) {
             case 'd':
@@ -95,7 +320,7 @@ int main(int argc, char* argv[]) {
                     cerr << "Missing database" << endl;
                     usage();
                 }
-                dbPath = optarg;
+                legacy.dbPath = optarg;
                 break;
 
             case 's':
@@ -107,15 +332,33 @@ int main(int argc, char* argv[]) {
                 break;
 
             case 'n':
-                numDocs = atoi(optarg);
+                legacy.numDocs = atoi(optarg);
                 break;
 
             case 'l':
-                minDocLen = atoi(optarg);
+                legacy.minDocLen = atoi(optarg);
                 break;
 
             case 'u':
-                maxDocLen = atol(optarg);
+                legacy.maxDocLen = atol(optarg);
+                break;
+
+            case 't':
+                numThreads = atoi(optarg);
+                break;
+
+            case 'v':
+                {
+                    Variant var;
+                    char path[4096];
+                    if (sscanf(optarg, "%d:%d:%d:%4095s", &var.numDocs,
+                                &var.minDocLen, &var.maxDocLen, path) != 4) {
+                        cerr << "Malformed variant " << optarg << endl;
+                        usage();
+                    }
+                    var.dbPath = path;
+                    variants.push_back(var);
+                }
                 break;
 
             default:
@@ -126,33 +369,24 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    printf("Starting DB generation\n");
-    string dbPath_root = dbPath;
-    genStackOverflowDB(dbPath, srcPath, numDocs, minDocLen, maxDocLen);
-    /*
-    for (numDocs =300000; numDocs <= 500000; numDocs += 100000) {
-        std::vector<std::thread> threads;
-        for (maxDocLen = 1000; maxDocLen <= 10000; maxDocLen += 1000) {
-            for (logBtreeNodeSize = 11; logBtreeNodeSize < 17; logBtreeNodeSize++) {
-                dbPath = dbPath_root + "/nd" + to_string(numDocs)
-                    + "_mdl" + to_string(maxDocLen)
-                    + "_bts" + to_string(logBtreeNodeSize);
-                cout << "Generating: " << dbPath << endl;
-                //genStackOverflowDB(dbPath, numDocs, logBtreeNodeSize, maxDocLen);
-                threads.push_back(
-                    move(std::thread(genStackOverflowDB, dbPath, numDocs,
-                                     logBtreeNodeSize, maxDocLen))
-                );
-            }
-        }
+    if (!legacy.dbPath.empty()) variants.insert(variants.begin(), legacy);
+    if (srcPath.empty() || variants.empty()) usage();
+    if (numThreads == 0) numThreads = 1;
 
-        for (thread& th : threads) {
-            if (th.joinable())
-                th.join();
+    // Check before spending hours indexing; mergeShards() replaces these
+    for (Variant& var : variants) {
+        while (var.dbPath.size() > 1 && var.dbPath.back() == '/')
+            var.dbPath.pop_back();
+        if (!isReplaceableDB(var.dbPath)) {
+            cerr << "Refusing to overwrite " << var.dbPath
+                 << ": not empty and not a Xapian database" << endl;
+            exit(-1);
         }
     }
-    */
 
+    printf("Starting DB generation (%zu variants, %u indexing threads)\n",
+            variants.size(), numThreads);
+    genStackOverflowDBs(srcPath, variants, numThreads);
 
     return 0;
 
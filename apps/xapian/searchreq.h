@@ -0,0 +1,22 @@
+#ifndef __SEARCHREQ_H
+#define __SEARCHREQ_H
+
+#include <stdint.h>
+
+// Wire format of a search request: a small fixed header followed by the
+// NUL-terminated query string.
+struct SearchReq {
+    // Number of results returned to the client (one result page)
+    uint32_t pageSize;
+
+    // Number of documents Xapian is asked to rank. 0 selects the top-k fast
+    // path, where only the pageSize documents actually returned are ranked.
+    uint32_t msetDepth;
+
+    char term[0];
+};
+
+const uint32_t DEFAULT_PAGE_SIZE = 25;
+const uint32_t DEFAULT_MSET_DEPTH = 20480;
+
+#endif // __SEARCHREQ_H
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstring>
 #include <iostream>
 #include <sstream>
@@ -5,13 +6,14 @@
 #include <assert.h>
 #include <unistd.h>
 
+#include "searchreq.h"
 #include "server.h"
 #include "tbench_server.h"
 
 using namespace std;
 
 unsigned long Server::numReqsToProcess = 0;
-volatile atomic_ulong Server::numReqsProcessed(0);
+std::atomic_ulong Server::numReqsClaimed(0);
 pthread_barrier_t Server::barrier;
 
 Server::Server(int id, string dbPath)
@@ -33,6 +35,8 @@ Server::Server(int id, string dbPath)
     parser.set_stemmer(stemmer);
     parser.set_stemming_strategy(Xapian::QueryParser::STEM_SOME);
     parser.set_stopper(&stopper);
+
+    resBuf.resize(1 << 16);
 }
 
 Server::~Server() {
@@ -43,42 +47,58 @@ void Server::_run() {
 
     tBenchServerThreadStart();
 
-    while (numReqsProcessed < numReqsToProcess) {
-       processRequest();
-       ++numReqsProcessed;
+    // Servers claim requests REQ_CLAIM_BATCH at a time, so the shared count
+    // is only touched once per batch, and the claims add up to exactly -r
+    while (true) {
+        unsigned long first = numReqsClaimed.fetch_add(REQ_CLAIM_BATCH);
+        if (first >= numReqsToProcess) break;
+        unsigned long claimed = numReqsToProcess - first;
+        if (claimed > REQ_CLAIM_BATCH) claimed = REQ_CLAIM_BATCH;
+        for (unsigned long i = 0; i < claimed; i++) processRequest();
     }
 }
 
 void Server::processRequest() {
-    const unsigned MAX_TERM_LEN = 256;
-    char term[MAX_TERM_LEN];
-    void* termPtr;
-
-    size_t len = tBenchRecvReq(&termPtr);
-    memcpy(reinterpret_cast<void*>(term), termPtr, len);
-    term[len] = '\0';
+    void* reqPtr;
+    size_t len = tBenchRecvReq(&reqPtr);
+    const SearchReq* req = reinterpret_cast<const SearchReq*>(reqPtr);
+
+    // A malformed request gets an empty result page instead of taking the
+    // server down: it must hold a NUL-terminated query, and must not ask for
+    // more than MAX_MSET_DEPTH documents
+    if (len <= sizeof(SearchReq) ||
+            req->term[len - sizeof(SearchReq) - 1] != '\0' ||
+            std::max(req->pageSize, req->msetDepth) > MAX_MSET_DEPTH) {
+        tBenchSendResp(resBuf.data(), 0);
+        return;
+    }
 
     unsigned int flags = Xapian::QueryParser::FLAG_DEFAULT;
-    Xapian::Query query = parser.parse_query(term, flags);
+    Xapian::Query query = parser.parse_query(req->term, flags);
     enquire.set_query(query);
-    mset = enquire.get_mset(0, MSET_SIZE);
 
-    const unsigned MAX_RES_LEN = 1 << 20;
-    char res[MAX_RES_LEN];
+    // Only rank past the result page if the request asks for it; with
+    // msetDepth == 0, Xapian can terminate early once it has the top-k
+    unsigned pageSize = req->pageSize;
+    unsigned msetDepth = std::max(pageSize, req->msetDepth);
+    mset = enquire.get_mset(0, msetDepth);
 
-    unsigned resLen = 0;
+    const size_t MAX_RES_LEN = 1 << 20;
+    size_t resLen = 0;
     unsigned doccount = 0;
-    const unsigned MAX_DOC_COUNT = 25; // up to 25 results per page
     for (auto it = mset.begin(); it != mset.end(); ++it) {
+        if (doccount++ == pageSize) break;
+
+        // Return as many whole results as fit in a response
         std::string desc = it.get_document().get_description();
+        if (resLen + desc.size() > MAX_RES_LEN) break;
+        if (resLen + desc.size() > resBuf.size())
+            resBuf.resize(std::max(2 * resBuf.size(), resLen + desc.size()));
+        memcpy(&resBuf[resLen], desc.c_str(), desc.size());
         resLen += desc.size();
-        assert(resLen <= MAX_RES_LEN);
-        memcpy(reinterpret_cast<void*>(&res[resLen]), desc.c_str(), desc.size());
-
-        if (++doccount == MAX_DOC_COUNT) break;
     }
 
-    tBenchSendResp(reinterpret_cast<void*>(res), resLen);
+    tBenchSendResp(resBuf.data(), resLen);
 }
 
 void* Server::run(void* v) {
@@ -89,6 +109,7 @@ void* Server::run(void* v) {
 
 void Server::init(unsigned long _numReqsToProcess, unsigned numServers) {
     numReqsToProcess = _numReqsToProcess;
+    numReqsClaimed = 0;
     pthread_barrier_init(&barrier, NULL, numServers);
 }
 
@@ -9,8 +9,9 @@
 class Server {
     private:
         static unsigned long numReqsToProcess;
-        static volatile std::atomic_ulong numReqsProcessed;
-        static const unsigned int MSET_SIZE = 20480;
+        static std::atomic_ulong numReqsClaimed;
+        static const unsigned int REQ_CLAIM_BATCH = 64;
+        static const unsigned int MAX_MSET_DEPTH = 1 << 20;
         static pthread_barrier_t barrier;
 
         Xapian::Database db;
@@ -20,6 +21,7 @@ class Server {
         Xapian::QueryParser parser;
         pthread_mutex_t lock;
         Xapian::MSet mset;
+        std::vector<char> resBuf; // reused across requests
 
         int id;
 
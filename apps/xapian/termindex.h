@@ -0,0 +1,138 @@
+#ifndef __TERMINDEX_H
+#define __TERMINDEX_H
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary index of all search terms of a database, sorted by the number of
+// documents a single-term query for them matches. Any [ll, ul] terms file is
+// a contiguous slice of it, found with two binary searches.
+//
+// Layout:
+//   TermIndexHeader
+//   TermIndexEntry[numTerms]  sorted by (docFreq, term)
+//   char blob[blobSize]       term strings in entry order, not NUL-terminated
+const char TERM_INDEX_MAGIC[8] = { 'T', 'E', 'R', 'M', 'I', 'D', 'X', '1' };
+
+struct TermIndexHeader {
+    char magic[8];
+    uint64_t numTerms;
+    uint64_t blobSize;
+};
+
+struct TermIndexEntry {
+    uint32_t docFreq;  // documents matched by a query for the term
+    uint32_t collFreq; // occurrences in the collection (the terms file column)
+    uint64_t offset;   // into the blob; length runs to the next entry
+};
+
+struct IndexedTerm {
+    std::string term;
+    uint32_t docFreq;
+    uint32_t collFreq;
+};
+
+class TermIndex {
+    private:
+        void* addr;
+        size_t size;
+        const TermIndexHeader* hdr;
+        const TermIndexEntry* entries;
+        const char* blob;
+
+    public:
+        TermIndex() : addr(NULL), size(0), hdr(NULL), entries(NULL), blob(NULL) {}
+
+        ~TermIndex() {
+            if (addr) munmap(addr, size);
+        }
+
+        // Sorts terms and writes them out as an index. Returns false on error.
+        static bool write(const std::string& path, std::vector<IndexedTerm>& terms) {
+            std::sort(terms.begin(), terms.end(),
+                [] (const IndexedTerm& lhs, const IndexedTerm& rhs) {
+                    return lhs.docFreq != rhs.docFreq ?
+                        lhs.docFreq < rhs.docFreq : lhs.term < rhs.term;
+                });
+
+            TermIndexHeader h;
+            memcpy(h.magic, TERM_INDEX_MAGIC, sizeof(h.magic));
+            h.numTerms = terms.size();
+            h.blobSize = 0;
+
+            std::vector<TermIndexEntry> ents(terms.size());
+            for (size_t i = 0; i < terms.size(); i++) {
+                ents[i].docFreq = terms[i].docFreq;
+                ents[i].collFreq = terms[i].collFreq;
+                ents[i].offset = h.blobSize;
+                h.blobSize += terms[i].term.size();
+            }
+
+            FILE* f = fopen(path.c_str(), "wb");
+            if (!f) return false;
+            bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+            if (!ents.empty())
+                ok = ok && fwrite(ents.data(), sizeof(TermIndexEntry),
+                        ents.size(), f) == ents.size();
+            for (auto& t : terms)
+                ok = ok && fwrite(t.term.data(), 1, t.term.size(), f) == t.term.size();
+            return (fclose(f) == 0) && ok;
+        }
+
+        // Maps an index written by write(). Returns false on error.
+        bool open(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TermIndexHeader)) {
+                close(fd);
+                return false;
+            }
+            size = st.st_size;
+            addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (addr == MAP_FAILED) {
+                addr = NULL;
+                return false;
+            }
+
+            hdr = static_cast<const TermIndexHeader*>(addr);
+            entries = reinterpret_cast<const TermIndexEntry*>(hdr + 1);
+            blob = reinterpret_cast<const char*>(entries + hdr->numTerms);
+            return memcmp(hdr->magic, TERM_INDEX_MAGIC, sizeof(hdr->magic)) == 0 &&
+                size == sizeof(*hdr) + hdr->numTerms * sizeof(TermIndexEntry) +
+                    hdr->blobSize;
+        }
+
+        uint64_t numTerms() const { return hdr->numTerms; }
+
+        const TermIndexEntry* begin() const { return entries; }
+        const TermIndexEntry* end() const { return entries + hdr->numTerms; }
+
+        // Entries with ll <= docFreq <= ul
+        std::pair<const TermIndexEntry*, const TermIndexEntry*>
+        range(uint32_t ll, uint32_t ul) const {
+            const TermIndexEntry* lo = std::lower_bound(begin(), end(), ll,
+                [] (const TermIndexEntry& e, uint32_t f) { return e.docFreq < f; });
+            const TermIndexEntry* hi = std::upper_bound(lo, end(), ul,
+                [] (uint32_t f, const TermIndexEntry& e) { return f < e.docFreq; });
+            return std::make_pair(lo, hi);
+        }
+
+        std::string term(const TermIndexEntry* e) const {
+            uint64_t next = (e + 1 == end()) ? hdr->blobSize : (e + 1)->offset;
+            return std::string(blob + e->offset, next - e->offset);
+        }
+};
+
+#endif // __TERMINDEX_H
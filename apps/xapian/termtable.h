@@ -0,0 +1,157 @@
+#ifndef __TERMTABLE_H
+#define __TERMTABLE_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Prebuilt table of search terms, sorted by decreasing frequency, that the
+// client maps and samples from directly.
+//
+// Layout:
+//   TermTableHeader
+//   uint64_t offsets[numTerms + 1]  into the blob; offsets[numTerms] == blobSize
+//   char blob[blobSize]             NUL-terminated terms, most frequent first
+const char TERM_TABLE_MAGIC[8] = { 'T', 'E', 'R', 'M', 'T', 'B', 'L', '1' };
+
+struct TermTableHeader {
+    char magic[8];
+    uint64_t numTerms;
+    uint64_t blobSize;
+};
+
+class TermTable {
+    private:
+        void* addr;
+        size_t size;
+        std::vector<char> owned; // backing store when built in memory
+        const TermTableHeader* hdr;
+        const uint64_t* offsets;
+        const char* blob;
+
+        void setBase(const char* base) {
+            hdr = reinterpret_cast<const TermTableHeader*>(base);
+            offsets = reinterpret_cast<const uint64_t*>(hdr + 1);
+            blob = reinterpret_cast<const char*>(offsets + hdr->numTerms + 1);
+        }
+
+        // Serializes terms (already in sampling order) into buf
+        static void serialize(const std::vector<std::string>& terms,
+                              std::vector<char>& buf) {
+            TermTableHeader h;
+            memcpy(h.magic, TERM_TABLE_MAGIC, sizeof(h.magic));
+            h.numTerms = terms.size();
+            h.blobSize = 0;
+            for (auto& t : terms) h.blobSize += t.size() + 1;
+
+            buf.resize(sizeof(h) + (terms.size() + 1) * sizeof(uint64_t) + h.blobSize);
+            memcpy(&buf[0], &h, sizeof(h));
+            uint64_t* offs = reinterpret_cast<uint64_t*>(&buf[sizeof(h)]);
+            char* b = reinterpret_cast<char*>(offs + terms.size() + 1);
+            uint64_t off = 0;
+            for (size_t i = 0; i < terms.size(); i++) {
+                offs[i] = off;
+                memcpy(b + off, terms[i].c_str(), terms[i].size() + 1);
+                off += terms[i].size() + 1;
+            }
+            offs[terms.size()] = off;
+        }
+
+    public:
+        TermTable() : addr(NULL), size(0), hdr(NULL), offsets(NULL), blob(NULL) {}
+
+        ~TermTable() {
+            if (addr) munmap(addr, size);
+        }
+
+        // True if path starts with the table magic, i.e. isn't a CSV terms file
+        static bool isTermTable(const std::string& path) {
+            char magic[sizeof(TERM_TABLE_MAGIC)];
+            FILE* f = fopen(path.c_str(), "rb");
+            if (!f) return false;
+            bool res = fread(magic, sizeof(magic), 1, f) == 1 &&
+                memcmp(magic, TERM_TABLE_MAGIC, sizeof(magic)) == 0;
+            fclose(f);
+            return res;
+        }
+
+        // Writes terms, which must already be sorted most frequent first
+        static bool write(const std::string& path,
+                          const std::vector<std::string>& terms) {
+            std::vector<char> buf;
+            serialize(terms, buf);
+            FILE* f = fopen(path.c_str(), "wb");
+            if (!f) return false;
+            bool ok = fwrite(buf.data(), 1, buf.size(), f) == buf.size();
+            return (fclose(f) == 0) && ok;
+        }
+
+        // Maps a table written by write(). Returns false on error.
+        bool open(const std::string& path) {
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) return false;
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TermTableHeader)) {
+                close(fd);
+                return false;
+            }
+            size = st.st_size;
+            addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            close(fd);
+            if (addr == MAP_FAILED) {
+                addr = NULL;
+                return false;
+            }
+
+            // Only the header and both ends of the table are checked here, so
+            // mapping stays O(1); see termOk() and check() for the rest
+            setBase(static_cast<const char*>(addr));
+            return memcmp(hdr->magic, TERM_TABLE_MAGIC, sizeof(hdr->magic)) == 0 &&
+                hdr->numTerms < size / sizeof(uint64_t) &&
+                hdr->blobSize < size &&
+                size == sizeof(*hdr) + (hdr->numTerms + 1) * sizeof(uint64_t) +
+                    hdr->blobSize &&
+                offsets[0] == 0 && offsets[hdr->numTerms] == hdr->blobSize &&
+                (hdr->blobSize == 0 || blob[hdr->blobSize - 1] == '\0');
+        }
+
+        // Builds the table in memory from terms in sampling order
+        void build(const std::vector<std::string>& terms) {
+            serialize(terms, owned);
+            setBase(owned.data());
+        }
+
+        // True if term i lies within the blob, is NUL-terminated and is no
+        // longer than maxTermLen
+        bool termOk(uint64_t i, size_t maxTermLen) const {
+            return offsets[i + 1] > offsets[i] &&
+                offsets[i + 1] <= hdr->blobSize &&
+                offsets[i + 1] - offsets[i] - 1 <= maxTermLen &&
+                blob[offsets[i + 1] - 1] == '\0';
+        }
+
+        // termOk() for every term. This is O(numTerms), so callers that
+        // sample terms can check each one as it is used instead.
+        bool check(size_t maxTermLen) const {
+            for (uint64_t i = 0; i < hdr->numTerms; i++) {
+                if (!termOk(i, maxTermLen)) return false;
+            }
+            return true;
+        }
+
+        uint64_t numTerms() const { return hdr->numTerms; }
+
+        const char* term(uint64_t i) const { return blob + offsets[i]; }
+
+        // Length excluding the terminating NUL
+        size_t termLen(uint64_t i) const { return offsets[i + 1] - offsets[i] - 1; }
+};
+
+#endif // __TERMTABLE_H
@@ -0,0 +1,200 @@
+/** $lic$
+ * Copyright (C) 2021-2022 by Massachusetts Institute of Technology
+ *
+ * This file is part of Datamime.
+ *
+ * This tool is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * If you use this software in your research, we request that you reference
+ * the Datamime paper ("Datamime: Generating Representative Benchmarks by
+ * Automatically Synthesizing Datasets", Lee and Sanchez, MICRO-55, October 2022)
+ * as the source in any publications that use this software, and that you send
+ * us a citation of your work.
+ *
+ * This tool is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __KERNELS_H
+#define __KERNELS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <random>
+#include <string>
+
+// Building blocks for synthetic workloads whose cache, branch and bandwidth
+// behavior is known analytically. Every kernel returns a value derived from
+// the data it touched so the compiler can't elide the accesses.
+namespace kernels {
+
+const size_t LINE_BYTES = 64;
+
+// One cache line of a pointer-chase cycle
+struct Line {
+    Line* next;
+    uint64_t pad[(LINE_BYTES - sizeof(Line*)) / sizeof(uint64_t)];
+} __attribute__ ((aligned (64)));
+
+static_assert(sizeof(Line) == LINE_BYTES, "Line must fill a cache line");
+
+// Cheap generator for use inside kernels, where std:: engines are too slow
+struct XorShift {
+    uint64_t s;
+    XorShift(uint64_t seed) : s(seed ? seed : 0x9e3779b97f4a7c15ul) {}
+    inline uint64_t next() {
+        s ^= s << 13;
+        s ^= s >> 7;
+        s ^= s << 17;
+        return s;
+    }
+};
+
+// Links lines into a single random cycle (Sattolo's algorithm), so a chase
+// touches every line once per lap in an order no prefetcher can follow
+inline void buildCycle(Line* lines, size_t n, uint64_t seed) {
+    uint64_t* order = new uint64_t[n];
+    for (size_t i = 0; i < n; i++) order[i] = i;
+    std::mt19937_64 rng(seed);
+    for (size_t i = n - 1; i > 0; i--) {
+        size_t j = std::uniform_int_distribution<size_t>(0, i - 1)(rng);
+        uint64_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (size_t i = 0; i < n; i++) {
+        lines[order[i]].next = &lines[order[(i + 1) % n]];
+        lines[order[i]].pad[0] = i;
+    }
+    delete[] order;
+}
+
+// Dependent loads along a cycle built by buildCycle(). *pos carries the
+// position across calls.
+inline uint64_t chase(Line** pos, uint64_t loads) {
+    Line* p = *pos;
+    for (uint64_t i = 0; i < loads; i++) p = p->next;
+    *pos = p;
+    return reinterpret_cast<uintptr_t>(p);
+}
+
+// Chases over several cycles built by buildCycle(), interleaved at random:
+// each load follows cycle k when the draw falls below thresholds[k] (and
+// above the previous threshold), so thresholds are the cumulative weights
+// scaled to UINT64_MAX, the last one UINT64_MAX. pos[k] carries cycle k's
+// position across calls.
+inline uint64_t reuse(Line** pos, const uint64_t* thresholds, size_t cycles,
+                      XorShift& rng, uint64_t loads) {
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < loads; i++) {
+        uint64_t r = rng.next();
+        size_t k = 0;
+        while (k + 1 < cycles && r >= thresholds[k]) k++;
+        pos[k] = pos[k]->next;
+        sum += pos[k]->pad[0];
+    }
+    return sum;
+}
+
+// Independent loads every stride bytes, wrapping around the buffer
+inline uint64_t strided(const uint8_t* buf, size_t bytes, size_t stride,
+                        size_t* pos, uint64_t loads) {
+    uint64_t sum = 0;
+    size_t p = *pos;
+    for (uint64_t i = 0; i < loads; i++) {
+        sum += *reinterpret_cast<const volatile uint64_t*>(buf + p);
+        p += stride;
+        if (p + sizeof(uint64_t) > bytes) p = 0;
+    }
+    *pos = p;
+    return sum;
+}
+
+// Independent random loads. A hotFrac fraction of them goes to the first
+// hotElems elements, the rest to the remaining ones; hotFrac = 0 gives a
+// uniform distribution over the whole buffer.
+inline uint64_t gather(const uint64_t* buf, size_t elems, size_t hotElems,
+                       double hotFrac, XorShift& rng, uint64_t loads) {
+    uint64_t sum = 0;
+    uint64_t hotThreshold = (uint64_t)(hotFrac * (double)UINT64_MAX);
+    size_t coldElems = elems - hotElems;
+    for (uint64_t i = 0; i < loads; i++) {
+        uint64_t r = rng.next();
+        size_t idx;
+        if (hotElems && (r < hotThreshold || !coldElems))
+            idx = rng.next() % hotElems;
+        else
+            idx = hotElems + rng.next() % coldElems;
+        sum += buf[idx];
+    }
+    return sum;
+}
+
+// Sequential read of src and write of dst (a copy-and-add), bandwidth bound
+inline uint64_t stream(const uint64_t* src, uint64_t* dst, size_t elems,
+                       size_t* pos, uint64_t ops) {
+    size_t p = *pos;
+    for (uint64_t i = 0; i < ops; i++) {
+        dst[p] = src[p] + i;
+        if (++p == elems) p = 0;
+    }
+    *pos = p;
+    return dst[0];
+}
+
+// Fills conds with bytes that are below the threshold used by branchy()
+// with probability takenProb
+inline void fillBranches(uint8_t* conds, size_t n, double takenProb, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::bernoulli_distribution taken(takenProb);
+    for (size_t i = 0; i < n; i++) conds[i] = taken(rng) ? 0 : 255;
+}
+
+// One data-dependent branch per op over a small, cache-resident array, so
+// mispredictions dominate. The empty asm keeps the compiler from turning the
+// branch into a conditional move.
+inline uint64_t branchy(const uint8_t* conds, size_t n, size_t* pos, uint64_t ops) {
+    uint64_t sum = 0;
+    size_t p = *pos;
+    for (uint64_t i = 0; i < ops; i++) {
+        if (conds[p] < 128) {
+            sum += i;
+            __asm__ __volatile__("" ::: "memory");
+        } else {
+            sum ^= i;
+        }
+        if (++p == n) p = 0;
+    }
+    *pos = p;
+    return sum;
+}
+
+// Parses sizes like "4096", "32K", "64M" or "1G" (binary units). Returns 0
+// if malformed.
+inline size_t parseSize(const std::string& s) {
+    char* end;
+    double v = strtod(s.c_str(), &end);
+    if (end == s.c_str() || v < 0) return 0;
+    size_t mult = 1;
+    switch (*end) {
+        case '\0': break;
+        case 'k': case 'K': mult = 1ul << 10; end++; break;
+        case 'm': case 'M': mult = 1ul << 20; end++; break;
+        case 'g': case 'G': mult = 1ul << 30; end++; break;
+        default: return 0;
+    }
+    if (*end == 'B' || *end == 'b') end++;
+    return *end ? 0 : (size_t)(v * mult);
+}
+
+} // namespace kernels
+
+#endif // __KERNELS_H
@@ -0,0 +1,281 @@
+/** $lic$
+ * Copyright (C) 2021-2022 by Massachusetts Institute of Technology
+ *
+ * This file is part of Datamime.
+ *
+ * This tool is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * If you use this software in your research, we request that you reference
+ * the Datamime paper ("Datamime: Generating Representative Benchmarks by
+ * Automatically Synthesizing Datasets", Lee and Sanchez, MICRO-55, October 2022)
+ * as the source in any publications that use this software, and that you send
+ * us a citation of your work.
+ *
+ * This tool is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Dependent-load pointer chase over a random cyclic permutation of cache
+// lines. Unlike traverse-array, prefetchers can't hide its misses, so it
+// measures load-to-use latency of whatever level the working set lands in,
+// and works as a prefetch-resistant cache filler.
+
+#include <errno.h>
+#include <numa.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "kernels.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+#ifndef MAP_HUGE_2MB
+#define MAP_HUGE_2MB (21 << MAP_HUGE_SHIFT)
+#endif
+
+using namespace kernels;
+
+enum PageMode { PAGES_4K, PAGES_THP, PAGES_HUGETLB };
+enum NumaMode { NUMA_DEFAULT, NUMA_LOCAL, NUMA_INTERLEAVE };
+
+const size_t HUGE_PAGE_BYTES = 2ul << 20;
+
+void usage(char* argv[]) {
+    std::cout << "USAGE:" << std::endl;
+    std::cout << argv[0] << " -s <size> [-p 4k|thp|hugetlb] [-m default|local|interleave]"
+        " [-N <node>] [-n <num-threads>] [-c <first-cpu>] [-l <laps>] [-r <secs>]"
+        << std::endl;
+    std::cout << "\t-s <size> : working set per thread, e.g. 32M" << std::endl;
+    std::cout << "\t-p <mode> : 4 kB pages, transparent huge pages, or 2 MB"
+        " MAP_HUGETLB pages (default 4k)" << std::endl;
+    std::cout << "\t-m <mode> : NUMA placement: first touch, bound to one node,"
+        " or interleaved over all nodes (default default)" << std::endl;
+    std::cout << "\t-N <node> : node for -m local (default: the thread's own node)"
+        << std::endl;
+    std::cout << "\t-n <num-threads> : threads, each chasing its own cycle (default 1)"
+        << std::endl;
+    std::cout << "\t-c <first-cpu> : pin thread i to cpu first-cpu + i" << std::endl;
+    std::cout << "\t-l <laps> : laps over the cycle per thread, 0 to run forever"
+        " (default 0)" << std::endl;
+    std::cout << "\t-r <secs> : report interval (default 1)" << std::endl;
+    std::cout << "\t-h : Print this help message" << std::endl;
+}
+
+// Allocates bytes with the requested page size and NUMA placement, and
+// touches it so placement happens before any timing
+void* allocBuffer(size_t bytes, PageMode pages, NumaMode numa, int node) {
+    bytes = (bytes + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    if (pages == PAGES_HUGETLB) flags |= MAP_HUGETLB | MAP_HUGE_2MB;
+    void* buf = mmap(NULL, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (buf == MAP_FAILED) {
+        std::cerr << "mmap of " << bytes << " bytes failed: " << strerror(errno);
+        if (pages == PAGES_HUGETLB)
+            std::cerr << " (are enough pages reserved in"
+                " /proc/sys/vm/nr_hugepages?)";
+        std::cerr << std::endl;
+        exit(-1);
+    }
+
+    if (pages == PAGES_THP) madvise(buf, bytes, MADV_HUGEPAGE);
+    else if (pages == PAGES_4K) madvise(buf, bytes, MADV_NOHUGEPAGE);
+
+    if (numa != NUMA_DEFAULT) {
+        if (numa_available() < 0) {
+            std::cerr << "NUMA placement requested but libnuma is unavailable"
+                << std::endl;
+            exit(-1);
+        }
+        if (numa == NUMA_LOCAL) numa_tonode_memory(buf, bytes, node);
+        else numa_interleave_memory(buf, bytes, numa_all_nodes_ptr);
+    }
+
+    memset(buf, 0, bytes);
+    return buf;
+}
+
+// Return ns
+uint64_t now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+struct alignas(64) ThreadStats {
+    std::atomic<uint64_t> loads;
+};
+
+std::atomic<bool> stop(false);
+std::atomic<int> ready(0);
+std::atomic<uint64_t> sink(0);
+
+void chaser(int tid, size_t bytes, PageMode pages, NumaMode numa, int node,
+            int firstCpu, uint64_t laps, ThreadStats* stats) {
+    if (firstCpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(firstCpu + tid, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+            std::cerr << "Could not pin thread " << tid << std::endl;
+    }
+    if (numa == NUMA_LOCAL && node < 0)
+        node = numa_node_of_cpu(sched_getcpu());
+
+    size_t numLines = bytes / LINE_BYTES;
+    Line* lines = static_cast<Line*>(allocBuffer(bytes, pages, numa, node));
+    buildCycle(lines, numLines, 1 + tid);
+
+    // Warm up with one full lap so the first report isn't skewed
+    Line* pos = lines;
+    uint64_t acc = chase(&pos, numLines);
+    ++ready;
+
+    const uint64_t CHUNK = 1 << 14;
+    uint64_t total = laps * numLines;
+    uint64_t done = 0;
+    while (!stop && (laps == 0 || done < total)) {
+        uint64_t n = (laps == 0) ? CHUNK : std::min(CHUNK, total - done);
+        acc += chase(&pos, n);
+        done += n;
+        stats->loads.store(done, std::memory_order_relaxed);
+    }
+
+    sink += acc;
+}
+
+int main(int argc, char* argv[]) {
+    int c;
+    size_t bytes = 0;
+    PageMode pages = PAGES_4K;
+    NumaMode numa = NUMA_DEFAULT;
+    int node = -1;
+    int nthreads = 1;
+    int firstCpu = -1;
+    uint64_t laps = 0;
+    int reportSecs = 1;
+
+    while ((c = getopt(argc, argv, ":s:p:m:N:n:c:l:r:h")) != -1) {
+        switch(c) {
+            case 's':
+                bytes = parseSize(optarg);
+                break;
+            case 'p':
+                if (strcmp(optarg, "4k") == 0) pages = PAGES_4K;
+                else if (strcmp(optarg, "thp") == 0) pages = PAGES_THP;
+                else if (strcmp(optarg, "hugetlb") == 0) pages = PAGES_HUGETLB;
+                else { usage(argv); return -1; }
+                break;
+            case 'm':
+                if (strcmp(optarg, "default") == 0) numa = NUMA_DEFAULT;
+                else if (strcmp(optarg, "local") == 0) numa = NUMA_LOCAL;
+                else if (strcmp(optarg, "interleave") == 0) numa = NUMA_INTERLEAVE;
+                else { usage(argv); return -1; }
+                break;
+            case 'N':
+                node = atoi(optarg);
+                break;
+            case 'n':
+                nthreads = atoi(optarg);
+                break;
+            case 'c':
+                firstCpu = atoi(optarg);
+                break;
+            case 'l':
+                laps = atoll(optarg);
+                break;
+            case 'r':
+                reportSecs = atoi(optarg);
+                break;
+            case 'h':
+                usage(argv);
+                return 0;
+                break;
+            case '?':
+                usage(argv);
+                return -1;
+                break;
+            case ':':
+                usage(argv);
+                return -1;
+                break;
+        }
+    }
+
+    if (bytes < LINE_BYTES || nthreads <= 0 || reportSecs <= 0) {
+        usage(argv);
+        return -1;
+    }
+
+    std::cout << "Working set : " << (bytes >> 10) << " kB/thread | lines : "
+        << bytes / LINE_BYTES << " | threads : " << nthreads << std::endl;
+
+    std::vector<ThreadStats> stats(nthreads);
+    for (ThreadStats& s : stats) s.loads = 0;
+    std::vector<std::thread> thrs;
+    for (int i = 0; i < nthreads; i++)
+        thrs.emplace_back(std::thread(chaser, i, bytes, pages, numa, node,
+                    firstCpu, laps, &stats[i]));
+
+    while (ready < nthreads) usleep(1000);
+
+    // Report the latency of the last interval; with several threads, ns/load
+    // is per thread, since each chase is serialized on its own loads
+    uint64_t start = now();
+    uint64_t lastTime = start;
+    uint64_t lastLoads = 0;
+    uint64_t totalLoads = 0;
+    bool running = true;
+    while (running) {
+        for (int i = 0; i < reportSecs * 100 && running; i++) {
+            usleep(10000);
+            if (laps > 0) {
+                totalLoads = 0;
+                for (ThreadStats& s : stats) totalLoads += s.loads;
+                running = totalLoads < laps * (bytes / LINE_BYTES) * nthreads;
+            }
+        }
+
+        uint64_t t = now();
+        totalLoads = 0;
+        for (ThreadStats& s : stats) totalLoads += s.loads;
+        uint64_t loads = totalLoads - lastLoads;
+        if (loads > 0)
+            std::cout << std::fixed << std::setprecision(2)
+                << (double)(t - lastTime) * nthreads / loads << " ns/load" << std::endl;
+        lastTime = t;
+        lastLoads = totalLoads;
+    }
+
+    stop = true;
+    for (std::thread &thr : thrs) {
+        thr.join();
+    }
+
+    if (totalLoads > 0)
+        std::cout << "Average : " << std::fixed << std::setprecision(2)
+            << (double)(now() - start) * nthreads / totalLoads << " ns/load over "
+            << totalLoads << " loads" << std::endl;
+
+    return 0;
+}
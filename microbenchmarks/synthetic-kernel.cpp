@@ -0,0 +1,507 @@
+/** $lic$
+ * Copyright (C) 2021-2022 by Massachusetts Institute of Technology
+ *
+ * This file is part of Datamime.
+ *
+ * This tool is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * If you use this software in your research, we request that you reference
+ * the Datamime paper ("Datamime: Generating Representative Benchmarks by
+ * Automatically Synthesizing Datasets", Lee and Sanchez, MICRO-55, October 2022)
+ * as the source in any publications that use this software, and that you send
+ * us a citation of your work.
+ *
+ * This tool is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Parameterized synthetic workload: each thread runs a schedule of phases
+// (pointer chase, strided, random gather, streaming, branchy, reuse), each
+// with its own working set, for a set time per phase. Since the access
+// pattern of each phase is fully specified, its miss curve is known
+// analytically (or, for hot/cold gathers, closely approximated), which makes
+// this a ground truth for the profiler's MRC and IPC measurements.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <atomic>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "kernels.h"
+
+using namespace kernels;
+
+enum PhaseKind { CHASE, STRIDE, GATHER, STREAM, BRANCHY, REUSE };
+
+const char* kindNames[] = { "chase", "stride", "gather", "stream", "branchy", "reuse" };
+const size_t NUM_KINDS = sizeof(kindNames) / sizeof(kindNames[0]);
+
+// Branch conditions fit in the L1, so branchy phases don't miss
+const size_t BRANCH_COND_BYTES = 16 * 1024;
+
+struct Phase {
+    PhaseKind kind;
+    size_t wsBytes;    // working set
+    size_t stride;     // stride phases only
+    size_t hotBytes;   // gather phases only; 0 for uniform
+    double hotFrac;    // gather phases only
+    double takenProb;  // branchy phases only
+    std::vector<size_t> loopBytes;    // reuse phases only
+    std::vector<double> loopWeights;  // reuse phases only, sum to 1
+    uint64_t ms;       // duration per round
+};
+
+struct PhaseStats {
+    uint64_t ops;
+    uint64_t ns;
+};
+
+void usage(char* argv[]) {
+    std::cout << "USAGE:" << std::endl;
+    std::cout << argv[0] << " -p <phase> [-p <phase> ...] [-n <num-threads>]"
+        " [-t <seconds>] [-c] [-h]" << std::endl;
+    std::cout << "\t-p <kind>[:key=val,...] : add a phase to the schedule, run in"
+        " order and repeated" << std::endl;
+    std::cout << "\t    kinds: chase, stride, gather, stream, branchy, reuse" << std::endl;
+    std::cout << "\t    ws=<size>      working set (default 64M)" << std::endl;
+    std::cout << "\t    stride=<size>  stride, for stride phases (default 64)" << std::endl;
+    std::cout << "\t    hot=<size>     hot subset, for gather phases (default none)" << std::endl;
+    std::cout << "\t    hotfrac=<f>    fraction of gathers to the hot subset" << std::endl;
+    std::cout << "\t    taken=<p>      taken probability, for branchy phases (default 0.5)" << std::endl;
+    std::cout << "\t    loops=<size>@<w>+...  cycles chased with relative weights w,"
+        " for reuse phases (ws is their sum)" << std::endl;
+    std::cout << "\t    ms=<ms>        phase duration per round (default 1000)" << std::endl;
+    std::cout << "\t-n <num-threads> : worker threads, each with private data (default 1)"
+        << std::endl;
+    std::cout << "\t-t <seconds> : total run time, 0 to run forever (default 10)"
+        << std::endl;
+    std::cout << "\t-c : print the analytic miss curve of each phase and exit"
+        << std::endl;
+    std::cout << "\t-h : Print this help message" << std::endl;
+    std::cout << "Example: " << argv[0] << " -p chase:ws=8M,ms=500"
+        " -p gather:ws=256M,hot=4M,hotfrac=0.9 -p stream:ws=1G"
+        " -p reuse:loops=2M@0.7+48M@0.3 -n 4" << std::endl;
+}
+
+bool parsePhase(const std::string& spec, Phase& ph) {
+    ph.wsBytes = 64ul << 20;
+    ph.stride = LINE_BYTES;
+    ph.hotBytes = 0;
+    ph.hotFrac = 0.0;
+    ph.takenProb = 0.5;
+    ph.loopBytes.clear();
+    ph.loopWeights.clear();
+    ph.ms = 1000;
+
+    std::string kind = spec.substr(0, spec.find(':'));
+    const char** k = std::find(kindNames, kindNames + NUM_KINDS, kind);
+    if (k == kindNames + NUM_KINDS) return false;
+    ph.kind = (PhaseKind)(k - kindNames);
+
+    if (ph.kind == BRANCHY) ph.wsBytes = BRANCH_COND_BYTES;
+    if (spec.find(':') == std::string::npos) return ph.kind != REUSE;
+    std::stringstream ss(spec.substr(spec.find(':') + 1));
+    std::string kv;
+    while (std::getline(ss, kv, ',')) {
+        size_t eq = kv.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = kv.substr(0, eq);
+        std::string val = kv.substr(eq + 1);
+        if (key == "ws") {
+            if (ph.kind != BRANCHY && ph.kind != REUSE) ph.wsBytes = parseSize(val);
+        }
+        else if (key == "stride") ph.stride = parseSize(val);
+        else if (key == "hot") ph.hotBytes = parseSize(val);
+        else if (key == "hotfrac") ph.hotFrac = atof(val.c_str());
+        else if (key == "taken") ph.takenProb = atof(val.c_str());
+        else if (key == "ms") ph.ms = atoll(val.c_str());
+        else if (key == "loops") {
+            std::stringstream ls(val);
+            std::string loop;
+            while (std::getline(ls, loop, '+')) {
+                size_t at = loop.find('@');
+                if (at == std::string::npos) return false;
+                size_t bytes = parseSize(loop.substr(0, at));
+                double w = atof(loop.substr(at + 1).c_str());
+                if (bytes < LINE_BYTES || w <= 0.0) return false;
+                ph.loopBytes.push_back(bytes / LINE_BYTES * LINE_BYTES);
+                ph.loopWeights.push_back(w);
+            }
+        }
+        else return false;
+    }
+
+    if (ph.kind == REUSE) {
+        if (ph.loopBytes.empty()) return false;
+        double total = 0.0;
+        for (double w : ph.loopWeights) total += w;
+        for (double& w : ph.loopWeights) w /= total;
+        ph.wsBytes = 0;
+        for (size_t b : ph.loopBytes) ph.wsBytes += b;
+    }
+
+    return ph.wsBytes >= LINE_BYTES && ph.stride >= sizeof(uint64_t) &&
+        ph.hotBytes < ph.wsBytes && ph.hotFrac >= 0.0 && ph.hotFrac <= 1.0 &&
+        ph.takenProb >= 0.0 && ph.takenProb <= 1.0 && ph.ms > 0;
+}
+
+// Che's approximation for LRU under independent references: a line with
+// reference probability p stays cached for T references after its last use,
+// so it hits with probability 1 - exp(-p T), where T fills the cache:
+// sum over lines of 1 - exp(-p T) = cacheLines. Class i has lines[i] lines
+// of probability probs[i] each. Exact for a single class.
+double cheMissRatio(const double* lines, const double* probs, int classes,
+                    double cacheLines) {
+    auto occupancy = [&](double t) {
+        double occ = 0.0;
+        for (int i = 0; i < classes; i++)
+            if (probs[i] > 0.0) occ += lines[i] * (1.0 - std::exp(-probs[i] * t));
+        return occ;
+    };
+    double reachable = 0.0;
+    for (int i = 0; i < classes; i++) if (probs[i] > 0.0) reachable += lines[i];
+    if (cacheLines >= reachable) return 0.0;
+
+    double lo = 0.0, hi = 1.0;
+    while (occupancy(hi) < cacheLines) hi *= 2.0;
+    for (int iter = 0; iter < 100; iter++) {
+        double mid = (lo + hi) / 2.0;
+        if (occupancy(mid) < cacheLines) lo = mid;
+        else hi = mid;
+    }
+    double miss = 0.0;
+    for (int i = 0; i < classes; i++)
+        miss += lines[i] * probs[i] * std::exp(-probs[i] * lo);
+    return miss;
+}
+
+// LRU stack distance, in lines, of each loop of a reuse phase. While loop k
+// goes around once (s_k / w_k loads), loop j touches min(s_j, s_k w_j / w_k)
+// distinct lines, so every reuse in loop k has stack distance
+// s_k + sum over j != k of min(s_j, s_k w_j / w_k), up to sampling noise.
+std::vector<double> reuseDistances(const Phase& ph) {
+    std::vector<double> dists;
+    for (size_t k = 0; k < ph.loopBytes.size(); k++) {
+        double sk = (double)(ph.loopBytes[k] / LINE_BYTES);
+        double d = sk;
+        for (size_t j = 0; j < ph.loopBytes.size(); j++) {
+            if (j == k) continue;
+            double sj = (double)(ph.loopBytes[j] / LINE_BYTES);
+            d += std::min(sj, sk * ph.loopWeights[j] / ph.loopWeights[k]);
+        }
+        dists.push_back(d);
+    }
+    return dists;
+}
+
+// Misses per memory access of a phase in a fully-associative LRU cache of
+// cacheBytes, at cache-line granularity
+double missRatio(const Phase& ph, size_t cacheBytes) {
+    double c = (double)cacheBytes;
+    double ws = (double)ph.wsBytes;
+    switch (ph.kind) {
+        case CHASE:
+            // Cyclic: LRU either holds the whole cycle or misses every time
+            return c >= ws ? 0.0 : 1.0;
+        case STRIDE: {
+            double perLine = std::max(1.0, (double)LINE_BYTES / ph.stride);
+            double footprint = ph.stride >= LINE_BYTES ?
+                ws / ph.stride * LINE_BYTES : ws;
+            return c >= footprint ? 0.0 : 1.0 / perLine;
+        }
+        case GATHER: {
+            // Independent references: a uniform set of W lines hits C/W of
+            // the time, and Che's approximation reduces to that. Hot/cold
+            // gathers are two classes of lines, which Che approximates
+            // closely but not exactly.
+            if (ph.hotBytes == 0) return std::max(0.0, 1.0 - c / ws);
+            double lines[2] = { (double)(ph.hotBytes / LINE_BYTES),
+                                (double)((ph.wsBytes - ph.hotBytes) / LINE_BYTES) };
+            double probs[2] = { ph.hotFrac / lines[0],
+                                (1.0 - ph.hotFrac) / lines[1] };
+            return cheMissRatio(lines, probs, 2, c / LINE_BYTES);
+        }
+        case STREAM:
+            // Cyclic over src and dst, one miss per line
+            return c >= ws ? 0.0 : (double)sizeof(uint64_t) / LINE_BYTES;
+        case BRANCHY:
+            return c >= BRANCH_COND_BYTES ? 0.0 : 1.0 / LINE_BYTES;
+        case REUSE: {
+            // A step of loop k's weight at each loop's stack distance
+            std::vector<double> dists = reuseDistances(ph);
+            double miss = 0.0;
+            for (size_t k = 0; k < dists.size(); k++)
+                if (dists[k] > c / LINE_BYTES) miss += ph.loopWeights[k];
+            return miss;
+        }
+    }
+    return 0.0;
+}
+
+void printMissCurves(const std::vector<Phase>& phases) {
+    for (size_t i = 0; i < phases.size(); i++) {
+        const Phase& ph = phases[i];
+        std::cout << "Phase " << i << " (" << kindNames[ph.kind] << ", ws "
+            << (ph.wsBytes >> 10) << " kB)";
+        if (ph.kind == BRANCHY)
+            std::cout << " mispredict ratio "
+                << std::min(ph.takenProb, 1.0 - ph.takenProb);
+        if (ph.kind == GATHER && ph.hotBytes > 0)
+            std::cout << " Che's approximation";
+        if (ph.kind == REUSE) {
+            std::vector<double> dists = reuseDistances(ph);
+            std::cout << " stack distances";
+            for (size_t k = 0; k < dists.size(); k++)
+                std::cout << " " << (size_t)(dists[k] * LINE_BYTES) / 1024 << "kB@"
+                    << ph.loopWeights[k];
+        }
+        std::cout << std::endl << "\tcache-kB\tmiss-ratio" << std::endl;
+        size_t maxBytes = std::max(ph.wsBytes, BRANCH_COND_BYTES) * 2;
+        for (size_t c = 64 * 1024; c <= maxBytes; c *= 2)
+            std::cout << "\t" << (c >> 10) << "\t\t" << missRatio(ph, c) << std::endl;
+    }
+}
+
+// Return ns
+uint64_t now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+// Per-thread, per-phase data
+struct PhaseData {
+    Line* lines;
+    Line* chasePos;
+    uint8_t* bytes;
+    uint64_t* src;
+    uint64_t* dst;
+    Line** loopPos;
+    uint64_t* loopThresholds;
+    size_t elems;
+    size_t pos;
+};
+
+void* allocLines(size_t bytes) {
+    void* p = NULL;
+    if (posix_memalign(&p, 2ul << 20, bytes) != 0) {
+        std::cerr << "Could not allocate " << bytes << " bytes" << std::endl;
+        exit(-1);
+    }
+    memset(p, 0, bytes);
+    return p;
+}
+
+PhaseData setupPhase(const Phase& ph, uint64_t seed) {
+    PhaseData d;
+    memset(&d, 0, sizeof(d));
+    switch (ph.kind) {
+        case CHASE:
+            d.elems = ph.wsBytes / LINE_BYTES;
+            d.lines = static_cast<Line*>(allocLines(d.elems * LINE_BYTES));
+            buildCycle(d.lines, d.elems, seed);
+            d.chasePos = d.lines;
+            break;
+        case STRIDE:
+            d.bytes = static_cast<uint8_t*>(allocLines(ph.wsBytes));
+            break;
+        case GATHER:
+            d.elems = ph.wsBytes / sizeof(uint64_t);
+            d.src = static_cast<uint64_t*>(allocLines(ph.wsBytes));
+            break;
+        case STREAM:
+            d.elems = ph.wsBytes / 2 / sizeof(uint64_t);
+            d.src = static_cast<uint64_t*>(allocLines(d.elems * sizeof(uint64_t)));
+            d.dst = static_cast<uint64_t*>(allocLines(d.elems * sizeof(uint64_t)));
+            break;
+        case BRANCHY:
+            d.elems = BRANCH_COND_BYTES;
+            d.bytes = static_cast<uint8_t*>(allocLines(d.elems));
+            fillBranches(d.bytes, d.elems, ph.takenProb, seed);
+            break;
+        case REUSE: {
+            // Each loop is its own cycle in one shared allocation
+            size_t loops = ph.loopBytes.size();
+            d.lines = static_cast<Line*>(allocLines(ph.wsBytes));
+            d.loopPos = new Line*[loops];
+            d.loopThresholds = new uint64_t[loops];
+            Line* base = d.lines;
+            double cum = 0.0;
+            for (size_t k = 0; k < loops; k++) {
+                size_t n = ph.loopBytes[k] / LINE_BYTES;
+                buildCycle(base, n, seed + k);
+                d.loopPos[k] = base;
+                base += n;
+                cum += ph.loopWeights[k];
+                d.loopThresholds[k] = k + 1 == loops ? UINT64_MAX :
+                    (uint64_t)(std::min(cum, 1.0) * (double)UINT64_MAX);
+            }
+            break;
+        }
+    }
+    return d;
+}
+
+std::atomic<bool> stop(false);
+std::atomic<int> ready(0);
+std::atomic<uint64_t> sink(0);
+
+void worker(int tid, const std::vector<Phase>* phases,
+            std::vector<PhaseStats>* stats) {
+    const uint64_t CHUNK = 4096;
+    std::vector<PhaseData> data;
+    for (size_t i = 0; i < phases->size(); i++)
+        data.push_back(setupPhase((*phases)[i], 1 + tid * 1000 + i));
+    XorShift rng(tid + 1);
+    uint64_t acc = 0;
+    ++ready;
+
+    while (!stop) {
+        for (size_t i = 0; i < phases->size() && !stop; i++) {
+            const Phase& ph = (*phases)[i];
+            PhaseData& d = data[i];
+            uint64_t start = now();
+            uint64_t deadline = start + ph.ms * 1000000ul;
+            uint64_t ops = 0;
+            uint64_t t = start;
+            while (t < deadline && !stop) {
+                switch (ph.kind) {
+                    case CHASE:
+                        acc += chase(&d.chasePos, CHUNK);
+                        break;
+                    case STRIDE:
+                        acc += strided(d.bytes, ph.wsBytes, ph.stride, &d.pos, CHUNK);
+                        break;
+                    case GATHER:
+                        acc += gather(d.src, d.elems, ph.hotBytes / sizeof(uint64_t),
+                                ph.hotFrac, rng, CHUNK);
+                        break;
+                    case STREAM:
+                        acc += stream(d.src, d.dst, d.elems, &d.pos, CHUNK);
+                        break;
+                    case BRANCHY:
+                        acc += branchy(d.bytes, d.elems, &d.pos, CHUNK);
+                        break;
+                    case REUSE:
+                        acc += reuse(d.loopPos, d.loopThresholds,
+                                ph.loopBytes.size(), rng, CHUNK);
+                        break;
+                }
+                ops += CHUNK;
+                t = now();
+            }
+            (*stats)[i].ops += ops;
+            (*stats)[i].ns += t - start;
+        }
+    }
+
+    sink += acc;
+}
+
+int main(int argc, char* argv[]) {
+    int c;
+    std::vector<Phase> phases;
+    int nthreads = 1;
+    uint64_t seconds = 10;
+    bool curves = false;
+
+    while ((c = getopt(argc, argv, ":p:n:t:ch")) != -1) {
+        switch(c) {
+            case 'p': {
+                Phase ph;
+                if (!parsePhase(optarg, ph)) {
+                    std::cerr << "Malformed phase " << optarg << std::endl;
+                    usage(argv);
+                    return -1;
+                }
+                phases.push_back(ph);
+                break;
+            }
+            case 'n':
+                nthreads = atoi(optarg);
+                break;
+            case 't':
+                seconds = atoll(optarg);
+                break;
+            case 'c':
+                curves = true;
+                break;
+            case 'h':
+                usage(argv);
+                return 0;
+                break;
+            case '?':
+                usage(argv);
+                return -1;
+                break;
+            case ':':
+                usage(argv);
+                return -1;
+                break;
+        }
+    }
+
+    if (phases.empty() || nthreads <= 0) {
+        usage(argv);
+        return -1;
+    }
+
+    if (curves) {
+        printMissCurves(phases);
+        return 0;
+    }
+
+    std::vector<std::vector<PhaseStats> > stats(nthreads,
+            std::vector<PhaseStats>(phases.size(), PhaseStats{0, 0}));
+    std::vector<std::thread> thrs;
+    for (int i = 0; i < nthreads; i++)
+        thrs.emplace_back(std::thread(worker, i, &phases, &stats[i]));
+
+    // Setup can take a while for large working sets; don't count it
+    while (ready < nthreads) usleep(1000);
+
+    if (seconds > 0) {
+        sleep(seconds);
+        stop = true;
+    }
+
+    for (std::thread &thr : thrs) {
+        thr.join();
+    }
+
+    std::cout << "phase\tkind\tws-kB\tops\tns/op\tMops/s" << std::endl;
+    for (size_t i = 0; i < phases.size(); i++) {
+        uint64_t ops = 0, ns = 0;
+        for (int t = 0; t < nthreads; t++) {
+            ops += stats[t][i].ops;
+            ns += stats[t][i].ns;
+        }
+        double nsPerOp = ops ? (double)ns / ops : 0.0;
+        // ns is summed over threads, so this is the aggregate rate
+        double mops = ns ? (double)ops * nthreads / ns * 1e3 : 0.0;
+        std::cout << i << "\t" << kindNames[phases[i].kind] << "\t"
+            << (phases[i].wsBytes >> 10) << "\t" << ops << "\t"
+            << std::fixed << std::setprecision(2) << nsPerOp << "\t" << mops
+            << std::endl;
+    }
+
+    return 0;
+}
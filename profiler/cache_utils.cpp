@@ -21,8 +21,10 @@
  * You should have received a copy of the GNU General Public License along with
  * this program. If not, see <http://www.gnu.org/licenses/>.
  */
+#include <fstream>
 #include <sstream>
 #include <string>
+#include <unistd.h>
 #include <string.h>
 #include <iostream>
 #include "cache_utils.h"
@@ -33,6 +35,29 @@
 
 namespace cache_utils {
 
+size_t get_llc_size() {
+  long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (size > 0)
+    return (size_t)size;
+
+  // Some libcs don't report cache sizes; sysfs has them as e.g. "30720K"
+  std::ifstream sizeFile("/sys/devices/system/cpu/cpu0/cache/index3/size");
+  std::string sizeStr;
+  if (sizeFile >> sizeStr && !sizeStr.empty()) {
+    size_t mult = 1;
+    switch (sizeStr.back()) {
+      case 'K': mult = 1ul << 10; break;
+      case 'M': mult = 1ul << 20; break;
+    }
+    size_t val = std::strtoul(sizeStr.c_str(), nullptr, 10);
+    if (val > 0)
+      return val * mult;
+  }
+
+  LOG(WARNING) << "[DATAMIME-PROFILER] Could not detect LLC size, assuming 32 MB";
+  return 32ul << 20;
+}
+
 void share_all_cache_ways(int num_logical_cores, int cache_num_ways) { // Share all ways!
   CATController catCtrl(true);
   int numCos = catCtrl.getNumCos();
@@ -29,6 +29,9 @@ using namespace arma;
 
 namespace cache_utils {
 
+// Size of the last-level cache in bytes, from sysconf or sysfs
+size_t get_llc_size();
+
 // Cache sharing-partitioning utility functions, used heavily by KPart
 void share_all_cache_ways(int num_logical_cores, int cache_num_ways);
 
@@ -39,6 +39,12 @@
 #include <numa.h>
 #include <mutex>
 #include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <random>
+#include <vector>
+#include <time.h>
 #include "cmt.h"
 #include "cache_utils.h"
 #include "mrc.h"
@@ -66,7 +72,6 @@ using namespace cache_utils;
 bool monitorStartFlag(false);
 int monitorLen = 1; //estimate MRC IPC point every monitorLen phases
 bool firstMRCInvocation(true);
-int sampleSlicesIdx = -1;
 int numSamples = 0;
 int num_ways_to_sample = 7;
 
@@ -74,7 +79,6 @@ uint64_t mrc_warmup_interval;
 uint64_t mrc_profile_interval;
 uint64_t mrc_invoke_monitor_len;
 
-arma::cube allAppsCacheAssignments;
 // (row,col) = How many ways we are sampling <row> thread in <col> COS.
 arma::mat currentlySampling;
 arma::mat sampledMRCs;
@@ -107,16 +111,37 @@ struct ThreadInfo {
     arma::vec ipcCurveAvg;
     arma::mat ipcCurveEstimates;
 
+    // Confidence bounds of each column of mrcEstimates/ipcCurveEstimates
+    arma::mat mrcLower;
+    arma::mat mrcUpper;
+    arma::mat ipcLower;
+    arma::mat ipcUpper;
+
+    // Latest sample at each way count and the estimate it belongs to (-1 if
+    // never sampled). Recent ones plan the next sweep.
+    arma::vec knownMpki;
+    arma::vec knownIpc;
+    arma::vec knownEstIdx;
+
     int mrc_est_index;
     int p_sample_slices_idx;
 
+    // MRC sweep state (see fill_mrc_slots())
+    std::vector<int> mrcPointsLeft; // Way counts still to sample, descending
+    int mrcSlot = -1; // Slot holding this thread's exclusive ways, -1 if none
+    bool mrcWarmup = false; // Current phase only warms up a new or grown range
+    int mrcNumSamples = 0; // Valid entries in xPoints/yPoints this sweep
+
     // Logfiles
     // outfile = PMU performance counters + RMID counters with Intel CMT
     // mrc_outfile = MRC estimates
     // ipc_outfile = IPC estimates
+    // mrc_bounds_outfile, ipc_bounds_outfile = their confidence bounds
     FILE* outfile;
     FILE* mrc_outfile;
     FILE* ipc_outfile;
+    FILE* mrc_bounds_outfile;
+    FILE* ipc_bounds_outfile;
 
     int rmid; // Resource monitoring ID. Each logical processor is associated with
               // an RMID.
@@ -159,9 +184,13 @@ struct ThreadInfo {
         fflush(outfile);
         fflush(mrc_outfile);
         fflush(ipc_outfile);
+        fflush(mrc_bounds_outfile);
+        fflush(ipc_bounds_outfile);
         fclose(outfile);
         fclose(mrc_outfile);
         fclose(ipc_outfile);
+        fclose(mrc_bounds_outfile);
+        fclose(ipc_bounds_outfile);
     }
 
     std::string filter_events(const char* events);
@@ -185,29 +214,69 @@ ThymeArgs args;
 ThymeState state;
 
 int num_profiled_threads = 0;
-int thr_idx_profiled_global = 0; // start with thread 0, up to (computed)
-                                  // num_profiled_threads
 
-bool enable_array_scans;
-std::mutex enable_array_scans_m;
+// Up to MRC_MAX_SLOTS profiled threads sample their curves at once, each
+// holding an exclusive, contiguous range of ways. Slot 0 holds the lowest
+// ways (COS 1) and slot 1 the highest ways (COS 3); every other core and the
+// dummy threads share the ways in between (COS 2), so no profiled thread can
+// keep hitting on lines it left outside its range. Slots shrink toward their
+// end of the mask, so all classes stay contiguous as CAT requires and a range
+// never moves while it is being measured. A slot in the middle of the mask
+// could not shrink without leaving ways that no class pollutes.
+const int MRC_MAX_SLOTS = 2;
+const int MRC_SHARED_COS = 2;
+const int mrc_slot_cos[MRC_MAX_SLOTS] = {1, 3};
+int mrc_slot_tidx[MRC_MAX_SLOTS] = {-1, -1};
+int mrc_slot_ways[MRC_MAX_SLOTS] = {0, 0};
+std::deque<int> mrc_waiting; // Profiled threads waiting for a slot
+
+// The planner stops adding points once no way's estimated error exceeds this
+// fraction of the curve's range
+const double MRC_PLAN_TOLERANCE = 0.02;
+
+// Polluter (dummy) threads fill the ways not assigned to the profiled thread
+// while its MRC is sampled. Toggled by the master thread without locking, so
+// polluters never stall on the profiler.
+std::atomic<bool> enable_array_scans{false};
 std::atomic<int> num_scan_threads{0};
-std::atomic<int> scan_thread_tid;
 
-struct Elem {
-    int32_t val;
-} __attribute__ ((aligned (4)));
+struct ScanThreadArgs {
+    int tidx;
+    size_t footprint_bytes;
+    double bw_bytes_per_ns;  // 0 = unthrottled
+    std::atomic<int> tid{-1};
+};
 
-// The dummy thread will execute this function, scanning a very large array
-// such that it will quickly fill up the shared ways.
+struct ScanLine {
+    uint64_t val;
+    uint64_t pad[7];
+} __attribute__ ((aligned (64)));
+
+// Lines touched between checks of the enable flag and the bandwidth budget
+const size_t SCAN_CHUNK_LINES = 1024;
+
+static uint64_t scan_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+// The dummy thread will execute this function, touching every line of its
+// array in a random order such that it will quickly fill up the shared ways.
+// Random order defeats the prefetchers, so the fill rate is set by the
+// bandwidth target rather than by how well the sweep prefetches. Loads are
+// independent, so many misses are in flight at once.
 void *scan_array(void *arg) {
-    int tidx = *((int *) arg);
+    ScanThreadArgs* sargs = (ScanThreadArgs*) arg;
+    int tidx = sargs->tidx;
     int tid = gettid();
-    scan_thread_tid = tid;
     LOG(INFO) << "[DATAMIME-PROFILER] Dummy thread"
         << tidx
         << " (tid "
         << tid
-        << ") started";
+        << ") started, footprint "
+        << (sargs->footprint_bytes >> 10)
+        << " KB";
 
     // Important! Posix threads inherit signal masks from the spawning process.
     // Correct solution is to have the dummy thread ignore all signals.
@@ -223,21 +292,57 @@ void *scan_array(void *arg) {
         std::exit(1);
     }
 
-    // Atomically update number of of threads
+    // Huge pages keep the polluter from being bound on TLB misses
+    size_t num_lines = std::max(sargs->footprint_bytes / sizeof(ScanLine), SCAN_CHUNK_LINES);
+    size_t bytes = num_lines * sizeof(ScanLine);
+    void* mem = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        logger->fatal("[DATAMIME-PROFILER] Could not allocate %v bytes for dummy thread %v",
+                      bytes, tid);
+        std::exit(1);
+    }
+    madvise(mem, bytes, MADV_HUGEPAGE);
+    memset(mem, 0, bytes);
+    volatile ScanLine* array = (volatile ScanLine*) mem;
+
+    std::vector<uint32_t> order(num_lines);
+    for (size_t i = 0; i < num_lines; i++)
+        order[i] = i;
+    std::mt19937 rng(tid);
+    std::shuffle(order.begin(), order.end(), rng);
+
+    // Publish the tid only once the array is ready, so that the warmup
+    // period isn't spent setting up
+    sargs->tid = tid;
     num_scan_threads++;
 
-    size_t arrayElems = 32000 * 1024ul / sizeof(Elem); // traverse 32MB array
-    volatile Elem* array = new volatile Elem[arrayElems];
+    const double chunk_bytes = SCAN_CHUNK_LINES * sizeof(ScanLine);
+    uint64_t sum = 0;
+    size_t pos = 0;
+    uint64_t next_chunk_ns = 0;
     while (1) {
-        enable_array_scans_m.lock();
-        if (enable_array_scans) {
-            enable_array_scans_m.unlock();
-            for (int64_t i = 0; i < arrayElems; i++) {
-                array[i].val /= 5;
+        if (!enable_array_scans.load(std::memory_order_relaxed)) {
+            usleep(100);
+            next_chunk_ns = 0;
+            continue;
+        }
+
+        if (sargs->bw_bytes_per_ns > 0) {
+            uint64_t now = scan_now_ns();
+            if (next_chunk_ns == 0) next_chunk_ns = now;
+            while (now < next_chunk_ns) {
+                sched_yield();
+                now = scan_now_ns();
             }
+            next_chunk_ns += (uint64_t)(chunk_bytes / sargs->bw_bytes_per_ns);
         }
-        else
-            enable_array_scans_m.unlock();
+
+        for (size_t i = 0; i < SCAN_CHUNK_LINES; i++) {
+            sum += array[order[pos]].val;
+            if (++pos == num_lines) pos = 0;
+        }
+        array[order[pos]].val = sum;
     }
     return 0;
 }
@@ -343,118 +448,197 @@ void dump_ipc_estimates(ThreadInfo &tinfo) {
   }
 }
 
-void generate_profiling_plan(int cacheCapacity) {
-
-    arma::vec plan;
-    switch (cacheCapacity) {
-    // Modify "plan" if you want DynaWay to sample cache sizes differently
-    // Add cases if more/different cache capacities are passible
-    // Example: with 12 ways, the plan is to allocate the target thread
-    // 11->8->6->4->2->1 way(s). We interpolate data in between.
-    case 16:
-      plan = { 15, 15, 11, 7, 4, 2, 1 };
-      break;
-    case 15:
-      plan = { 14, 14, 10, 7, 4, 2, 1 };
-      break;
-    case 14:
-      plan = { 13, 13, 9, 6, 4, 2, 1 };
-      break;
-    case 13:
-      plan = { 12, 12, 9, 6, 4, 2, 1 };
-      break;
-    case 12:
-      plan = { 11, 11, 8, 6, 4, 2, 1 };
-      break;
-    case 11:
-      plan = { 10, 10, 8, 6, 4, 2, 1 };
-      break;
-    case 10:
-      plan = { 9, 9, 8, 6, 4, 2, 1 };
-      break;
-    case 9:
-      plan = { 8, 8, 6, 4, 3, 2, 1 };
-      break;
-    case 8:
-      plan = { 7, 7, 6, 4, 3, 2, 1 };
-      break;
-    case 7:
-      plan = { 6, 6, 5, 4, 3, 2, 1 };
-      break;
-    case 6:
-      plan = { 5, 5, 4, 3, 2, 1 };
-      break;
-    case 5:
-      plan = { 4, 4, 3, 2, 1 };
-      break;
-    case 4:
-      plan = { 3, 3, 2, 1 };
-      break;
-    case 3:
-      plan = { 2, 2, 1 };
-      break;
-    default:
-      LOG(ERROR) << "Invalid cache capacity passed to generate_profiling_plan().";
-      std::exit(1);
-    }
-
-    num_ways_to_sample = (int)plan.size();
-    LOG(INFO) << "[Partthyme] Num curve points to sample = " << num_ways_to_sample;
-
-    // Initialize data structures that depend on number of ways to sample
-    allAppsCacheAssignments = zeros<arma::cube>(2, state.cache_num_ways, num_ways_to_sample);
-    for (auto it : tid_map) {
-        ThreadInfo &tinfo = *(it.second);
-        tinfo.xPoints = arma::linspace<arma::vec>(0, 0, num_ways_to_sample);
-        tinfo.yPoints_ipc = arma::linspace<arma::vec>(0, 0, num_ways_to_sample);
-        tinfo.yPoints_mpki = arma::linspace<arma::vec>(0, 0, num_ways_to_sample);
+// Smooths and dumps the bounds of every estimate so far, one row per way and
+// a "lower upper" pair of columns per estimate. MRCs never increase with
+// ways and IPC curves never decrease, as in dump_mrc_estimates() and
+// dump_ipc_estimates().
+void dump_bounds(FILE *outfile, arma::mat &lower, arma::mat &upper, int numEst,
+                 bool decreasing) {
+  rewind(outfile);
+
+  for (int j = 0; j < numEst; j++) {
+    for (int i = 1; i < lower.n_rows; i++) {
+      if (decreasing) {
+        lower(i, j) = std::min(lower(i - 1, j), lower(i, j));
+        upper(i, j) = std::min(upper(i - 1, j), upper(i, j));
+      } else {
+        lower(i, j) = std::max(lower(i - 1, j), lower(i, j));
+        upper(i, j) = std::max(upper(i - 1, j), upper(i, j));
+      }
     }
+  }
 
+  for (int i = 0; i < lower.n_rows; i++) {
+    for (int j = 0; j < numEst; j++) {
+      fprintf(outfile, "%f %f ", lower(i, j), upper(i, j));
+    }
+    fprintf(outfile, "\n");
+  }
+}
 
-    int row = -1;
-    int idx = -1;
-    arma::mat A(2, cacheCapacity);
-    int sliceIdx = 0;
+// Bounds at every way in xx of a curve sampled at ascending xs. Between two
+// samples, the curve is assumed to stay between the straight line across the
+// gap and the extensions of the neighbouring segments, so the band is narrow
+// where the slope barely changes and wide around knees. Past the last sample
+// it spans the flat and the extended last segment.
+void curve_bounds(const arma::vec &xs, const arma::vec &ys, const arma::vec &xx,
+                  arma::vec &lower, arma::vec &upper) {
+    int n = (int)xs.n_elem;
+    lower.set_size(xx.n_elem);
+    upper.set_size(xx.n_elem);
+
+    auto slope = [&](int i) {
+        return (ys[i + 1] - ys[i]) / (xs[i + 1] - xs[i]);
+    };
+
+    for (arma::uword k = 0; k < xx.n_elem; k++) {
+        double w = xx[k];
+        std::vector<double> candidates;
+        if (n == 1) {
+            candidates.push_back(ys[0]);
+        } else if (w <= xs[0]) {
+            candidates.push_back(ys[0]);
+            candidates.push_back(ys[0] + slope(0) * (w - xs[0]));
+        } else if (w >= xs[n - 1]) {
+            candidates.push_back(ys[n - 1]);
+            candidates.push_back(ys[n - 1] + slope(n - 2) * (w - xs[n - 1]));
+        } else {
+            int i = 0;
+            while (xs[i + 1] < w)
+                i++;
+            candidates.push_back(ys[i] + slope(i) * (w - xs[i]));
+            if (w < xs[i + 1]) {
+                if (i > 0)
+                    candidates.push_back(ys[i] + slope(i - 1) * (w - xs[i]));
+                if (i + 2 < n)
+                    candidates.push_back(ys[i + 1] - slope(i + 1) * (xs[i + 1] - w));
+            }
+        }
+        lower[k] = *std::min_element(candidates.begin(), candidates.end());
+        upper[k] = *std::max_element(candidates.begin(), candidates.end());
+    }
+}
 
-    for (int s = 0; s < num_ways_to_sample; s++) {
-        // E.g.: if cache capacity = 6, plan = {5, 5, 4, 3, 2, 1};
-        int p = plan[s];           // e.g. 5 (ways being profiled for target app)
-        int r = cacheCapacity - p; // e.g. 1 (remaining ways for rest of apps)
+// Picks the way counts to sample in tinfo's next sweep, descending. The
+// sweep takes one warm-up phase plus one phase per point, and may use at most
+// args.mrc_phase_budget phases.
+//
+// The first sweep spreads coarse points evenly. Later sweeps look at the
+// curve formed by the latest samples of the last HIST_WINDOW_LENGTH sweeps.
+// They start from the largest and smallest ways and greedily add the way
+// that is predicted worst: the error of interpolating that curve between
+// the points picked so far, plus the width of its confidence band there.
+// Points thus gather around knees and skip flat regions, and different
+// sweeps fill in different ways of a knee. Planning stops early once every
+// way is within MRC_PLAN_TOLERANCE. Sampling the plan top-down keeps the
+// lines in the remaining ways, so picking points between sweeps costs no
+// extra warm-up phases.
+std::vector<int> plan_mrc_points(const ThreadInfo &tinfo) {
+    int W = state.cache_num_ways;
+    int maxPoints = std::min(args.mrc_phase_budget - 1, W - 1);
+    std::vector<int> points;
+
+    std::vector<double> kx, kMpki, kIpc;
+    for (int w = 1; w < W; w++) {
+        double estIdx = tinfo.knownEstIdx[w - 1];
+        if (estIdx >= 0 && estIdx >= tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH) {
+            kx.push_back(w);
+            kMpki.push_back(tinfo.knownMpki[w - 1]);
+            kIpc.push_back(tinfo.knownIpc[w - 1]);
+        }
+    }
 
-        row = 0;
-        idx = 0;
-        for (int i = 0; i < p; i++) {
-            A(row, idx) = 1;
-            idx++;
+    if (kx.size() < 2) {
+        for (int k = 0; k < maxPoints; k++) {
+            int p = (int)std::round((W - 1) - (double)(W - 2) * k / (maxPoints - 1));
+            if (points.empty() || p < points.back())
+                points.push_back(p);
         }
-        for (int i = 0; i < r; i++) {
-            A(row, idx) = 0;
-            idx++;
+        return points;
+    }
+
+    arma::vec knownX = arma::conv_to<arma::vec>::from(kx);
+    arma::vec knownY[2] = { arma::conv_to<arma::vec>::from(kMpki),
+                            arma::conv_to<arma::vec>::from(kIpc) };
+    arma::vec xx = arma::linspace<vec>(1, W - 1, W - 1);
+    arma::vec est[2], width[2];
+    double range[2];
+    for (int c = 0; c < 2; c++) {
+        arma::vec lower, upper;
+        curve_bounds(knownX, knownY[c], xx, lower, upper);
+        interp1(knownX, knownY[c], xx, est[c], "linear");
+        // Outside the known ways, hold the nearest known value
+        for (arma::uword k = 0; k < xx.n_elem; k++) {
+            if (xx[k] < knownX[0])
+                est[c][k] = knownY[c][0];
+            else if (xx[k] > knownX[knownX.n_elem - 1])
+                est[c][k] = knownY[c][knownX.n_elem - 1];
         }
-        //e.g. init: "1, 1, 1, 1, 1, 0"
+        width[c] = upper - lower;
+        range[c] = std::max(est[c].max() - est[c].min(), 1e-9);
+    }
 
-        row = 1;
-        idx = 0;
-        for (int i = 0; i < p; i++) {
-            A(row, idx) = 0;
-            idx++;
+    std::vector<bool> picked(W, false);
+    picked[1] = picked[W - 1] = true;
+    int numPicked = 2;
+    while (numPicked < maxPoints) {
+        std::vector<double> tx;
+        for (int w = 1; w < W; w++) {
+            if (picked[w])
+                tx.push_back(w);
         }
-        for (int i = 0; i < r; i++) {
-            A(row, idx) = 1;
-            idx++;
+        arma::vec px = arma::conv_to<arma::vec>::from(tx);
+
+        int best = -1;
+        double bestErr = 0.0;
+        for (int c = 0; c < 2; c++) {
+            arma::vec py = est[c].elem(arma::conv_to<arma::uvec>::from(px - 1));
+            arma::vec approx;
+            interp1(px, py, xx, approx, "linear", 0.0);
+            for (int w = 2; w < W - 1; w++) {
+                if (picked[w])
+                    continue;
+                double err = (std::abs(approx[w - 1] - est[c][w - 1]) +
+                              width[c][w - 1]) / range[c];
+                if (err > bestErr) {
+                    bestErr = err;
+                    best = w;
+                }
+            }
         }
-        //e.g. init: "1, 0, 0, 0, 0, 0"
 
-        allAppsCacheAssignments.slice(sliceIdx) = A;
-        sliceIdx++;
+        if (best == -1 || bestErr < MRC_PLAN_TOLERANCE)
+            break;
+        picked[best] = true;
+        numPicked++;
     }
 
-    if (cacheCapacity == 12) {
-        // workaround CAT bug with buckets 10,11 -- Broadwell 1540D processor specific bug
-        A = { { 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 },
-              { 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 } }; // 0:11, 1:1
-        allAppsCacheAssignments.slice(0) = A;
-        allAppsCacheAssignments.slice(1) = A;
+    for (int w = W - 1; w >= 1; w--) {
+        if (picked[w])
+            points.push_back(w);
+    }
+    return points;
+}
+
+void generate_profiling_plan(int cacheCapacity) {
+    if (cacheCapacity < 3) {
+        LOG(ERROR) << "Invalid cache capacity passed to generate_profiling_plan().";
+        std::exit(1);
+    }
+    if (args.mrc_phase_budget < 3) {
+        LOG(ERROR) << "MRC phase budget must allow a warm-up phase and two points.";
+        std::exit(1);
+    }
+
+    num_ways_to_sample = std::min(args.mrc_phase_budget - 1, cacheCapacity - 1);
+    LOG(INFO) << "[Partthyme] Max curve points to sample = " << num_ways_to_sample;
+
+    // Initialize data structures that depend on number of ways to sample
+    for (auto it : tid_map) {
+        ThreadInfo &tinfo = *(it.second);
+        tinfo.xPoints = arma::linspace<arma::vec>(0, 0, num_ways_to_sample);
+        tinfo.yPoints_ipc = arma::linspace<arma::vec>(0, 0, num_ways_to_sample);
+        tinfo.yPoints_mpki = arma::linspace<arma::vec>(0, 0, num_ways_to_sample);
     }
 }
 
@@ -468,75 +652,167 @@ uint32_t getCbm(const std::vector<int> &cbm_entries) {
 }
 
 
-void set_cacheways_to_cores(arma::mat C, int procIdxProfiled) {
-    // E.g.  C = {  {1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
-    //           {0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1} }; // 0:1, 1:11
-    std::string waysString;
-    int cosID, numWaysBeingSampled, status;
-    arma::mat cosMap = zeros<arma::mat>(C.n_rows, 2);
+ThreadInfo* thread_by_tidx(int tidx) {
+    for (auto it : tid_map) {
+        if (it.second->tidx == tidx)
+            return it.second;
+    }
+    return nullptr;
+}
+
+// Programs the CAT classes for the ways currently held by the MRC slots and
+// maps every core to its class
+void apply_mrc_slots() {
+    int W = state.cache_num_ways;
+    int low = mrc_slot_ways[0];
+    int high = mrc_slot_ways[1];
+
+    std::vector<int> slot_entries[MRC_MAX_SLOTS];
+    std::vector<int> shared_entries;
+    for (int j = 0; j < W; j++) {
+        if (j < low)
+            slot_entries[0].emplace_back(j);
+        else if (j >= W - high)
+            slot_entries[1].emplace_back(j);
+        else
+            shared_entries.emplace_back(j);
+    }
+
+    if (W == 12 && low == 11) {
+        // workaround CAT bug with buckets 10,11 -- Broadwell 1540D processor specific bug
+        slot_entries[0] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+        shared_entries = { 0 };
+    }
 
-    // cosID = 1 has the sampled way string,
-    // cosID = 2 should have the other way string with all remaining processes
-    // sharing these ways ..
     CATController catCtrl(true);
-    for (int c = 0; c < C.n_rows; c++) {
-        cosID = c + 1;
-        std::vector<int> cbm_entries;
-        numWaysBeingSampled = 0;
-        for (int j = 0; j < C.n_cols; j++) {
-            if (C(c, j) > 0) {
-                numWaysBeingSampled++;
-                cbm_entries.emplace_back(j);
-            }
-        }
-        catCtrl.setCbm(cosID, getCbm(cbm_entries));
-        //if(enableLogging){ printf("[INFO] Changing cache alloc for cos %d to %s ways. Status= %d \n", cosID, waysString.c_str(), status); }
-
-        //Indicate that this process is now sampling "x" number of cache ways
-        //currentlySampling[cosID] = numWaysBeingSampled;
-        cosMap(c, 0) = numWaysBeingSampled;
-        cosMap(c, 1) = 1;
-        if(enableLogging){
-            LOG(DEBUG) << "[Partthyme] Indicating that COS " << cosID
-            << " is now mapped to " << numWaysBeingSampled << " ways.";
+    catCtrl.setCbm(MRC_SHARED_COS, getCbm(shared_entries));
+    for (int s = 0; s < MRC_MAX_SLOTS; s++) {
+        if (mrc_slot_tidx[s] != -1)
+            catCtrl.setCbm(mrc_slot_cos[s], getCbm(slot_entries[s]));
+    }
+
+    // Everyone shares the remaining ways, except the cores of the threads
+    // holding a slot
+    std::vector<int> core_cos(state.num_logical_cores, MRC_SHARED_COS);
+    for (int s = 0; s < MRC_MAX_SLOTS; s++) {
+        if (mrc_slot_tidx[s] == -1)
+            continue;
+        ThreadInfo *tinfo = thread_by_tidx(mrc_slot_tidx[s]);
+        for (int c : tinfo->cores)
+            core_cos[c] = mrc_slot_cos[s];
+        currentlySampling(tinfo->tidx, 0) = mrc_slot_ways[s];
+        currentlySampling(tinfo->tidx, 1) = 1;
+    }
+
+    for (int procID = 0; procID < state.num_logical_cores; procID++) {
+        catCtrl.setCos(procID, core_cos[procID]);
+        if (enableLogging) {
+            LOG(DEBUG) << "[Partthyme] Changing CORE " << procID
+            << " map to COS " << core_cos[procID];
         }
     }
 
-    //Now map: (1) the profiled process (id: procIdxProfiled) to COS1,
-    cosID = 1; //Assumption: profiled process will be mapped to COS1
-    catCtrl.setCos(procIdxProfiled, cosID);
     if (enableLogging) {
-        LOG(DEBUG) << "[Partthyme] Changing CORE " << procIdxProfiled
-        << " map to COS " << cosID;
+        LOG(DEBUG) << "[Partthyme] Slot ways = " << low << ", " << high
+        << "; shared ways = " << shared_entries.size();
     }
+}
 
-    currentlySampling(procIdxProfiled, 0) =
-        cosMap(cosID-1, 0); //numWaysBeingSampled;
-    currentlySampling(procIdxProfiled, 1) = 1;
+// Ways neither slot holds, keeping at least one way for the shared class
+int free_mrc_ways() {
+    return state.cache_num_ways - 1 - mrc_slot_ways[0] - mrc_slot_ways[1];
+}
 
-    // (2) everyone else to COS2 to share the remaining ways
-    cosID = 2; //Assumption: rest of processes will be sharing cache ways in COS 2
+// Largest way count tinfo still has to sample that fits in ways, 0 if none
+int next_mrc_point(const ThreadInfo &tinfo, int ways) {
+    for (int p : tinfo.mrcPointsLeft) {
+        if (p <= ways)
+            return p;
+    }
+    return 0;
+}
 
-    for (int procID = 0; procID < state.num_logical_cores; procID++) {
-        if (procID == procIdxProfiled)
+// Hands free slots to waiting threads, in order. A thread starts at the
+// largest of its points that fits next to the other slot, and its first phase
+// only warms up the range. Returns whether any slot changed.
+bool fill_mrc_slots() {
+    bool changed = false;
+    for (int s = 0; s < args.mrc_concurrency; s++) {
+        if (mrc_slot_tidx[s] != -1)
             continue;
-
-        catCtrl.setCos(procID, cosID);
-        if(enableLogging) {
-            LOG(DEBUG) << "[Partthyme] Changing CORE " << procID
-            << " map to COS " << cosID;
+        for (auto it = mrc_waiting.begin(); it != mrc_waiting.end(); ++it) {
+            ThreadInfo &tinfo = *thread_by_tidx(*it);
+            int p = next_mrc_point(tinfo, free_mrc_ways());
+            if (p == 0)
+                continue;
+            mrc_slot_tidx[s] = tinfo.tidx;
+            mrc_slot_ways[s] = p;
+            tinfo.mrcSlot = s;
+            tinfo.mrcWarmup = true;
+            mrc_waiting.erase(it);
+            changed = true;
+            if (enableLogging) {
+                LOG(DEBUG) << "[DATAMIME-PROFILER] Thread " << tinfo.tidx
+                    << " starts sampling in slot " << s << " with " << p << " ways";
+            }
+            break;
         }
+    }
+    return changed;
+}
 
-        //Indicate that this process is now sampling "x" number of cache ways
-        currentlySampling(procID, 0) = cosMap(cosID-1, 0); //numWaysBeingSampled;
-        currentlySampling(procID, 1) = 1;
-        if(enableLogging){
-            LOG(DEBUG) << "[Partthyme] Indicating that pid " << procID
-            << " is now sampling " << numWaysBeingSampled << " ways.";
-        }
+void release_mrc_slot(ThreadInfo &tinfo) {
+    mrc_slot_tidx[tinfo.mrcSlot] = -1;
+    mrc_slot_ways[tinfo.mrcSlot] = 0;
+    tinfo.mrcSlot = -1;
+}
+
+// Moves tinfo to its next point after it sampled the current one. Shrinking
+// in place keeps the lines in the remaining ways, so it needs no warm-up;
+// growing does. If the next point doesn't fit next to the other slot, the
+// thread gives up its slot and waits for one at the head of the queue.
+void advance_mrc_slot(ThreadInfo &tinfo) {
+    int held = mrc_slot_ways[tinfo.mrcSlot];
+    int p = next_mrc_point(tinfo, held);
+    if (p > 0) {
+        mrc_slot_ways[tinfo.mrcSlot] = p;
+        return;
+    }
+
+    p = next_mrc_point(tinfo, held + free_mrc_ways());
+    if (p > 0) {
+        mrc_slot_ways[tinfo.mrcSlot] = p;
+        tinfo.mrcWarmup = true;
+        return;
     }
+
+    release_mrc_slot(tinfo);
+    mrc_waiting.push_front(tinfo.tidx);
 }
 
+// Queues every profiled thread for a new sweep over all plan points
+void start_mrc_sweep() {
+    mrc_waiting.clear();
+    for (int s = 0; s < MRC_MAX_SLOTS; s++) {
+        mrc_slot_tidx[s] = -1;
+        mrc_slot_ways[s] = 0;
+    }
+    loggingMRCFlags.zeros();
+
+    for (int t = 0; t < num_profiled_threads; t++) {
+        ThreadInfo *tinfo = thread_by_tidx(t);
+        if (!tinfo)
+            continue;
+        tinfo->mrcPointsLeft = plan_mrc_points(*tinfo);
+        tinfo->mrcSlot = -1;
+        tinfo->mrcWarmup = false;
+        tinfo->mrcNumSamples = 0;
+        mrc_waiting.push_back(t);
+    }
+
+    fill_mrc_slots();
+    apply_mrc_slots();
+}
 
 std::vector<int> parse_cpuset(const cpu_set_t *cpuset) {
     std::vector<int> cores;
@@ -729,8 +1005,8 @@ void sigthyme_handler(int n, siginfo_t* info, void* vsc) {
         tinfo.lastMemTrafficCtr = tinfo.memTrafficTotal;
         if (tinfo.tidx == 0 && (tinfo.phases < args.num_phases)) { //Master
             if (enableLogging) {
-                LOG(DEBUG) << "\n[DATAMIME-PROFILER] Master thread invokes beginning of profiling for "
-                              "PROC " << thr_idx_profiled_global << ", PHASE " << tinfo.phases;
+                LOG(DEBUG) << "\n[DATAMIME-PROFILER] Master thread invokes beginning of profiling, "
+                              "PHASE " << tinfo.phases;
             }
 
             if (firstMRCInvocation) {
@@ -738,23 +1014,26 @@ void sigthyme_handler(int n, siginfo_t* info, void* vsc) {
                 firstMRCInvocation = false;
             }
 
-            // Start dummy thread(s)
-            LOG(INFO) << "[DATAMIME-PROFILER] Starting dummy thread to fill up shared ways\n";
-            enable_array_scans_m.lock();
-            enable_array_scans = true;
-            enable_array_scans_m.unlock();
-
-            monitorStartFlag = true;
-            sampleSlicesIdx = 0;
-            arma::mat C = allAppsCacheAssignments.slice(sampleSlicesIdx);
-            //Slice has all cache assignments in a form of a matrix
-            //Each row in the matrix corresponds to a given COS assignment
+            if (monitorStartFlag) {
+                // Let the running sweep finish instead of restarting it
+                LOG(DEBUG) << "[DATAMIME-PROFILER] Previous MRC sweep still running";
+            } else {
+                // Start dummy thread(s)
+                LOG(INFO) << "[DATAMIME-PROFILER] Starting dummy thread to fill up shared ways\n";
+                enable_array_scans.store(true, std::memory_order_relaxed);
 
-            set_cacheways_to_cores(C, thr_idx_profiled_global);
-            sampleSlicesIdx++;
+                monitorStartFlag = true;
+                start_mrc_sweep();
+            }
         }
+    } else if (monitorStartFlag && (tinfo.phases % monitorLen == 0) && tinfo.mrcSlot == -1) {
+        // Waiting for a slot (or done with this sweep)
+        tinfo.lastCyclesCtr = tinfo.values[2];
+        tinfo.lastInstrCtr = tinfo.values[1];
+        tinfo.lastMemTrafficCtr = tinfo.memTrafficTotal;
     } else if (monitorStartFlag && (tinfo.phases % monitorLen == 0)) {
-        tinfo.xPoints[(sampleSlicesIdx - 1)] = currentlySampling(tinfo.tidx, 0);
+        int slot = tinfo.mrcSlot;
+        bool sampled = false;
 
         //BUG: APM8 w/onlineProf: sometimes counters don't get updated even though
         //process moved to next phase!
@@ -767,176 +1046,184 @@ void sigthyme_handler(int n, siginfo_t* info, void* vsc) {
                 << ", tinfo.values[1] (instr) = " << (double)tinfo.values[1]
                 << ", tinfo.values[2] (cycles) = " << (double)tinfo.values[2];
             currentlySampling(tinfo.tidx, 1) = 5; //Mark as incomplete with error ..
+        } else if (tinfo.mrcWarmup) { //Range was new or grown, discard this phase
+            tinfo.mrcWarmup = false;
         } else { //Collect counters and mark as collected
-            tinfo.yPoints_ipc[(sampleSlicesIdx - 1)] =
+            int n = tinfo.mrcNumSamples;
+            tinfo.xPoints[n] = mrc_slot_ways[slot];
+            tinfo.yPoints_ipc[n] =
                 (double)(tinfo.values[1] - tinfo.lastInstrCtr) /
                 (double)(tinfo.values[2] - tinfo.lastCyclesCtr);
                 double misses = (double)(tinfo.memTrafficTotal -
                                      tinfo.lastMemTrafficCtr) / state.cache_line_size;
-            tinfo.yPoints_mpki[(sampleSlicesIdx - 1)] =
+            tinfo.yPoints_mpki[n] =
                 misses * 1000 / (tinfo.values[1] - tinfo.lastInstrCtr);
+            tinfo.mrcNumSamples++;
+            tinfo.mrcPointsLeft.erase(std::find(tinfo.mrcPointsLeft.begin(),
+                tinfo.mrcPointsLeft.end(), mrc_slot_ways[slot]));
             currentlySampling(tinfo.tidx, 1) = 0; //Collected, mark as completed!
+            sampled = true;
         }
 
         tinfo.lastCyclesCtr = tinfo.values[2];
         tinfo.lastInstrCtr = tinfo.values[1];
         tinfo.lastMemTrafficCtr = tinfo.memTrafficTotal;
 
-        if (enableLogging) {
+        if (enableLogging && sampled) {
             LOG(DEBUG) << "[DATAMIME-PROFILER] tinfo.tidx = " << tinfo.tidx
                 << ", tinfo.phases = " << tinfo.phases
-                << ", sampledWays = " << tinfo.xPoints[(sampleSlicesIdx - 1)]
-                << ", sampledIPC = " << tinfo.yPoints_ipc[(sampleSlicesIdx - 1)]
-                << ", sampledMPKI = " << tinfo.yPoints_mpki[(sampleSlicesIdx - 1)];
+                << ", sampledWays = " << tinfo.xPoints[tinfo.mrcNumSamples - 1]
+                << ", sampledIPC = " << tinfo.yPoints_ipc[tinfo.mrcNumSamples - 1]
+                << ", sampledMPKI = " << tinfo.yPoints_mpki[tinfo.mrcNumSamples - 1];
         }
 
-        if (sampleSlicesIdx == num_ways_to_sample && currentlySampling(tinfo.tidx, 1) != 5) {
-            // Use collected MRC samples to estimate MRC only for one profiled process
-            if (tinfo.tidx == thr_idx_profiled_global) {
-                if (loggingMRCFlags(tinfo.tidx, 0) < 1) { //If this proc hasn't logged yet, log MRC
-                    if (enableLogging)
-                        LOG(DEBUG) << "[In Thread " << tinfo.tidx << " - DONE SAMPLING]";
-
-                    //Print xpoints and ypoints then interpolate to derive linear function
-                    arma::vec xx = arma::linspace<vec>(1, state.cache_num_ways, state.cache_num_ways);
-                    arma::vec yyMrc = tinfo.mrcEstimates.col(tinfo.mrc_est_index);
-                    arma::vec yyIpc = tinfo.ipcCurveEstimates.col(tinfo.mrc_est_index);
-
-                    // Need to ignore the first reading because it's only warmup period
-                    // Consider the second reading only
-                    tinfo.xPoints.at(0) = tinfo.xPoints.at(1);
-                    tinfo.yPoints_mpki.at(0) = tinfo.yPoints_mpki.at(1);
-                    tinfo.yPoints_ipc.at(0) = tinfo.yPoints_ipc.at(1);
-
-                    // Interpolate to estimate the remaining points on the curves
-                    interp1(tinfo.xPoints, tinfo.yPoints_mpki, xx, yyMrc, "linear");
-                    interp1(tinfo.xPoints, tinfo.yPoints_ipc, xx, yyIpc, "linear");
-
-                    tinfo.mrcEstimates.col(tinfo.mrc_est_index) = yyMrc;
-                    tinfo.mrcEstimates.col(tinfo.mrc_est_index)[(state.cache_num_ways - 1)] =
-                        tinfo.mrcEstimates.col(tinfo.mrc_est_index)[(state.cache_num_ways - 2)];
-
-                    tinfo.ipcCurveEstimates.col(tinfo.mrc_est_index) = yyIpc;
-                    tinfo.ipcCurveEstimates.col(tinfo.mrc_est_index)[(state.cache_num_ways - 1)] =
-                        tinfo.ipcCurveEstimates.col(tinfo.mrc_est_index)[(state.cache_num_ways - 2)];
-
-                    //Dump estimates to file to analyze later
-                    dump_mrc_estimates(tinfo);
-                    dump_ipc_estimates(tinfo);
-
-                    loggingMRCFlags(tinfo.tidx, 0) = 1;
-
-                    int startCol = std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH));
-                    int endCol = tinfo.mrc_est_index;
-                    double sum, count, avg;
-
-                    //calc avg MRC curves
-                    for (int w = 0; w < state.cache_num_ways; w++) {
-                        sum = 0.0;
-                        count = 0.0;
-                        avg = 0.0;
-                        for (int j = startCol; j <= endCol; j++) {
-                            sum += tinfo.mrcEstimates(w, j);
-                            count++;
-                        }
-                        avg = sum / count;
-                        tinfo.mrcEstAvg[w] = avg;
-                    }
+        if (sampled && tinfo.mrcPointsLeft.empty()) {
+            // All points of this thread's curve are sampled
+            if (loggingMRCFlags(tinfo.tidx, 0) < 1) { //If this proc hasn't logged yet, log MRC
+                if (enableLogging)
+                    LOG(DEBUG) << "[In Thread " << tinfo.tidx << " - DONE SAMPLING]";
+
+                //Print xpoints and ypoints then interpolate to derive linear function
+                arma::vec xx = arma::linspace<vec>(1, state.cache_num_ways, state.cache_num_ways);
+                arma::vec yyMrc = tinfo.mrcEstimates.col(tinfo.mrc_est_index);
+                arma::vec yyIpc = tinfo.ipcCurveEstimates.col(tinfo.mrc_est_index);
+
+                // Points were sampled in schedule order; sort them by ways
+                int n = tinfo.mrcNumSamples;
+                arma::uvec order = arma::sort_index(tinfo.xPoints.head(n));
+                arma::vec xs = tinfo.xPoints.elem(order);
+                arma::vec ysMpki = tinfo.yPoints_mpki.elem(order);
+                arma::vec ysIpc = tinfo.yPoints_ipc.elem(order);
+
+                // Interpolate to estimate the remaining points on the curves
+                interp1(xs, ysMpki, xx, yyMrc, "linear");
+                interp1(xs, ysIpc, xx, yyIpc, "linear");
+
+                arma::vec lower, upper;
+                curve_bounds(xs, ysMpki, xx, lower, upper);
+                tinfo.mrcLower.col(tinfo.mrc_est_index) = lower;
+                tinfo.mrcUpper.col(tinfo.mrc_est_index) = upper;
+                curve_bounds(xs, ysIpc, xx, lower, upper);
+                tinfo.ipcLower.col(tinfo.mrc_est_index) = lower;
+                tinfo.ipcUpper.col(tinfo.mrc_est_index) = upper;
+
+                // Later sweeps plan their points from these
+                for (int i = 0; i < n; i++) {
+                    int w = (int)xs[i];
+                    tinfo.knownMpki[w - 1] = ysMpki[i];
+                    tinfo.knownIpc[w - 1] = ysIpc[i];
+                    tinfo.knownEstIdx[w - 1] = tinfo.mrc_est_index;
+                }
 
-                    //calc avg IPC curves
-                    for (int w = 0; w < state.cache_num_ways; w++) {
-                        sum = 0.0;
-                        count = 0.0;
-                        avg = 0.0;
-                        for (int j = startCol; j <= endCol; j++) {
-                            sum += tinfo.ipcCurveEstimates(w, j);
-                            count++;
-                        }
-                        avg = sum / count;
-                        tinfo.ipcCurveAvg[w] = avg;
+                tinfo.mrcEstimates.col(tinfo.mrc_est_index) = yyMrc;
+                tinfo.mrcEstimates.col(tinfo.mrc_est_index)[(state.cache_num_ways - 1)] =
+                    tinfo.mrcEstimates.col(tinfo.mrc_est_index)[(state.cache_num_ways - 2)];
+
+                tinfo.ipcCurveEstimates.col(tinfo.mrc_est_index) = yyIpc;
+                tinfo.ipcCurveEstimates.col(tinfo.mrc_est_index)[(state.cache_num_ways - 1)] =
+                    tinfo.ipcCurveEstimates.col(tinfo.mrc_est_index)[(state.cache_num_ways - 2)];
+
+                //Dump estimates to file to analyze later
+                dump_mrc_estimates(tinfo);
+                dump_ipc_estimates(tinfo);
+                dump_bounds(tinfo.mrc_bounds_outfile, tinfo.mrcLower, tinfo.mrcUpper,
+                            tinfo.mrc_est_index + 1, true);
+                dump_bounds(tinfo.ipc_bounds_outfile, tinfo.ipcLower, tinfo.ipcUpper,
+                            tinfo.mrc_est_index + 1, false);
+
+                loggingMRCFlags(tinfo.tidx, 0) = 1;
+
+                int startCol = std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH));
+                int endCol = tinfo.mrc_est_index;
+                double sum, count, avg;
+
+                //calc avg MRC curves
+                for (int w = 0; w < state.cache_num_ways; w++) {
+                    sum = 0.0;
+                    count = 0.0;
+                    avg = 0.0;
+                    for (int j = startCol; j <= endCol; j++) {
+                        sum += tinfo.mrcEstimates(w, j);
+                        count++;
                     }
+                    avg = sum / count;
+                    tinfo.mrcEstAvg[w] = avg;
+                }
 
-                    // (FIXME) hrlee: Remove debug messages that I cannot easily
-                    // integrate into easylogging++ for now. Must be added back
-                    // in at later point.
-                    //if (enableLogging) {
-                    //    printf(" ---- tinfo.mrcEstimates() ---- \n");
-                    //    tinfo.mrcEstimates
-                    //        .cols(std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH)),
-                    //              tinfo.mrc_est_index).print();
-                    //    printf(" ---- tinfo.ipcCurveEstimates() ---- \n");
-                    //    tinfo.ipcCurveEstimates
-                    //        .cols(std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH)),
-                    //              tinfo.mrc_est_index).print();
-                    //} else {
-                        tinfo.mrcEstimates
-                            .cols(std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH)),
-                                  tinfo.mrc_est_index);
-                        tinfo.ipcCurveEstimates
-                            .cols(std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH)),
-                                  tinfo.mrc_est_index);
-                    //}
-
-                    tinfo.mrc_est_index++;
-
-                    //Store globally
-                    sampledMRCs.col(tinfo.tidx) = tinfo.mrcEstAvg;
-                    sampledIPCs.col(tinfo.tidx) = tinfo.ipcCurveAvg;
-
-                    /*
-                    if (enableLogging) {
-                        printf("\n -- sampledMRCs -- \n");
-                        sampledMRCs.print();
-
-                        printf("\n -- sampledIPCs -- \n");
-                        sampledIPCs.print();
+                //calc avg IPC curves
+                for (int w = 0; w < state.cache_num_ways; w++) {
+                    sum = 0.0;
+                    count = 0.0;
+                    avg = 0.0;
+                    for (int j = startCol; j <= endCol; j++) {
+                        sum += tinfo.ipcCurveEstimates(w, j);
+                        count++;
                     }
-                    */
+                    avg = sum / count;
+                    tinfo.ipcCurveAvg[w] = avg;
+                }
 
-                } //end if(loggingMRCFlags(tinfo.tidx,0) < 1){  //If this proc hasn't
-                //logged yet, log MRC
+                // (FIXME) hrlee: Remove debug messages that I cannot easily
+                // integrate into easylogging++ for now. Must be added back
+                // in at later point.
+                //if (enableLogging) {
+                //    printf(" ---- tinfo.mrcEstimates() ---- \n");
+                //    tinfo.mrcEstimates
+                //        .cols(std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH)),
+                //              tinfo.mrc_est_index).print();
+                //    printf(" ---- tinfo.ipcCurveEstimates() ---- \n");
+                //    tinfo.ipcCurveEstimates
+                //        .cols(std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH)),
+                //              tinfo.mrc_est_index).print();
+                //} else {
+                    tinfo.mrcEstimates
+                        .cols(std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH)),
+                              tinfo.mrc_est_index);
+                    tinfo.ipcCurveEstimates
+                        .cols(std::max(0, (tinfo.mrc_est_index - state.HIST_WINDOW_LENGTH)),
+                              tinfo.mrc_est_index);
+                //}
 
-            } //end if( tinfo.tidx == thr_idx_profiled_global )
+                tinfo.mrc_est_index++;
 
-            if (loggingMRCFlags(thr_idx_profiled_global, 0) == 1) {
-                if (enableLogging)
-                    LOG(DEBUG) << "[INFO] Profiling done for PROC " << thr_idx_profiled_global;
-
-                loggingMRCFlags.zeros(); //= zeros<arma::vec>(state.num_logical_cores);
-                sampleSlicesIdx = 0;     //Start over
-                thr_idx_profiled_global++;
-
-                if (thr_idx_profiled_global >= num_profiled_threads) {
-                    thr_idx_profiled_global = 0;
-                    monitorStartFlag = false;
-                    LOG(INFO) << "[DATAMIME-PROFILER] Halting dummy thread to fill up shared ways";
-                    enable_array_scans_m.lock();
-                    enable_array_scans = false;
-                    enable_array_scans_m.unlock();
-                    cache_utils::share_all_cache_ways(state.num_logical_cores, state.cache_num_ways);
+                //Store globally
+                sampledMRCs.col(tinfo.tidx) = tinfo.mrcEstAvg;
+                sampledIPCs.col(tinfo.tidx) = tinfo.ipcCurveAvg;
+
+                /*
+                if (enableLogging) {
+                    printf("\n -- sampledMRCs -- \n");
+                    sampledMRCs.print();
+
+                    printf("\n -- sampledIPCs -- \n");
+                    sampledIPCs.print();
                 }
+                */
 
-            }
-        }          //end if( sampleSlicesIdx == numWaysToSample )
-        else { //get new allocated cache ways to sample
-            if (tinfo.tidx == thr_idx_profiled_global) {
-                //if (enableLogging) {
-                //  currentlySampling.print();
-                //}
-                if (currentlySampling(thr_idx_profiled_global, 1) == 0) { //profiled process done?
-                    if (enableLogging) {
-                        LOG(DEBUG) << "[DATAMIME-PROFILER] Master thread invokes NEXT profiling plan .";
-                    }
-                    arma::mat C = allAppsCacheAssignments.slice(sampleSlicesIdx);
-                    set_cacheways_to_cores(C, thr_idx_profiled_global);
-                    sampleSlicesIdx++;
-                } else {
-                    //Still some processes didn't collect MRC/IPC...
-                    LOG(DEBUG) << "[DATAMIME-PROFILER] Wait as some threads didn't collect their mrc/ipc samples";
+            } //end if(loggingMRCFlags(tinfo.tidx,0) < 1){  //If this proc hasn't
+            //logged yet, log MRC
+
+            if (enableLogging)
+                LOG(DEBUG) << "[INFO] Profiling done for PROC " << tinfo.tidx;
+            release_mrc_slot(tinfo);
+        } else if (sampled) { //get new allocated cache ways to sample
+            advance_mrc_slot(tinfo);
+        }
+
+        if (sampled) {
+            fill_mrc_slots();
+            if (mrc_waiting.empty() && mrc_slot_tidx[0] == -1 && mrc_slot_tidx[1] == -1) {
+                monitorStartFlag = false;
+                LOG(INFO) << "[DATAMIME-PROFILER] Halting dummy thread to fill up shared ways";
+                enable_array_scans.store(false, std::memory_order_relaxed);
+                cache_utils::share_all_cache_ways(state.num_logical_cores, state.cache_num_ways);
+            } else {
+                if (enableLogging) {
+                    LOG(DEBUG) << "[DATAMIME-PROFILER] Thread " << tinfo.tidx << " invokes NEXT profiling plan .";
                 }
+                apply_mrc_slots();
             }
         }
-
     }
 
     read_counters(tinfo, fd);
@@ -1220,6 +1507,18 @@ void usage(char* argv[]) {
     std::cout << "\t-t <comma-sep-tids> : must belong to same thread group" <<std::endl;
     std::cout << "\t-r <results_dir> : absolute path to results directory" \
         << std::endl;
+    std::cout << "\t-s <num_scan_threads> : dummy threads filling the"
+        " non-profiled ways during MRC estimation (default 1)" << std::endl;
+    std::cout << "\t-S <llc_multiple> : total dummy thread footprint, as a"
+        " multiple of the LLC size (default 2)" << std::endl;
+    std::cout << "\t-b <MB/s> : total dummy thread fill bandwidth target,"
+        " 0 for unthrottled (default 0)" << std::endl;
+    std::cout << "\t-B <phases> : MRC sampling phases per thread and sweep,"
+        " including one warm-up phase (default 7)" << std::endl;
+    std::cout << "\t-k <num_threads> : profiled threads whose MRCs are"
+        " sampled concurrently, 1 or 2 (default 1). Threads sharing data can"
+        " hit in each other's ways, so only use 2 for mostly private working"
+        " sets" << std::endl;
     std::cout << "\t-d : Enable debug output to datamime-profiler.log" <<std::endl;
     std::cout << "\t-m : enable MRC estimation mode. In this mode, user-given"
         " events will not be tracked." \
@@ -1232,7 +1531,7 @@ ThymeArgs parse_args(int argc, char* argv[]) {
     ThymeArgs args;
     int c;
     char *tids;
-    while ((c = getopt(argc, argv, "e:l:n:w:p:f:g:t:r:dmh")) != -1) {
+    while ((c = getopt(argc, argv, "e:l:n:w:p:f:g:t:r:s:S:b:k:B:dmh")) != -1) {
         switch(c) {
             case 'e':
                 args.events = optarg;
@@ -1261,6 +1560,21 @@ ThymeArgs parse_args(int argc, char* argv[]) {
             case 'r':
                 args.results_dir = optarg;
                 break;
+            case 's':
+                args.num_scan_threads = std::stoi(optarg);
+                break;
+            case 'S':
+                args.scan_llc_multiple = std::stod(optarg);
+                break;
+            case 'b':
+                args.scan_bw_mbps = std::stod(optarg);
+                break;
+            case 'k':
+                args.mrc_concurrency = std::stoi(optarg);
+                break;
+            case 'B':
+                args.mrc_phase_budget = std::stoi(optarg);
+                break;
             case 'd':
                 args.debug = true;
                 break;
@@ -1302,9 +1616,13 @@ void ThreadInfo::flush() {
     fflush(outfile);
     fflush(mrc_outfile);
     fflush(ipc_outfile);
+    fflush(mrc_bounds_outfile);
+    fflush(ipc_bounds_outfile);
     fclose(outfile);
     fclose(mrc_outfile);
     fclose(ipc_outfile);
+    fclose(mrc_bounds_outfile);
+    fclose(ipc_bounds_outfile);
 }
 
 void profile() {
@@ -1408,46 +1726,75 @@ int create_scan_threads(int cur_tidx) {
     enable_array_scans = false;
     num_scan_threads = 0;
 
-    pthread_t scan_thread;
-    int *arg = (int*)(malloc(sizeof(*arg)));
-    *arg = cur_tidx;
-
-    int tret = pthread_create(&scan_thread, NULL, scan_array, arg);
-    if (tret != 0) {
-        LOG(ERROR) << "Could not create dummy thread "
-            << cur_tidx
-            << ": return code from pthread_create()="
-            << tret;
+    int nthreads = args.num_scan_threads;
+    if (nthreads < 1 || nthreads + 1 > (int)state.assignable_cores.size()) {
+        LOG(ERROR) << "Cannot create " << nthreads << " dummy threads with "
+            << state.assignable_cores.size() << " assignable cores left";
         std::exit(1);
     }
 
+    // Split the footprint across polluters, so that the total stays a fixed
+    // multiple of the LLC regardless of the number of threads
+    size_t llc_bytes = cache_utils::get_llc_size();
+    size_t footprint = (size_t)(args.scan_llc_multiple * llc_bytes) / nthreads;
+    double bw = args.scan_bw_mbps * 1e6 / 1e9 / nthreads;
+    LOG(INFO) << "[DATAMIME-PROFILER] " << nthreads << " dummy thread(s), LLC "
+        << (llc_bytes >> 10) << " KB, total footprint "
+        << args.scan_llc_multiple << "x LLC, bandwidth target "
+        << (args.scan_bw_mbps > 0 ? std::to_string(args.scan_bw_mbps) + " MB/s" :
+            std::string("unthrottled"));
+
+    std::vector<ScanThreadArgs*> scan_args;
+    for (int i = 0; i < nthreads; i++) {
+        ScanThreadArgs* sargs = new ScanThreadArgs();
+        sargs->tidx = cur_tidx + i;
+        sargs->footprint_bytes = footprint;
+        sargs->bw_bytes_per_ns = bw;
+        scan_args.push_back(sargs);
+
+        pthread_t scan_thread;
+        int tret = pthread_create(&scan_thread, NULL, scan_array, sargs);
+        if (tret != 0) {
+            LOG(ERROR) << "Could not create dummy thread "
+                << sargs->tidx
+                << ": return code from pthread_create()="
+                << tret;
+            std::exit(1);
+        }
+    }
+
     // Wait until all array-scanning threads are active to ensure that their
     // tids are available, since there isn't a way for us to
     // get the tid of another thread.
-    while (num_scan_threads < 1);
-    assert(scan_thread_tid != -1);
-
-    tid_map.emplace(scan_thread_tid, new ThreadInfo());
-    // FIXME: Remove this mess with actual proper constructor...
-    ThreadInfo &tinfo = *(tid_map[scan_thread_tid]);
-    tinfo.tidx = cur_tidx;
-    tinfo.tid = scan_thread_tid;
-    tinfo.tgid = gettid();
-    std::vector<int> cores;
-    cores.push_back(state.assignable_cores.front());
-    state.assignable_cores.erase(state.assignable_cores.begin());
-    tinfo.cores = cores;
-    tinfo.rmid = cur_tidx + 1;
-    tinfo.is_dummy_thread = true;
-
-    tinfo.lastInstrCtr = 0;
-    tinfo.lastCyclesCtr = 0;
-    tinfo.lastMemTrafficCtr = 0;
-    tinfo.memTrafficLast = 0;
-    tinfo.memTrafficTotal = 0;
-    tinfo.avgCacheOccupancy = 0;
-
-    return ++cur_tidx;
+    while (num_scan_threads < nthreads);
+
+    for (ScanThreadArgs* sargs : scan_args) {
+        int scan_thread_tid = sargs->tid;
+        assert(scan_thread_tid != -1);
+
+        tid_map.emplace(scan_thread_tid, new ThreadInfo());
+        // FIXME: Remove this mess with actual proper constructor...
+        ThreadInfo &tinfo = *(tid_map[scan_thread_tid]);
+        tinfo.tidx = sargs->tidx;
+        tinfo.tid = scan_thread_tid;
+        tinfo.tgid = gettid();
+        // Each polluter gets its own core
+        std::vector<int> cores;
+        cores.push_back(state.assignable_cores.front());
+        state.assignable_cores.erase(state.assignable_cores.begin());
+        tinfo.cores = cores;
+        tinfo.rmid = sargs->tidx + 1;
+        tinfo.is_dummy_thread = true;
+
+        tinfo.lastInstrCtr = 0;
+        tinfo.lastCyclesCtr = 0;
+        tinfo.lastMemTrafficCtr = 0;
+        tinfo.memTrafficLast = 0;
+        tinfo.memTrafficTotal = 0;
+        tinfo.avgCacheOccupancy = 0;
+    }
+
+    return cur_tidx + nthreads;
 }
 
 INITIALIZE_EASYLOGGINGPP
@@ -1585,6 +1932,15 @@ int main(int argc, char* argv[]) {
         tinfo.ipcCurveAvg = zeros<arma::vec>(state.cache_num_ways);
         tinfo.ipcCurveEstimates = zeros<arma::mat>(state.cache_num_ways, 1000);
 
+        tinfo.mrcLower = zeros<arma::mat>(state.cache_num_ways, 1000);
+        tinfo.mrcUpper = zeros<arma::mat>(state.cache_num_ways, 1000);
+        tinfo.ipcLower = zeros<arma::mat>(state.cache_num_ways, 1000);
+        tinfo.ipcUpper = zeros<arma::mat>(state.cache_num_ways, 1000);
+
+        tinfo.knownMpki = zeros<arma::vec>(state.cache_num_ways);
+        tinfo.knownIpc = zeros<arma::vec>(state.cache_num_ways);
+        tinfo.knownEstIdx = arma::vec(state.cache_num_ways).fill(-1);
+
         // FIXME: Remove this mess with actual proper constructor...
         tinfo.lastInstrCtr = 0;
         tinfo.lastCyclesCtr = 0;
@@ -1651,14 +2007,55 @@ int main(int argc, char* argv[]) {
                 std::exit(1);
             }
             tinfo.ipc_outfile = ipcfd;
+
+            std::stringstream mrcbss;
+            mrcbss << results_dir_str;
+            mrcbss << args.glob_outfile_name << "_mrcbounds_" << tinfo.tid;
+            logger->info("Open file: %v", mrcbss.str().c_str());
+            FILE *mrcbfd = fopen(mrcbss.str().c_str(), "w");
+            if (mrcbfd == nullptr) {
+                std::cout << std::strerror(errno) << '\n';
+                logger->fatal("could not open mrc bounds file for thread %d", tinfo.tid);
+                std::exit(1);
+            }
+            tinfo.mrc_bounds_outfile = mrcbfd;
+
+            std::stringstream ipcbss;
+            ipcbss << results_dir_str;
+            ipcbss << args.glob_outfile_name << "_ipcbounds_" << tinfo.tid;
+            logger->info("Open file: %v", ipcbss.str().c_str());
+            FILE *ipcbfd = fopen(ipcbss.str().c_str(), "w");
+            if (ipcbfd == nullptr) {
+                std::cout << std::strerror(errno) << '\n';
+                logger->fatal("could not open ipc bounds file for thread %d", tinfo.tid);
+                std::exit(1);
+            }
+            tinfo.ipc_bounds_outfile = ipcbfd;
         } else {
             tinfo.mrc_outfile = NULL;
             tinfo.ipc_outfile = NULL;
+            tinfo.mrc_bounds_outfile = NULL;
+            tinfo.ipc_bounds_outfile = NULL;
         }
     }
 
     generate_profiling_plan(state.cache_num_ways);
 
+    // Sampling two threads at once needs a third class for the shared ways
+    if (args.mrc_concurrency > MRC_MAX_SLOTS) {
+        LOG(WARNING) << "[DATAMIME-PROFILER] At most " << MRC_MAX_SLOTS
+            << " threads can be sampled concurrently";
+        args.mrc_concurrency = MRC_MAX_SLOTS;
+    }
+    if (args.mrc_concurrency > 1 && CATController::getNumCos() <= mrc_slot_cos[1]) {
+        LOG(WARNING) << "[DATAMIME-PROFILER] Only " << CATController::getNumCos()
+            << " COS available, sampling one thread at a time";
+        args.mrc_concurrency = 1;
+    }
+    args.mrc_concurrency = std::max(1, std::min(args.mrc_concurrency, num_profiled_threads));
+    LOG(INFO) << "[DATAMIME-PROFILER] Sampling up to " << args.mrc_concurrency
+        << " thread(s) concurrently";
+
     create_scan_threads(tidx);
 
     // Set thread ids and CPU affinity
@@ -56,6 +56,14 @@ struct ThymeArgs {
     volatile bool mrc_est_mode = false;
     volatile bool debug = false;
     std::vector<int> profiled_tids;
+    // Dummy (polluter) threads used during MRC estimation
+    int num_scan_threads = 1;
+    double scan_llc_multiple = 2.0;
+    double scan_bw_mbps = 0.0;
+    // Profiled threads whose MRCs are sampled at once
+    int mrc_concurrency = 1;
+    // MRC sampling phases per thread and sweep, including the warm-up
+    int mrc_phase_budget = 7;
 };
 
 struct ThymeState {
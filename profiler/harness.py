@@ -69,6 +69,16 @@ parser.add_argument("-d", "--results_dir", type=str,
     help="Directory where you want to store your results")
 parser.add_argument("-u", "--uarch", type=str, default="broadwell",
     help="uArch of the machine the profiler is running on (Options: skylake, skylake-old, broadwell). Default is broadwell.")
+parser.add_argument("--scan_threads", type=int, default=None,
+    help="Number of dummy threads filling the non-profiled ways during MRC estimation")
+parser.add_argument("--scan_llc_multiple", type=float, default=None,
+    help="Total dummy thread footprint, as a multiple of the LLC size")
+parser.add_argument("--scan_bw", type=float, default=None,
+    help="Total dummy thread fill bandwidth target in MB/s (0 = unthrottled)")
+parser.add_argument("--mrc_threads", type=int, default=None,
+    help="Number of threads whose MRCs are sampled concurrently (1 or 2)")
+parser.add_argument("--mrc_budget", type=int, default=None,
+    help="MRC sampling phases per thread and sweep, including one warm-up phase")
 parser.add_argument("--debug", action="store_true",
     help="Output debug messages to the log file")
 parser.add_argument("-a", "--app", type=str, default=None,
@@ -98,7 +108,9 @@ def tid_to_tgid(tid):
 
 def profile_threads(uarch, tids, outfile_header, mrc_enabled, results_dir,
     num_phases=5500, phase_len=20000000, mrc_warmup_period=1000,
-    mrc_profile_period=10000, debug=False, app=None):
+    mrc_profile_period=10000, debug=False, app=None, scan_threads=None,
+    scan_llc_multiple=None, scan_bw=None, mrc_threads=None,
+    mrc_budget=None):
 
     events = []
     if uarch == "skylake-old":
@@ -129,6 +141,17 @@ def profile_threads(uarch, tids, outfile_header, mrc_enabled, results_dir,
     if mrc_enabled:
         cmd.append("-m")
 
+    if scan_threads is not None:
+        cmd.append("-s" + str(scan_threads))
+    if scan_llc_multiple is not None:
+        cmd.append("-S" + str(scan_llc_multiple))
+    if scan_bw is not None:
+        cmd.append("-b" + str(scan_bw))
+    if mrc_threads is not None:
+        cmd.append("-k" + str(mrc_threads))
+    if mrc_budget is not None:
+        cmd.append("-B" + str(mrc_budget))
+
     tids_str = "-t"
     for tid in tids:
         tids_str = tids_str + tid + ","
@@ -191,4 +214,9 @@ if __name__ == "__main__":
     mrc_warmup_period=args.mrc_warmup_period,
     mrc_profile_period=args.mrc_profile_period,
     debug=args.debug,
-    app=args.app)
+    app=args.app,
+    scan_threads=args.scan_threads,
+    scan_llc_multiple=args.scan_llc_multiple,
+    scan_bw=args.scan_bw,
+    mrc_threads=args.mrc_threads,
+    mrc_budget=args.mrc_budget)
@@ -0,0 +1,299 @@
+/** $lic$
+ * Copyright (C) 2021-2022 by Massachusetts Institute of Technology
+ *
+ * This file is part of Datamime.
+ *
+ * This tool is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * If you use this software in your research, we request that you reference
+ * the Datamime paper ("Datamime: Generating Representative Benchmarks by
+ * Automatically Synthesizing Datasets", Lee and Sanchez, MICRO-55, October 2022)
+ * as the source in any publications that use this software, and that you send
+ * us a citation of your work.
+ *
+ * This tool is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Computes a miss-ratio curve with the SHARDS engine (shards.h), without CAT,
+// CMT or dummy threads. Addresses come either from a trace file or from perf
+// memory-access samples of a running thread.
+//
+// Trace files hold one address per line, in hex (0x...) or decimal; anything
+// after the address and lines starting with '#' are ignored. With -b, the
+// trace is raw native-endian 64-bit addresses instead.
+//
+// Perf samples (-p) only see one in every <period> loads that pass the load
+// latency filter, so the curve describes that thinned stream rather than all
+// references. It is an approximation whose reuse distances shrink as the
+// period grows; keep the period small, and record a trace with -o to reuse
+// the samples offline.
+
+#include "shards.h"
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+void usage(char* argv[]) {
+    std::cout << "USAGE:" << std::endl;
+    std::cout << argv[0] << " [options] <trace_file | ->" << std::endl;
+    std::cout << argv[0] << " [options] -p <tid> [-t <secs>] [-e <raw_event>]"
+        " [-c <period>] [-o <trace_out>]" << std::endl;
+    std::cout << "\t-r <rate> : fraction of cache lines sampled (default 0.01,"
+        " 1 with -p)" << std::endl;
+    std::cout << "\t-s <max_lines> : track at most this many lines, lowering"
+        " the rate as needed (default 0, unbounded)" << std::endl;
+    std::cout << "\t-l <line_bytes> : cache line size (default 64)" << std::endl;
+    std::cout << "\t-m <MB> : largest cache size in the curve (default twice"
+        " the LLC)" << std::endl;
+    std::cout << "\t-n <points> : cache sizes in the curve (default 100)"
+        << std::endl;
+    std::cout << "\t-b : trace holds raw 64-bit addresses" << std::endl;
+    std::cout << "\t-p <tid> : sample the loads of a running thread with perf"
+        << std::endl;
+    std::cout << "\t-t <secs> : perf sampling time (default 10)" << std::endl;
+    std::cout << "\t-e <raw_event> : raw PEBS load event in hex (default 0x1cd,"
+        " Intel MEM_TRANS_RETIRED.LOAD_LATENCY)" << std::endl;
+    std::cout << "\t-c <period> : loads per perf sample (default 100)"
+        << std::endl;
+    std::cout << "\t-o <trace_out> : also write the sampled addresses as a"
+        " trace file" << std::endl;
+    std::cout << "\t-h : Print this help message" << std::endl;
+}
+
+uint64_t default_max_bytes() {
+    long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (llc <= 0)
+        llc = 32l << 20;
+    return 2 * (uint64_t)llc;
+}
+
+void read_trace(const std::string& path, bool binary, ShardsMrc& mrc) {
+    std::ifstream file;
+    std::istream* in = &std::cin;
+    if (path != "-") {
+        file.open(path, binary ? std::ios::binary : std::ios::in);
+        if (!file) {
+            std::cerr << "Could not open trace " << path << std::endl;
+            std::exit(1);
+        }
+        in = &file;
+    }
+
+    if (binary) {
+        uint64_t addrs[4096];
+        while (*in) {
+            in->read(reinterpret_cast<char*>(addrs), sizeof(addrs));
+            size_t n = in->gcount() / sizeof(uint64_t);
+            for (size_t i = 0; i < n; i++)
+                mrc.access(addrs[i]);
+        }
+        return;
+    }
+
+    std::string line;
+    while (std::getline(*in, line)) {
+        const char* s = line.c_str();
+        while (*s == ' ' || *s == '\t')
+            s++;
+        if (*s == '#' || *s == '\0')
+            continue;
+        char* end;
+        uint64_t addr = strtoull(s, &end, 0);
+        if (end != s)
+            mrc.access(addr);
+    }
+}
+
+volatile sig_atomic_t stop_sampling = 0;
+
+void stop_handler(int) {
+    stop_sampling = 1;
+}
+
+// Feeds the data addresses of load samples of thread tid to mrc for secs
+// seconds, or until interrupted
+void sample_perf(pid_t tid, int secs, uint64_t event, uint64_t period,
+                 ShardsMrc& mrc, FILE* traceOut) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_RAW;
+    attr.config = event;
+    attr.config1 = 3; // Load latency threshold, in cycles
+    attr.sample_period = period;
+    attr.sample_type = PERF_SAMPLE_ADDR;
+    attr.precise_ip = 2;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    int fd = syscall(__NR_perf_event_open, &attr, tid, -1, -1, 0);
+    if (fd == -1) {
+        std::cerr << "perf_event_open() failed: " << strerror(errno)
+            << ". Does the PMU support load sampling (-e)?" << std::endl;
+        std::exit(1);
+    }
+
+    const size_t pageSize = sysconf(_SC_PAGESIZE);
+    const size_t dataPages = 64;
+    size_t mapBytes = (1 + dataPages) * pageSize;
+    void* map = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        std::cerr << "mmap(perf buffer) failed: " << strerror(errno) << std::endl;
+        std::exit(1);
+    }
+    struct perf_event_mmap_page* pc = (struct perf_event_mmap_page*)map;
+    char* data = (char*)map + pageSize;
+    const uint64_t dataBytes = dataPages * pageSize;
+
+    signal(SIGINT, stop_handler);
+    signal(SIGTERM, stop_handler);
+
+    uint64_t lost = 0;
+    time_t deadline = time(nullptr) + secs;
+    while (!stop_sampling && time(nullptr) < deadline) {
+        uint64_t head = __atomic_load_n(&pc->data_head, __ATOMIC_ACQUIRE);
+        uint64_t tail = pc->data_tail;
+        while (tail < head) {
+            // Records may wrap around the end of the buffer
+            struct {
+                struct perf_event_header hdr;
+                uint64_t val;
+            } rec;
+            size_t len = sizeof(rec.hdr);
+            for (size_t i = 0; i < len; i++)
+                ((char*)&rec)[i] = data[(tail + i) % dataBytes];
+            len = std::min<size_t>(rec.hdr.size, sizeof(rec));
+            for (size_t i = sizeof(rec.hdr); i < len; i++)
+                ((char*)&rec)[i] = data[(tail + i) % dataBytes];
+
+            if (rec.hdr.type == PERF_RECORD_SAMPLE && rec.val != 0) {
+                mrc.access(rec.val);
+                if (traceOut)
+                    fprintf(traceOut, "0x%lx\n", rec.val);
+            } else if (rec.hdr.type == PERF_RECORD_LOST) {
+                // id, then the number of lost samples
+                uint64_t n = 0;
+                for (size_t i = 0; i < sizeof(n); i++)
+                    ((char*)&n)[i] = data[(tail + sizeof(rec.hdr) + 8 + i) % dataBytes];
+                lost += n;
+            }
+            tail += rec.hdr.size;
+        }
+        __atomic_store_n(&pc->data_tail, tail, __ATOMIC_RELEASE);
+
+        struct timespec ts = {0, 10 * 1000 * 1000};
+        nanosleep(&ts, nullptr);
+    }
+
+    if (lost)
+        std::cerr << "Lost " << lost << " perf samples" << std::endl;
+    munmap(map, mapBytes);
+    close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    double rate = -1.0;
+    uint64_t maxLines = 0;
+    int lineBytes = 64;
+    uint64_t maxBytes = default_max_bytes();
+    int numPoints = 100;
+    bool binary = false;
+    pid_t tid = 0;
+    int secs = 10;
+    uint64_t event = 0x1cd;
+    uint64_t period = 100;
+    const char* traceOutPath = nullptr;
+
+    int c;
+    while ((c = getopt(argc, argv, "r:s:l:m:n:bp:t:e:c:o:h")) != -1) {
+        switch (c) {
+            case 'r':
+                rate = std::stod(optarg);
+                break;
+            case 's':
+                maxLines = std::stoul(optarg);
+                break;
+            case 'l':
+                lineBytes = std::stoi(optarg);
+                break;
+            case 'm':
+                maxBytes = (uint64_t)(std::stod(optarg) * (1 << 20));
+                break;
+            case 'n':
+                numPoints = std::stoi(optarg);
+                break;
+            case 'b':
+                binary = true;
+                break;
+            case 'p':
+                tid = std::stoi(optarg);
+                break;
+            case 't':
+                secs = std::stoi(optarg);
+                break;
+            case 'e':
+                event = std::stoul(optarg, nullptr, 16);
+                break;
+            case 'c':
+                period = std::stoul(optarg);
+                break;
+            case 'o':
+                traceOutPath = optarg;
+                break;
+            case 'h':
+                usage(argv);
+                exit(0);
+                break;
+            case '?':
+                usage(argv);
+                exit(1);
+                break;
+        }
+    }
+
+    if ((tid == 0) == (optind >= argc) || rate == 0.0 || rate > 1.0 ||
+            numPoints < 1 || lineBytes < 1 || period < 1) {
+        usage(argv);
+        exit(1);
+    }
+    if (rate < 0.0)
+        rate = tid ? 1.0 : 0.01;
+
+    ShardsMrc mrc(rate, maxLines, lineBytes);
+    if (tid) {
+        FILE* traceOut = nullptr;
+        if (traceOutPath && !(traceOut = fopen(traceOutPath, "w"))) {
+            std::cerr << "Could not open " << traceOutPath << std::endl;
+            exit(1);
+        }
+        sample_perf(tid, secs, event, period, mrc, traceOut);
+        if (traceOut)
+            fclose(traceOut);
+    } else {
+        read_trace(argv[optind], binary, mrc);
+    }
+
+    fprintf(stdout, "# references = %lu, sampled = %lu, final rate = %f\n",
+            mrc.references(), mrc.sampledReferences(), mrc.samplingRate());
+    mrc.dump(stdout, maxBytes, numPoints);
+    return 0;
+}
@@ -0,0 +1,155 @@
+/** $lic$
+ * Copyright (C) 2021-2022 by Massachusetts Institute of Technology
+ *
+ * This file is part of Datamime.
+ *
+ * This tool is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * If you use this software in your research, we request that you reference
+ * the Datamime paper ("Datamime: Generating Representative Benchmarks by
+ * Automatically Synthesizing Datasets", Lee and Sanchez, MICRO-55, October 2022)
+ * as the source in any publications that use this software, and that you send
+ * us a citation of your work.
+ *
+ * This tool is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks the SHARDS engine (shards.h) against exact answers: cyclic scans,
+// whose LRU miss curve is a step at the scan's footprint, and random traces
+// run through a simulated LRU cache. Exits with 1 if any check fails.
+
+#include "shards.h"
+#include <sys/resource.h>
+#include <stdint.h>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <list>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+const int LINE_BYTES = 64;
+
+int failures = 0;
+
+void check(bool ok, const std::string& what) {
+    std::cout << (ok ? "PASS " : "FAIL ") << what << std::endl;
+    if (!ok)
+        failures++;
+}
+
+void scan(ShardsMrc& mrc, uint64_t lines, int laps) {
+    for (int l = 0; l < laps; l++)
+        for (uint64_t i = 0; i < lines; i++)
+            mrc.access(i * LINE_BYTES);
+}
+
+// At rate 1, a cyclic scan over N lines misses every time in caches below N
+// lines, and only on its first lap from N lines on
+void test_exact_scan() {
+    const uint64_t lines = 5000;
+    const int laps = 10;
+    ShardsMrc mrc(1.0);
+    scan(mrc, lines, laps);
+    check(mrc.missRatio((lines - 1) * LINE_BYTES) == 1.0,
+          "exact scan misses below its footprint");
+    check(std::fabs(mrc.missRatio(lines * LINE_BYTES) - 1.0 / laps) < 1e-12,
+          "exact scan hits from its footprint on");
+}
+
+// Sampled and fixed-size, the step stays at N
+void test_sampled_scan() {
+    const uint64_t lines = 200000;
+    const int laps = 4;
+    ShardsMrc mrc(0.1, 2000);
+    scan(mrc, lines, laps);
+    check(mrc.missRatio(lines * 9 / 10 * LINE_BYTES) > 0.95,
+          "sampled scan misses below its footprint");
+    check(mrc.missRatio(lines * 11 / 10 * LINE_BYTES) < 1.0 / laps + 0.05,
+          "sampled scan hits above its footprint");
+}
+
+// At rate 1, the curve matches a fully associative LRU cache at every size
+void test_exact_random() {
+    const uint64_t lines = 2000;
+    const uint64_t refs = 200000;
+    std::mt19937_64 rng(1);
+    // Skewed, so that every cache size sees a different miss ratio
+    std::geometric_distribution<uint64_t> dist(3.0 / lines);
+    std::vector<uint64_t> trace;
+    for (uint64_t i = 0; i < refs; i++)
+        trace.push_back(dist(rng) % lines * LINE_BYTES);
+
+    ShardsMrc mrc(1.0);
+    for (uint64_t addr : trace)
+        mrc.access(addr);
+
+    bool ok = true;
+    for (uint64_t size = 1; size <= lines && ok; size += 37) {
+        std::list<uint64_t> lru;
+        std::unordered_map<uint64_t, std::list<uint64_t>::iterator> pos;
+        uint64_t misses = 0;
+        for (uint64_t addr : trace) {
+            auto it = pos.find(addr);
+            if (it != pos.end()) {
+                lru.erase(it->second);
+            } else {
+                misses++;
+                if (lru.size() == size) {
+                    pos.erase(lru.back());
+                    lru.pop_back();
+                }
+            }
+            lru.push_front(addr);
+            pos[addr] = lru.begin();
+        }
+        double expected = (double)misses / refs;
+        double got = mrc.missRatio(size * LINE_BYTES);
+        if (std::fabs(got - expected) > 1e-9) {
+            std::cout << "\t" << size << " lines: LRU " << expected
+                << ", SHARDS " << got << std::endl;
+            ok = false;
+        }
+    }
+    check(ok, "exact random trace matches LRU");
+}
+
+long max_rss_kb() {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+// Fixed-size memory doesn't grow with the footprint: the histogram holds
+// sampled distances, which never exceed the tracked lines
+void test_bounded_memory() {
+    const uint64_t lines = 8000000;
+    long before = max_rss_kb();
+    ShardsMrc mrc(1.0, 1000);
+    scan(mrc, lines, 2);
+    long grown = max_rss_kb() - before;
+    check(grown < 16 * 1024, "fixed-size memory stays bounded (grew "
+          + std::to_string(grown) + " kB)");
+    check(mrc.missRatio((lines - lines / 10) * LINE_BYTES) == 1.0 &&
+          mrc.missRatio((lines + lines / 10) * LINE_BYTES) < 0.55,
+          "fixed-size scan steps at its footprint");
+}
+
+int main() {
+    // First, while the peak RSS is still the baseline
+    test_bounded_memory();
+    test_exact_scan();
+    test_sampled_scan();
+    test_exact_random();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+/** $lic$
+ * Copyright (C) 2021-2022 by Massachusetts Institute of Technology
+ *
+ * This file is part of Datamime.
+ *
+ * This tool is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * If you use this software in your research, we request that you reference
+ * the Datamime paper ("Datamime: Generating Representative Benchmarks by
+ * Automatically Synthesizing Datasets", Lee and Sanchez, MICRO-55, October 2022)
+ * as the source in any publications that use this software, and that you send
+ * us a citation of your work.
+ *
+ * This tool is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "shards.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+ShardsMrc::ShardsMrc(double rate, uint64_t maxLines, int lineBytes)
+    : lineBits(0), maxLines(maxLines), totalRefs(0), sampledRefs(0),
+      coldMisses(0.0), tree(1 << 16, 0), now(0) {
+  while ((1 << (lineBits + 1)) <= lineBytes)
+    lineBits++;
+
+  rate = std::min(std::max(rate, 0.0), 1.0);
+  threshold = std::max<uint64_t>(1, (uint64_t)std::llround(rate * HASH_MOD));
+}
+
+// Mixes all bits of the line address (splitmix64 finalizer), so that any
+// subset of hash values is an unbiased sample of lines
+uint64_t ShardsMrc::hash(uint64_t line) {
+  line += 0x9e3779b97f4a7c15ul;
+  line = (line ^ (line >> 30)) * 0xbf58476d1ce4e5b9ul;
+  line = (line ^ (line >> 27)) * 0x94d049bb133111ebul;
+  return line ^ (line >> 31);
+}
+
+void ShardsMrc::treeAdd(uint64_t t, int32_t v) {
+  for (; t < tree.size(); t += t & (~t + 1))
+    tree[t] += v;
+}
+
+uint64_t ShardsMrc::treePrefix(uint64_t t) const {
+  uint64_t sum = 0;
+  for (; t > 0; t -= t & (~t + 1))
+    sum += tree[t];
+  return sum;
+}
+
+// Renumbers the last reference times of the tracked lines as 1..n, in order,
+// growing the tree if the tracked lines fill more than half of it
+void ShardsMrc::compact() {
+  std::vector<std::pair<uint64_t, uint64_t>> order; // (time, line)
+  order.reserve(lastRef.size());
+  for (auto &lr : lastRef)
+    order.emplace_back(lr.second, lr.first);
+  std::sort(order.begin(), order.end());
+
+  size_t size = std::max(tree.size(), 2 * (order.size() + 1));
+  tree.assign(size, 0);
+  now = 0;
+  for (auto &o : order) {
+    now++;
+    lastRef[o.second] = now;
+    treeAdd(now, 1);
+  }
+}
+
+// Stops tracking the lines with the highest hash and lowers the sampling
+// rate to exclude them. Counts so far were taken at the old rate, so they are
+// scaled down to the new one, and so are their sampled distances: a distance
+// of d lines at the old rate is d * new / old lines at the new one (rounded
+// down).
+void ShardsMrc::evictHighest() {
+  uint64_t newThreshold = std::prev(byHash.end())->first;
+  while (!byHash.empty() && std::prev(byHash.end())->first >= newThreshold) {
+    auto top = std::prev(byHash.end());
+    auto lr = lastRef.find(top->second);
+    treeAdd(lr->second, -1);
+    lastRef.erase(lr);
+    byHash.erase(top);
+  }
+
+  newThreshold = std::max<uint64_t>(1, newThreshold);
+  double scale = (double)newThreshold / threshold;
+  std::vector<double> scaled;
+  for (size_t d = 0; d < hist.size(); d++) {
+    if (hist[d] == 0.0)
+      continue;
+    size_t nd = d * newThreshold / threshold;
+    if (nd >= scaled.size())
+      scaled.resize(nd + 1, 0.0);
+    scaled[nd] += hist[d] * scale;
+  }
+  hist.swap(scaled);
+  coldMisses *= scale;
+  threshold = newThreshold;
+}
+
+void ShardsMrc::access(uint64_t addr) {
+  totalRefs++;
+
+  uint64_t line = addr >> lineBits;
+  uint64_t h = hash(line) & (HASH_MOD - 1);
+  if (h >= threshold)
+    return;
+  sampledRefs++;
+
+  if (now + 1 >= tree.size())
+    compact();
+  now++;
+
+  auto lr = lastRef.find(line);
+  if (lr == lastRef.end()) {
+    coldMisses += 1.0;
+    lastRef[line] = now;
+    treeAdd(now, 1);
+    if (maxLines) {
+      byHash.emplace(h, line);
+      if (lastRef.size() > maxLines)
+        evictHighest();
+    }
+    return;
+  }
+
+  // Distinct tracked lines referenced since this line's last reference
+  uint64_t dist = lastRef.size() - treePrefix(lr->second);
+  treeAdd(lr->second, -1);
+  treeAdd(now, 1);
+  lr->second = now;
+
+  if (dist >= hist.size())
+    hist.resize(dist + 1, 0.0);
+  hist[dist] += 1.0;
+}
+
+// A sampled distance d stands for d / R lines of the full stream, which
+// misses in a cache of the given lines iff d >= lines * R
+uint64_t ShardsMrc::firstMissBucket(uint64_t lines) const {
+  // Split lines so that lines * threshold can't overflow
+  uint64_t q = lines / HASH_MOD;
+  uint64_t r = lines % HASH_MOD;
+  return q * threshold + (r * threshold + HASH_MOD - 1) / HASH_MOD;
+}
+
+double ShardsMrc::missRatio(uint64_t cacheBytes) const {
+  uint64_t lines = cacheBytes >> lineBits;
+  uint64_t first = firstMissBucket(lines);
+  double misses = coldMisses;
+  double total = coldMisses;
+  for (size_t b = 0; b < hist.size(); b++) {
+    total += hist[b];
+    if (b >= first)
+      misses += hist[b];
+  }
+
+  // SHARDS_adj: the sampled lines may see more or fewer references than
+  // their share of the stream. Attribute the difference to distance 0, i.e.
+  // to hits in any nonzero cache.
+  double adj = totalRefs * samplingRate() - total;
+  total += adj;
+  if (lines == 0)
+    misses += adj;
+
+  if (total <= 0.0)
+    return 0.0;
+  return std::min(std::max(misses / total, 0.0), 1.0);
+}
+
+void ShardsMrc::dump(FILE *out, uint64_t maxBytes, int numPoints) const {
+  // Misses at distance >= b, for each bucket b
+  std::vector<double> suffix(hist.size() + 1, 0.0);
+  for (size_t b = hist.size(); b > 0; b--)
+    suffix[b - 1] = suffix[b] + hist[b - 1];
+
+  double total = coldMisses + suffix[0];
+  double adj = totalRefs * samplingRate() - total;
+  total += adj;
+
+  for (int i = 1; i <= numPoints; i++) {
+    uint64_t bytes = maxBytes * i / numPoints;
+    uint64_t lines = bytes >> lineBits;
+    uint64_t first = firstMissBucket(lines);
+    double misses = coldMisses + suffix[std::min<size_t>(first, hist.size())];
+    if (lines == 0)
+      misses += adj;
+    double ratio = (total > 0.0) ? std::min(std::max(misses / total, 0.0), 1.0) : 0.0;
+    fprintf(out, "%lu %f\n", bytes, ratio);
+  }
+}
@@ -0,0 +1,108 @@
+/** $lic$
+ * Copyright (C) 2021-2022 by Massachusetts Institute of Technology
+ *
+ * This file is part of Datamime.
+ *
+ * This tool is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation, version 3.
+ *
+ * If you use this software in your research, we request that you reference
+ * the Datamime paper ("Datamime: Generating Representative Benchmarks by
+ * Automatically Synthesizing Datasets", Lee and Sanchez, MICRO-55, October 2022)
+ * as the source in any publications that use this software, and that you send
+ * us a citation of your work.
+ *
+ * This tool is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SHARDS_H__
+#define __SHARDS_H__
+
+// Software miss-ratio curves from sampled reuse distances, following SHARDS
+// (Waldspurger et al., "Efficient MRC Construction with SHARDS", FAST 2015).
+//
+// Each reference's cache line is hashed, and only lines whose hash falls
+// below a threshold are tracked, so a fraction R of all lines is sampled
+// along with every reference to them. The reuse (LRU stack) distance of a
+// sampled reference, in distinct sampled lines, divided by R estimates its
+// distance in the full stream. A fully associative LRU cache of C lines hits
+// exactly the references with distance < C, so the histogram of distances
+// yields the miss ratio of every cache size at once, at line granularity.
+//
+// The histogram is kept in sampled distances, which never exceed the number
+// of tracked lines, and scaled by 1/R only when queried. With maxLines > 0,
+// at most that many lines are tracked (fixed-size SHARDS): when the limit is
+// hit, the lines with the highest hashes are dropped and the threshold, i.e.
+// R, is lowered, so memory stays bounded for any footprint. The engine depends neither on CAT nor on the PMU, so it runs
+// offline on recorded address traces (see shards-mrc.cpp).
+
+#include <stdint.h>
+#include <cstdio>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class ShardsMrc {
+  public:
+    // rate = initial fraction of lines sampled, 1.0 for exact curves
+    ShardsMrc(double rate, uint64_t maxLines = 0, int lineBytes = 64);
+
+    void access(uint64_t addr);
+
+    uint64_t references() const { return totalRefs; }
+    uint64_t sampledReferences() const { return sampledRefs; }
+    double samplingRate() const { return (double)threshold / HASH_MOD; }
+    int lineBytes() const { return 1 << lineBits; }
+
+    // Miss ratio of a fully associative LRU cache of cacheBytes
+    double missRatio(uint64_t cacheBytes) const;
+
+    // Writes "cache_bytes miss_ratio" rows for numPoints sizes spaced evenly
+    // up to maxBytes
+    void dump(FILE *out, uint64_t maxBytes, int numPoints) const;
+
+  private:
+    static const uint64_t HASH_MOD = 1ul << 24;
+
+    int lineBits;
+    uint64_t threshold; // Lines with hash % HASH_MOD < threshold are sampled
+    uint64_t maxLines;
+
+    uint64_t totalRefs;
+    uint64_t sampledRefs;
+
+    // Reuse distance histogram, one bucket per sampled line of distance at
+    // the current rate, and references to lines never seen before. Kept as
+    // doubles since they are rescaled whenever the rate drops.
+    std::vector<double> hist;
+    double coldMisses;
+
+    // Tracked line -> time of its last reference
+    std::unordered_map<uint64_t, uint64_t> lastRef;
+    // Tracked lines by hash, to drop the highest ones (fixed-size only)
+    std::set<std::pair<uint64_t, uint64_t>> byHash;
+
+    // Fenwick tree over reference times with a 1 at the last reference of
+    // each tracked line, so the distinct lines referenced since time t are a
+    // suffix sum. Times are renumbered when the tree fills up.
+    std::vector<int32_t> tree;
+    uint64_t now;
+
+    static uint64_t hash(uint64_t line);
+    void treeAdd(uint64_t t, int32_t v);
+    uint64_t treePrefix(uint64_t t) const; // Marks at times 1..t
+    void compact();
+    void evictHighest();
+    // First bucket whose references miss in a cache of the given lines
+    uint64_t firstMissBucket(uint64_t lines) const;
+};
+
+#endif // __SHARDS_H__